@@ -19,6 +19,7 @@
 #include <complex>
 
 #include <gpu/host.hpp>
+#include <gpu/host_pool.hpp>
 
 #ifdef __NVCC__
 template<>
@@ -113,7 +114,7 @@ template <class type, size_t dim,
 #ifdef ENABLE_GPU
 					class allocator = caching_allocator<type>
 #else
-					class allocator = std::allocator<type>
+					class allocator = host_caching_allocator<type>
 #endif
 					>
 using array = boost::multi::array<type, dim, allocator>;
@@ -139,5 +140,28 @@ void prefetch_cpu(ArrayType const & array){
 TEST_CASE(GPURUN_TEST_FILE, GPURUN_TEST_TAG) {
 	using namespace Catch::literals;
 	using Catch::Approx;
+
+	SECTION("Host pool"){
+		gpu::array<double, 2> arr({100, 30}, 1.0);
+		CHECK(arr[99][29] == 1.0);
+
+		auto copy = arr;
+		copy[10][10] = 5.0;
+		CHECK(arr[10][10] == 1.0);
+		CHECK(copy[10][10] == 5.0);
+
+#ifndef ENABLE_GPU
+		if(gpu::host_pool::enabled()){
+			auto allocs = gpu::host_pool::global().stats().allocations;
+			{
+				gpu::array<double, 1> tmp(3000);
+				tmp[2999] = 2.0;
+				CHECK(tmp[2999] == 2.0);
+			}
+			CHECK(gpu::host_pool::global().stats().allocations == allocs + 1);
+			CHECK(gpu::host_pool::global().stats().cached > 0);
+		}
+#endif
+	}
 }
 #endif
@@ -0,0 +1,506 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef GPURUN__GPU__HOST_POOL
+#define GPURUN__GPU__HOST_POOL
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <inq_config.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#if __has_include(<linux/mempolicy.h>)
+#include <linux/mempolicy.h>
+#endif
+#endif
+
+namespace gpu {
+
+// A caching pool for host memory. Blocks are rounded up to a size
+// class, there are four classes for each power of two so at most 25%
+// of a block is unused. When released they are kept in a free list
+// instead of being returned to the system. This avoids the
+// malloc/free and first-touch page fault cost of the many temporary
+// arrays created in each iteration.
+//
+// There is a set of free lists for each NUMA node. A new block is
+// placed on the node of the thread that allocates it: the pages are
+// bound to that node with mbind (when available) and touched by that
+// thread. A released block goes back to the list of the node where
+// it was placed, and an allocation only reuses blocks from the list
+// of its own node.
+//
+// Blocks larger than a fraction of the cache limit are not cached,
+// they go directly to the system. The total size of the cached
+// blocks is also limited, a released block that does not fit is
+// freed. trim() returns cached blocks to the system.
+//
+// The pool can be disabled by setting the environment variable
+// INQ_HOST_POOL to "off", in that case all the requests go directly
+// to operator new and delete.
+
+class host_pool {
+
+public:
+
+	struct statistics {
+		std::size_t allocations = 0;
+		std::size_t hits = 0;
+		std::size_t in_use = 0;
+		std::size_t high_water_mark = 0;
+		std::size_t cached = 0;
+	};
+
+	static constexpr std::size_t alignment = 64;
+	static constexpr std::size_t default_cache_limit = std::size_t(1) << 30;
+	static constexpr double default_max_block_fraction = 0.25;
+
+private:
+
+	static constexpr int min_class_log2 = 8;
+	static constexpr int max_class_log2 = 40;
+	static constexpr int subclasses = 4;
+	static constexpr int num_classes = (max_class_log2 - min_class_log2)*subclasses + 1;
+	static constexpr int uncached_class = num_classes;
+
+	// the header occupies the first 'alignment' bytes of each block so that the returned pointer keeps the alignment
+	struct header {
+		int size_class;
+		int node;
+		std::size_t size;
+	};
+
+	static_assert(sizeof(header) <= alignment);
+
+	using free_lists = std::array<std::vector<void *>, num_classes>;
+
+	std::mutex mutex_;
+	std::vector<free_lists> nodes_;
+	std::size_t cache_limit_;
+	double max_block_fraction_;
+	statistics stats_;
+
+	static constexpr auto class_size(int size_class) {
+		auto octave = std::size_t(1) << (size_class/subclasses + min_class_log2);
+		return octave + (octave/subclasses)*(size_class%subclasses);
+	}
+
+	static int size_class(std::size_t size) {
+		int cls = 0;
+		while(cls < num_classes and class_size(cls) < size) cls++;
+		return cls;
+	}
+
+	static auto block_allocate(std::size_t size) {
+		return ::operator new(size, std::align_val_t(alignment));
+	}
+
+	static void block_deallocate(void * block) {
+		::operator delete(block, std::align_val_t(alignment));
+	}
+
+	// binds the pages of a new block to 'node' and touches them from this thread, the failures are ignored since the placement is only an optimization
+	static void place([[maybe_unused]] void * block, [[maybe_unused]] std::size_t size, [[maybe_unused]] int node) {
+#ifdef __linux__
+		auto page = std::size_t(sysconf(_SC_PAGESIZE));
+		auto first = (reinterpret_cast<std::size_t>(block) + page - 1)/page*page;
+		auto last = (reinterpret_cast<std::size_t>(block) + size)/page*page;
+#if defined(SYS_mbind) && defined(MPOL_MF_MOVE)
+		constexpr int bits = 8*sizeof(unsigned long);
+		std::array<unsigned long, 16> mask{};
+		if(last > first and node < bits*int(mask.size())) {
+			mask[node/bits] = 1ul << (node%bits);
+			syscall(SYS_mbind, first, last - first, MPOL_PREFERRED, mask.data(), bits*mask.size(), MPOL_MF_MOVE);
+		}
+#endif
+		for(auto addr = first; addr < last; addr += page) *reinterpret_cast<volatile char *>(addr) = 0;
+#endif
+	}
+
+	void * block_to_pointer(void * block, int cls, int node, std::size_t size) {
+		auto head = static_cast<header *>(block);
+		head->size_class = cls;
+		head->node = node;
+		head->size = size;
+		return static_cast<char *>(block) + alignment;
+	}
+
+	void count_allocation(std::size_t size, bool hit) {
+		stats_.allocations++;
+		if(hit) stats_.hits++;
+		stats_.in_use += size;
+		if(stats_.in_use > stats_.high_water_mark) stats_.high_water_mark = stats_.in_use;
+	}
+
+	// the mutex must be locked
+	auto & lists(int node) {
+		if(node >= int(nodes_.size())) nodes_.resize(node + 1);
+		return nodes_[node];
+	}
+	
+	// the mutex must be locked
+	void trim_locked(std::size_t target) {
+		for(int cls = num_classes - 1; cls >= 0 and stats_.cached > target; cls--){
+			for(auto & node_lists : nodes_){
+				auto & list = node_lists[cls];
+				while(not list.empty() and stats_.cached > target){
+					block_deallocate(list.back());
+					list.pop_back();
+					stats_.cached -= class_size(cls);
+				}
+			}
+		}
+	}
+
+	// the mutex must be locked
+	auto max_cached_size_locked() const {
+		return std::size_t(max_block_fraction_*cache_limit_);
+	}
+	
+public:
+
+	host_pool(std::size_t cache_limit = default_cache_limit, double max_block_fraction = default_max_block_fraction):
+		cache_limit_(cache_limit),
+		max_block_fraction_(max_block_fraction){
+		static_assert(class_size(num_classes - 1) == std::size_t(1) << max_class_log2);
+	}
+	
+	host_pool(host_pool const &) = delete;
+
+	~host_pool() {
+		release();
+	}
+
+	static bool enabled() {
+		static bool const value = [] {
+			auto env = std::getenv("INQ_HOST_POOL");
+			if(env == NULL) return true;
+			auto str = std::string(env);
+			return not (str == "off" or str == "no" or str == "0" or str == "false");
+		}();
+		return value;
+	}
+
+	// the global pool is intentionally leaked, so that arrays with static storage can be safely destroyed at exit
+	static host_pool & global() {
+		static auto pool = new host_pool;
+		return *pool;
+	}
+
+	// the NUMA node of the cpu running the calling thread
+	static int current_node() {
+#if defined(__linux__) && defined(SYS_getcpu)
+		unsigned cpu, node;
+		if(syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return int(node);
+#endif
+		return 0;
+	}
+
+	// the node where the block of a pointer returned by allocate was placed
+	static int node(void const * ptr) {
+		return reinterpret_cast<header const *>(static_cast<char const *>(ptr) - alignment)->node;
+	}
+	
+	void * allocate(std::size_t size) {
+		auto cls = size_class(size + alignment);
+		auto node = current_node();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			if(cls == uncached_class or class_size(cls) > max_cached_size_locked()) {
+				cls = uncached_class;
+			} else {
+				auto & list = lists(node)[cls];
+				if(not list.empty()){
+					auto block = list.back();
+					list.pop_back();
+					stats_.cached -= class_size(cls);
+					count_allocation(class_size(cls), true);
+					return block_to_pointer(block, cls, node, class_size(cls));
+				}
+			}
+		}
+
+		auto block_size = (cls == uncached_class) ? size + alignment : class_size(cls);
+		auto block = block_allocate(block_size);
+		if(cls != uncached_class) place(block, block_size, node);
+		
+		std::lock_guard<std::mutex> lock(mutex_);
+		count_allocation(block_size, false);
+		return block_to_pointer(block, cls, node, block_size);
+	}
+
+	void deallocate(void * ptr) {
+		if(ptr == nullptr) return;
+
+		auto block = static_cast<char *>(ptr) - alignment;
+		auto head = *reinterpret_cast<header *>(block);
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		stats_.in_use -= head.size;
+
+		if(head.size_class == uncached_class or stats_.cached + head.size > cache_limit_) {
+			block_deallocate(block);
+			return;
+		}
+
+		lists(head.node)[head.size_class].push_back(block);
+		stats_.cached += head.size;
+	}
+
+	// returns cached blocks to the system, the largest first, until at most 'target' bytes are cached
+	void trim(std::size_t target = 0) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		trim_locked(target);
+	}
+
+	// returns all the cached blocks to the system
+	void release() {
+		trim(0);
+	}
+
+	auto & cache_limit() const {
+		return cache_limit_;
+	}
+
+	// a smaller limit trims the cache
+	void cache_limit(std::size_t limit) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		cache_limit_ = limit;
+		trim_locked(limit);
+	}
+
+	auto & max_block_fraction() const {
+		return max_block_fraction_;
+	}
+
+	// blocks larger than this fraction of the cache limit are not cached
+	void max_block_fraction(double fraction) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		max_block_fraction_ = fraction;
+	}
+
+	auto max_cached_size() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return max_cached_size_locked();
+	}
+	
+	auto stats() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return stats_;
+	}
+
+};
+
+template <class Type>
+struct host_caching_allocator {
+
+	using value_type = Type;
+
+	host_caching_allocator() = default;
+
+	template <class OtherType>
+	host_caching_allocator(host_caching_allocator<OtherType> const &) {
+	}
+
+	[[nodiscard]] Type * allocate(std::size_t n) {
+		if(not host_pool::enabled()) return static_cast<Type *>(::operator new(n*sizeof(Type)));
+		return static_cast<Type *>(host_pool::global().allocate(n*sizeof(Type)));
+	}
+
+	void deallocate(Type * ptr, std::size_t) {
+		if(not host_pool::enabled()) return ::operator delete(ptr);
+		host_pool::global().deallocate(ptr);
+	}
+
+	template <class OtherType>
+	friend bool operator==(host_caching_allocator const &, host_caching_allocator<OtherType> const &) {
+		return true;
+	}
+
+	template <class OtherType>
+	friend bool operator!=(host_caching_allocator const &, host_caching_allocator<OtherType> const &) {
+		return false;
+	}
+
+};
+
+}
+#endif
+
+#ifdef GPURUN__HOST_POOL__UNIT_TEST
+#undef GPURUN__HOST_POOL__UNIT_TEST
+
+#include <catch2/catch_all.hpp>
+
+#include <thread>
+
+TEST_CASE(GPURUN_TEST_FILE, GPURUN_TEST_TAG) {
+	using namespace Catch::literals;
+	using Catch::Approx;
+
+	SECTION("Reuse"){
+		gpu::host_pool pool;
+
+		auto ptr1 = static_cast<double *>(pool.allocate(1000*sizeof(double)));
+		CHECK(reinterpret_cast<std::size_t>(ptr1)%gpu::host_pool::alignment == 0);
+		for(int ii = 0; ii < 1000; ii++) ptr1[ii] = ii;
+		CHECK(ptr1[999] == 999.0);
+
+		auto used = pool.stats().in_use;
+		CHECK(used >= 1000*sizeof(double));
+		CHECK(pool.stats().high_water_mark == used);
+		CHECK(pool.stats().hits == 0);
+
+		pool.deallocate(ptr1);
+
+		CHECK(pool.stats().in_use == 0);
+		CHECK(pool.stats().cached == used);
+
+		// a request in the same size class gets the cached block
+		auto ptr2 = pool.allocate(900*sizeof(double));
+		CHECK(pool.stats().hits == 1);
+		CHECK(pool.stats().cached == 0);
+		CHECK(pool.stats().allocations == 2);
+
+		auto ptr3 = pool.allocate(10);
+		CHECK(pool.stats().hits == 1);
+		CHECK(pool.stats().high_water_mark == pool.stats().in_use);
+
+		pool.deallocate(ptr2);
+		pool.deallocate(ptr3);
+
+		CHECK(pool.stats().in_use == 0);
+		CHECK(pool.stats().high_water_mark >= used);
+
+		pool.release();
+		CHECK(pool.stats().cached == 0);
+	}
+
+	SECTION("Size classes"){
+		gpu::host_pool pool;
+
+		// a size just above a power of two does not take the next power of two
+		auto ptr = pool.allocate(4096 + 1);
+		CHECK(pool.stats().in_use <= (4096 + 1 + gpu::host_pool::alignment)*5/4);
+		pool.deallocate(ptr);
+
+		// large blocks are not cached
+		pool.max_block_fraction(0.05);
+		CHECK(pool.max_cached_size() == std::size_t(0.05*gpu::host_pool::default_cache_limit));
+		auto large = static_cast<char *>(pool.allocate(std::size_t(100) << 20));
+		large[0] = 'a';
+		CHECK(pool.stats().in_use == (std::size_t(100) << 20) + gpu::host_pool::alignment);
+		auto cached = pool.stats().cached;
+		pool.deallocate(large);
+		CHECK(pool.stats().cached == cached);
+
+		// with the default fraction a 100 MiB block is cached
+		pool.max_block_fraction(gpu::host_pool::default_max_block_fraction);
+		large = static_cast<char *>(pool.allocate(std::size_t(100) << 20));
+		large[0] = 'a';
+		pool.deallocate(large);
+		CHECK(pool.stats().cached >= cached + (std::size_t(100) << 20));
+		
+		pool.release();
+	}
+
+	SECTION("Nodes"){
+		gpu::host_pool pool;
+
+		CHECK(gpu::host_pool::current_node() >= 0);
+		
+		auto ptr = static_cast<char *>(pool.allocate(std::size_t(1) << 20));
+		auto node = gpu::host_pool::node(ptr);
+		CHECK(node >= 0);
+		ptr[0] = 'a';
+		pool.deallocate(ptr);
+
+		// a block is reused only from the list of the node of the calling thread
+		auto ptr2 = pool.allocate(std::size_t(1) << 20);
+		CHECK(pool.stats().hits <= 1);
+		if(pool.stats().hits == 1) CHECK(gpu::host_pool::node(ptr2) == node);
+		pool.deallocate(ptr2);
+		pool.release();
+	}
+
+	SECTION("Cache limit and trim"){
+		gpu::host_pool pool(100000);
+		CHECK(pool.cache_limit() == 100000);
+
+		std::vector<void *> ptrs;
+		for(int ii = 0; ii < 10; ii++) ptrs.push_back(pool.allocate(30000));
+		for(auto ptr : ptrs) pool.deallocate(ptr);
+
+		CHECK(pool.stats().in_use == 0);
+		CHECK(pool.stats().cached > 0);
+		CHECK(pool.stats().cached <= 100000);
+
+		pool.trim(40000);
+		CHECK(pool.stats().cached <= 40000);
+
+		pool.cache_limit(0);
+		CHECK(pool.stats().cached == 0);
+
+		auto ptr = pool.allocate(30000);
+		pool.deallocate(ptr);
+		CHECK(pool.stats().cached == 0);
+	}
+
+	SECTION("Zero size"){
+		gpu::host_pool pool;
+		auto ptr = pool.allocate(0);
+		CHECK(ptr != nullptr);
+		pool.deallocate(ptr);
+		pool.deallocate(nullptr);
+		pool.release();
+	}
+
+	SECTION("Threads"){
+		gpu::host_pool pool;
+
+		std::vector<std::thread> threads;
+		for(int ith = 0; ith < 4; ith++){
+			threads.emplace_back([&pool, ith] {
+				for(int iter = 0; iter < 100; iter++){
+					auto size = std::size_t(1) << (4 + (iter + ith)%12);
+					auto ptr = static_cast<char *>(pool.allocate(size));
+					ptr[0] = 'a';
+					ptr[size - 1] = 'b';
+					pool.deallocate(ptr);
+				}
+			});
+		}
+		for(auto & th : threads) th.join();
+
+		CHECK(pool.stats().allocations == 400);
+		CHECK(pool.stats().in_use == 0);
+		CHECK(pool.stats().hits > 0);
+		pool.release();
+	}
+
+	SECTION("Allocator"){
+		std::vector<double, gpu::host_caching_allocator<double>> vec(1234, 3.0);
+		CHECK(vec[1233] == 3.0);
+		vec.resize(5000, 1.0);
+		CHECK(vec[0] == 3.0);
+		CHECK(vec[4999] == 1.0);
+		CHECK(gpu::host_caching_allocator<double>{} == gpu::host_caching_allocator<int>{});
+	}
+
+}
+#endif
@@ -29,6 +29,19 @@ struct reduce {
 	long size;
 };
 
+#ifdef ENABLE_CUDA
+// The reduction kernels keep one value per thread in shared memory,
+// that is limited to 48 KiB, so for large types (like the several
+// values of a multiple overlap) the block is made smaller. The result
+// is a power of two, as the tree reduction requires.
+template <class type>
+unsigned reduce_block_size(int max_size) {
+	unsigned size = 1;
+	while(2*size <= unsigned(max_size) and 2*size*sizeof(type) <= 48*1024) size *= 2;
+	return size;
+}
+#endif
+
 
 #ifdef ENABLE_CUDA
 template <class kernel_type, class array_type>
@@ -94,7 +107,7 @@ auto run(reduce const & red, kernel_type kernel) -> decltype(kernel(0)) {
 
 #else
 
-	const int blocksize = 1024;
+	const int blocksize = reduce_block_size<type>(1024);
 
 	unsigned nblock = (size + blocksize - 1)/blocksize;
 	gpu::array<type, 1> result(nblock);
@@ -166,7 +179,7 @@ auto run(reduce const & redx, reduce const & redy, kernel_type kernel) -> declty
 
 #else
 
-	const int bsizex = 1024;
+	const int bsizex = reduce_block_size<type>(1024);
 	const int bsizey = 1;
 
 	unsigned nblockx = (sizex + bsizex - 1)/bsizex;
@@ -250,7 +263,7 @@ auto run(reduce const & redx, reduce const & redy, reduce const & redz, kernel_t
 	int mingridsize, blocksize;
 	check_error(cudaOccupancyMaxPotentialBlockSize(&mingridsize, &blocksize, reduce_kernel_rrr<kernel_type, decltype(begin(std::declval<gpu::array<type, 3>&>()))>));
 
-	const unsigned bsizex = blocksize;
+	const unsigned bsizex = reduce_block_size<type>(blocksize);
 	const unsigned bsizey = 1;
 	const unsigned bsizez = 1;
 
@@ -337,6 +350,7 @@ auto run(long sizex, reduce const & redy, kernel_type kernel) -> gpu::array<decl
 	int blocksize = 0;
 
 	check_error(cudaOccupancyMaxPotentialBlockSize(&mingridsize, &blocksize, reduce_kernel_vr<kernel_type, decltype(begin(result))>));
+	blocksize = reduce_block_size<type>(blocksize);
 	
 	unsigned bsizex = 4; //this seems to be the optimal value
 	if(sizex <= 2) bsizex = sizex;
@@ -439,6 +453,7 @@ auto run(long sizex, reduce const & redy, reduce const & redz, kernel_type kerne
 	int blocksize = 0;
 
 	check_error(cudaOccupancyMaxPotentialBlockSize(&mingridsize, &blocksize, reduce_kernel_vrr<kernel_type, decltype(begin(result))>));
+	blocksize = reduce_block_size<type>(blocksize);
 	
 	unsigned bsizex = 4; //this seems to be the optimal value
 	if(sizex <= 2) bsizex = sizex;
@@ -506,6 +521,28 @@ struct prod3 {
   }
 };
 
+// a 128 byte type, 1024 of these do not fit in the shared memory
+struct large_value {
+	double values[16];
+
+	GPU_FUNCTION large_value(double val = 0.0) {
+		for(int ii = 0; ii < 16; ii++) values[ii] = val;
+	}
+
+	GPU_FUNCTION auto & operator+=(large_value const & other) {
+		for(int ii = 0; ii < 16; ii++) values[ii] += other.values[ii];
+		return *this;
+	}
+};
+
+struct prod_large {
+  GPU_FUNCTION auto operator()(long ix, long iy) const {
+		large_value res;
+		for(int ii = 0; ii < 16; ii++) res.values[ii] = (ii + 1.0)*double(ix)*double(iy);
+    return res;
+  }
+};
+
 TEST_CASE(GPURUN_TEST_FILE, GPURUN_TEST_TAG) {
   
 	using namespace Catch::literals;
@@ -575,6 +612,23 @@ TEST_CASE(GPURUN_TEST_FILE, GPURUN_TEST_TAG) {
 			}
 		}
 		
+  }
+
+	SECTION("vr large type"){
+
+		for(long nx = 1; nx <= 100; nx *= 10){
+			for(long ny = 1; ny <= 15625; ny *= 25){
+
+				auto res = gpu::run(nx, gpu::reduce(ny), prod_large{});
+
+				CHECK(res.size() == nx);
+				for(long ix = 0; ix < nx; ix++) {
+					CHECK(res[ix].values[0] == double(ix)*ny*(ny - 1.0)/2.0);
+					CHECK(res[ix].values[15] == 16.0*double(ix)*ny*(ny - 1.0)/2.0);
+				}
+			}
+		}
+		
   }
 
 	SECTION("vrr"){
@@ -26,7 +26,75 @@ private:
 	options::theory theo_;
 	options::electrons els_;
 	ground_state::results results_;
+	std::optional<systems::ions> ions_;
 	std::optional<systems::electrons> electrons_;
+	std::optional<ground_state::calculator> ground_state_;
+	std::optional<basis::field<basis::real_space, double>> vion_;
+
+	std::vector<py::weakref> views_;
+
+	// A numpy array with the values of a field. By default it is a copy. With
+	// copy = false it uses the memory of the field instead. The memory is
+	// unified in GPU builds, so it can be accessed from the host. The view
+	// keeps the calculator alive, but the fields can be reallocated by a
+	// calculation, so the calculator refuses to run while a view exists.
+	template <typename Type, typename ArrayType>
+	auto numpy_array(ArrayType const & arr, bool const copy, bool const writable){
+		assert(arr.is_compact());
+
+		gpu::sync();
+
+		auto shape = std::vector<py::ssize_t>{std::get<0>(sizes(arr)), std::get<1>(sizes(arr)), std::get<2>(sizes(arr)), std::get<3>(sizes(arr))};
+		auto data = const_cast<Type *>(reinterpret_cast<Type const *>(raw_pointer_cast(arr.base())));
+
+		if(copy) return py::array_t<Type>(shape, data);
+		
+		auto view = py::array_t<Type>(shape, data, py::cast(this));
+		if(not writable) view.attr("setflags")("write"_a = false);
+		views_.emplace_back(view);
+		return view;
+	}
+
+	void check_views(){
+		for(auto & view : views_){
+			if(not view().is_none()) throw std::runtime_error("pinq: The arrays obtained with copy=False have to be deleted before the next calculation, since it can reallocate their memory.");
+		}
+		views_.clear();
+	}
+	
+	// When only the positions of the atoms change between calls, the
+	// electrons, the basis and the hamiltonian are kept and the previous
+	// orbitals and density are the starting point of the new calculation.
+	// This is not possible if the k-points were reduced with symmetries,
+	// since the new positions can have different ones, in that case
+	// everything is created again.
+	void update_ions(py::object atoms){
+
+		auto ions = systems::ions::import_ase(atoms);
+
+		if(ions_.has_value() and ions.cell() == ions_->cell() and ions.symbols() == ions_->symbols()){
+
+			auto moved = false;
+			for(int iatom = 0; iatom < ions.size(); iatom++) moved = moved or (ions.positions()[iatom] != ions_->positions()[iatom]);
+			if(not moved) return;
+
+			if(electrons_->brillouin_zone().symmetries().size() == 1) {
+				// the ground-state calculator keeps a reference to ions_, so we only update the positions
+				for(int iatom = 0; iatom < ions.size(); iatom++) ions_->positions()[iatom] = ions.positions()[iatom];
+				ground_state_->update_ions(*electrons_);
+				vion_.reset();
+				return;
+			}
+		}
+
+		ground_state_.reset();
+		vion_.reset();
+		
+		ions_.emplace(std::move(ions));
+		electrons_.emplace(systems::electrons(*ions_, els_));
+		ground_state::initial_guess(*ions_, *electrons_);
+		ground_state_.emplace(*ions_, *electrons_, theo_, options::ground_state{}.energy_tolerance(1e-9_Ha).calculate_forces());
+	}
 	
 public:
 	
@@ -86,77 +154,71 @@ public:
 
 	///////////////////////////////////
 	
-	auto get_density(){
-
+	auto get_density(bool const copy, bool const writable){
 		assert(electrons_.has_value());
-
-		auto const & dens = electrons_->spin_density().hypercubic();
-			
-		auto dx = std::get<0>(sizes(dens));
-		auto dy = std::get<1>(sizes(dens));
-		auto dz = std::get<2>(sizes(dens));
-		auto dspin = std::get<3>(sizes(dens));		
-		
-		py::array_t<double, py::array::c_style> density_array({dx, dy, dz, dspin});
-		
-    auto arr = density_array.mutable_unchecked();
-		
-    for (py::ssize_t ix = 0; ix < arr.shape(0); ix++) {
-			for (py::ssize_t iy = 0; iy < arr.shape(1); iy++) {
-				for (py::ssize_t iz = 0; iz < arr.shape(2); iz++) {
-					for (py::ssize_t ispin = 0; ispin < arr.shape(3); ispin++) {
-						arr(ix, iy, iz, ispin) = dens[ix][iy][iz][ispin];
-					}
-				}
-			}
-    }
-		
-    return density_array;
+		return numpy_array<double>(electrons_->spin_density().hypercubic(), copy, writable);
 	}
 
 	///////////////////////////////////
 	
-	void calculate(py::object atoms){
-		
-		auto ions = systems::ions::import_ase(atoms);
+	auto get_potential(bool const copy, bool const writable){
+		assert(ground_state_.has_value());
+		return numpy_array<double>(ground_state_->hamiltonian().scalar_potential().hypercubic(), copy, writable);
+	}
 
-		electrons_.emplace(systems::electrons(ions, els_));
-		ground_state::initial_guess(ions, *electrons_);
+	///////////////////////////////////
+	
+	auto get_orbitals(int const ikpin, bool const copy, bool const writable){
+		assert(electrons_.has_value());
+		if(ikpin < 0 or ikpin >= long(electrons_->kpin().size())) throw std::runtime_error("pinq: Invalid orbital block index " + std::to_string(ikpin) + ".");
+		return numpy_array<std::complex<double>>(electrons_->kpin()[ikpin].hypercubic(), copy, writable);
+	}
 
-		results_ = ground_state::calculate(ions, *electrons_, theo_, options::ground_state{}.energy_tolerance(1e-9_Ha).calculate_forces());
+	///////////////////////////////////
+	
+	void calculate(py::object atoms){
+		check_views();
+		update_ions(atoms);
+		results_ = (*ground_state_)(*electrons_);
 	}
 
 	///////////////////////////////////
 	
-	auto scf_step(py::object atoms, py::array_t<double> const & potential){
-		
-		auto ions = systems::ions::import_ase(atoms);
+	auto scf_step(py::object atoms, py::array_t<double, py::array::c_style | py::array::forcecast> const & potential){
 
-		if(not electrons_.has_value()){
-			electrons_.emplace(systems::electrons(ions, els_));
-			ground_state::initial_guess(ions, *electrons_);
-		}
+		check_views();
+		update_ions(atoms);
 
-		solvers::poisson poisson_solver;
-		
-		auto ionic_long_range = poisson_solver(electrons_->atomic_pot().ionic_density(electrons_->kpin_states_comm(), electrons_->density_basis(), ions));
-		auto ionic_short_range = electrons_->atomic_pot().local_potential(electrons_->kpin_states_comm(), electrons_->density_basis(), ions);
-		auto vion = operations::add(ionic_long_range, ionic_short_range);
-		
-		auto ham = hamiltonian::ks_hamiltonian<double>(electrons_->states_basis(), electrons_->brillouin_zone(), electrons_->states(), electrons_->atomic_pot(),
-																									 ions, /*exx_coefficient = */ 0.0, /* use_ace = */ true);
+		if(not vion_.has_value()){
+			solvers::poisson poisson_solver;
+			auto ionic_long_range = poisson_solver(electrons_->atomic_pot().ionic_density(electrons_->kpin_states_comm(), electrons_->density_basis(), *ions_));
+			auto ionic_short_range = electrons_->atomic_pot().local_potential(electrons_->kpin_states_comm(), electrons_->density_basis(), *ions_);
+			vion_.emplace(operations::add(ionic_long_range, ionic_short_range));
+		}
 
-    auto pot = potential.unchecked();
+		auto & vion = *vion_;
+		auto & ham = ground_state_->hamiltonian();
+
+		// the potential must have the shape of the one returned by get_potential
+		auto vks = ham.scalar_potential().hypercubic();
+		auto shape = std::vector<py::ssize_t>{std::get<0>(sizes(vks)), std::get<1>(sizes(vks)), std::get<2>(sizes(vks)), std::get<3>(sizes(vks))};
+		auto valid = potential.ndim() == long(shape.size());
+		for(int idim = 0; valid and idim < long(shape.size()); idim++) valid = potential.shape(idim) == shape[idim];
+		if(not valid) {
+			auto shape_str = std::string{};
+			for(auto const & dim : shape) shape_str += (shape_str.empty() ? "" : ", ") + std::to_string(dim);
+			throw std::runtime_error("pinq: The potential for scf_step must be an array with shape (" + shape_str + ").");
+		}
 		
-		for (py::ssize_t ix = 0; ix < pot.shape(0); ix++) {
-			for (py::ssize_t iy = 0; iy < pot.shape(1); iy++) {
-				for (py::ssize_t iz = 0; iz < pot.shape(2); iz++) {
-					for (py::ssize_t ispin = 0; ispin < pot.shape(3); ispin++) {
-						ham.scalar_potential().hypercubic()[ix][iy][iz][ispin] = vion.cubic()[ix][iy][iz] + pot(ix, iy, iz, ispin);
-					}
-				}
-			}
-    }
+		// the layout of the numpy array is the same as the one of the potential, so we can copy it linearly
+		gpu::sync();
+		auto nspin = ham.scalar_potential().set_size();
+		auto vpot = raw_pointer_cast(ham.scalar_potential().matrix().data_elements());
+		auto vi = raw_pointer_cast(vion.linear().data_elements());
+		auto pot = potential.data();
+		for(long ip = 0; ip < ham.scalar_potential().basis().local_size(); ip++){
+			for(int ispin = 0; ispin < nspin; ispin++) vpot[ip*nspin + ispin] = vi[ip] + pot[ip*nspin + ispin];
+		}
 
 		//subspace diagonalization
 		int ilot = 0;
@@ -179,7 +241,7 @@ public:
 
 		results_.energy.calculate(ham, *electrons_);
 		
-		return get_density();
+		return get_density(/* copy = */ true, /* writable = */ false);
 	}
 	
 };
@@ -196,7 +258,9 @@ PYBIND11_MODULE(_pinq, module) {
 		.def(py::init<py::args, py::kwargs&>())
 		.def("get_potential_energy", &calculator::get_potential_energy)
 		.def("get_forces",           &calculator::get_forces)
-		.def("get_density",          &calculator::get_density)		
+		.def("get_density",          &calculator::get_density,   "copy"_a = true, "writable"_a = false)
+		.def("get_potential",        &calculator::get_potential, "copy"_a = true, "writable"_a = false)
+		.def("get_orbitals",         &calculator::get_orbitals,  "index"_a = 0, "copy"_a = true, "writable"_a = false)
 		.def("calculate",            &calculator::calculate)
 		.def("scf_step",             &calculator::scf_step);
 
@@ -27,17 +27,31 @@ class real_space;
 
 		using reciprocal_space = real_space;
 		
-    fourier_space(const grid & grid_basis):
-			grid(grid_basis){
-			
-			cubic_part_ = {inq::parallel::partition(nr_[0]), inq::parallel::partition(nr_[1]), inq::parallel::partition(nr_[2], comm())};
+    fourier_space(const grid & grid_basis, bool const half_spectrum = false):
+			grid(grid_basis),
+			half_spectrum_(half_spectrum){
 
-			base::part_ = cubic_part_[2];
-			base::part_ *= nr_[0]*long(nr_[1]);
+			// For the transform of real functions we only store the nz/2 + 1 independent z planes.
+			auto nz = nr_[2];
+			if(half_spectrum_) nz = nr_[2]/2 + 1;
+			
+			if(pencil()) {
+				// y and z are distributed, x is local
+				cubic_part_ = {inq::parallel::partition(nr_[0]), inq::parallel::partition(nr_[1], pencil_comm(0)), inq::parallel::partition(nz, pencil_comm(1))};
+				base::part_ = pencil_linear_part(1, 2);
+			} else {
+				cubic_part_ = {inq::parallel::partition(nr_[0]), inq::parallel::partition(nr_[1]), inq::parallel::partition(nz, comm())};
+				base::part_ = cubic_part_[2];
+				base::part_ *= nr_[0]*long(nr_[1]);
+			}
 			
 			for(int idir = 0; idir < 3; idir++) nr_local_[idir] = cubic_part_[idir].local_size();			
     }
 
+		auto half_spectrum() const {
+			return half_spectrum_;
+		}
+		
 		auto volume_element() const {
 			return cell().volume()/(size()*size());
 
@@ -48,6 +62,7 @@ class real_space;
 			equal = equal and fs1.covspacing_[0] == fs2.covspacing_[0];
 			equal = equal and fs1.covspacing_[1] == fs2.covspacing_[1];
 			equal = equal and fs1.covspacing_[2] == fs2.covspacing_[2];
+			equal = equal and fs1.half_spectrum_ == fs2.half_spectrum_;
 			return equal;
 		}
 		
@@ -147,6 +162,8 @@ class real_space;
 		}
 		
 	private:
+
+		bool half_spectrum_;
 		
   };
 
@@ -161,5 +178,59 @@ class real_space;
 
 TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 
+	using namespace inq;
+	using namespace inq::magnitude;
+	using namespace Catch::literals;
+
+	parallel::communicator comm{boost::mpi3::environment::get_world_instance()};
+
+	basis::grid gr(systems::cell::orthorhombic(10.0_b, 4.0_b, 7.0_b), {120, 45, 77}, comm);
+
+	basis::fourier_space fs(gr);
+
+	CHECK(not fs.half_spectrum());
+	CHECK(fs.cubic_part(0).size() == 120);
+	CHECK(fs.cubic_part(1).size() == 45);
+	CHECK(fs.cubic_part(2).size() == 77);
+	CHECK(fs.size() == 120*45*77);
+	
+	basis::fourier_space hfs(gr, /* half_spectrum = */ true);
+
+	CHECK(hfs.half_spectrum());
+	CHECK(hfs.cubic_part(0).size() == 120);
+	CHECK(hfs.cubic_part(1).size() == 45);
+	CHECK(hfs.cubic_part(2).size() == 39);
+	CHECK(hfs.size() == 120*45*77);
+	CHECK(not (hfs == fs));
+	
+	basis::grid gr2(systems::cell::orthorhombic(10.0_b, 4.0_b, 7.0_b), {120, 45, 76}, comm);
+	basis::fourier_space hfs2(gr2, /* half_spectrum = */ true);
+
+	CHECK(hfs2.cubic_part(2).size() == 39);
+
+	// the last plane is the Nyquist frequency
+	if(hfs2.cubic_part(2).contains(38)) {
+		int iz = hfs2.cubic_part(2).global_to_local(parallel::global_index(38));
+		CHECK(hfs2.point_op().gvector(0, 0, iz)[2] == Catch::Approx(-38*2.0*M_PI));
+	}
+
+	if(comm.size()%2 == 0) {
+		basis::grid pgr(systems::cell::orthorhombic(10.0_b, 4.0_b, 7.0_b), {120, 45, 77}, comm, /* pencil_nproc = */ 2);
+		
+		basis::fourier_space pfs(pgr);
+		
+		CHECK(pfs.pencil());
+		CHECK(pfs.cubic_part(0).local_size() == 120);
+		CHECK(pfs.cubic_part(1).comm_size() == comm.size()/2);
+		CHECK(pfs.cubic_part(2).comm_size() == 2);
+		CHECK(pfs.local_size() == long(pfs.local_sizes()[0])*pfs.local_sizes()[1]*pfs.local_sizes()[2]);
+
+		basis::fourier_space phfs(pgr, /* half_spectrum = */ true);
+		
+		auto total = phfs.local_size();
+		comm.all_reduce_in_place_n(&total, 1, std::plus<>{});
+		CHECK(total == 120*45*39);
+	}
+	
 }
 #endif
@@ -11,6 +11,8 @@
 
 #include <cassert>
 #include <array>
+#include <memory>
+#include <stdexcept>
 
 #include <basis/base.hpp>
 #include <math/vector3.hpp>
@@ -24,17 +26,13 @@ namespace basis {
 
 		const static int dimension = 3;
 		
-		grid(const systems::cell & cell, std::array<int, 3> nr, parallel::communicator & comm) :
+		grid(const systems::cell & cell, std::array<int, 3> nr, parallel::communicator & comm, int pencil_nproc = 1) :
 			base(nr[0], comm),
 			cubic_part_({base::part_, inq::parallel::partition(nr[1]), inq::parallel::partition(nr[2])}),
 			cell_(cell),
-			nr_(nr){
+			nr_(nr),
+			pencil_nproc_(pencil_nproc){
 
-			if(base::part_.local_size() == 0){
-				std::cerr << "\n  Partition " << comm.rank() << " has 0 points. Please change the number of processors.\n" << std::endl;
-				comm.abort(1);
-			}
-			
 			for(int idir = 0; idir < 3; idir++){
 				rlength_[idir] = length(cell[idir]);
 				ng_[idir] = nr_[idir];
@@ -43,16 +41,38 @@ namespace basis {
 				covspacing_[idir] = 2.0*M_PI;				
 			}
 
-			base::part_ *= nr_[1]*long(nr_[2]);
-			
 			npoints_ = nr_[0]*long(nr_[1])*nr_[2];
 
+			if(pencil()) {
+				if(pencil_nproc_ < 1 or comm.size()%pencil_nproc_ != 0) {
+					throw std::runtime_error("inq error: the number of domain processors (" + std::to_string(comm.size())
+																	 + ") is not a multiple of the pencil size (" + std::to_string(pencil_nproc_) + ")");
+				}
+
+				// the processes are arranged in a (comm.size()/pencil_nproc) x pencil_nproc grid, with rank = iproc0*pencil_nproc + iproc1
+				auto iproc0 = comm.rank()/pencil_nproc_;
+				auto iproc1 = comm.rank()%pencil_nproc_;
+				pencil_comm_[0] = std::make_shared<parallel::communicator>(comm.split(/* color = */ iproc1, /* key = */ iproc0));
+				pencil_comm_[1] = std::make_shared<parallel::communicator>(comm.split(/* color = */ iproc0, /* key = */ iproc1));
+				
+				cubic_part_ = {inq::parallel::partition(nr_[0], pencil_comm(0)), inq::parallel::partition(nr_[1], pencil_comm(1)), inq::parallel::partition(nr_[2])};
+				base::part_ = pencil_linear_part(0, 1);
+			} else {
+				base::part_ *= nr_[1]*long(nr_[2]);
+			}
+
+			if(base::part_.local_size() == 0){
+				std::cerr << "\n  Partition " << comm.rank() << " has 0 points. Please change the number of processors.\n" << std::endl;
+				comm.abort(1);
+			}
+
 			for(int idir = 0; idir < 3; idir++) nr_local_[idir] = cubic_part_[idir].local_size();
 			
 		}
 		
+		// the pencil decomposition is kept only if it is compatible with the new communicator
 		grid(grid && old, parallel::communicator new_comm):
-			grid(old.cell_, old.nr_, new_comm)
+			grid(old.cell_, old.nr_, new_comm, (new_comm.size()%old.pencil_nproc_ == 0) ? old.pencil_nproc_ : 1)
 		{
 		}
 		
@@ -172,8 +192,39 @@ namespace basis {
 			return cell_;
 		}	
 
+		// In the pencil decomposition the domains are split in two
+		// dimensions over a grid of processes of size (comm().size()/pencil_nproc) x pencil_nproc.
+		auto pencil() const {
+			return pencil_nproc_ > 1;
+		}
+
+		auto pencil_nproc() const {
+			return pencil_nproc_;
+		}
+
+		// the sub-communicators along each axis of the process grid
+		auto & pencil_comm(int idir) const {
+			assert(pencil());
+			assert(idir == 0 or idir == 1);
+			return *pencil_comm_[idir];
+		}
+
 	protected:
 
+		// The linear partition when the dimensions dim0 and dim1 are
+		// distributed over the axes of the pencil process grid. The local
+		// points are not contiguous in the linear index, so only the sizes
+		// are meaningful.
+		auto pencil_linear_part(int dim0, int dim1) const {
+			auto dim2 = 3 - dim0 - dim1;
+			long factor = cubic_part_[dim2].size();
+			auto & part0 = cubic_part_[dim0];
+			auto & part1 = cubic_part_[dim1];
+			auto start = factor*(part0.start()*part1.size() + part0.local_size()*part1.start());
+			auto end = start + factor*part0.local_size()*part1.local_size();
+			return inq::parallel::partition(factor*part0.size()*part1.size(), comm_.size(), start, end, factor*part0.max_local_size()*part1.max_local_size());
+		}
+
 		std::array<inq::parallel::partition, 3> cubic_part_;
 		systems::cell cell_;
 
@@ -191,6 +242,9 @@ namespace basis {
 
 		long npoints_;
 
+		int pencil_nproc_;
+		std::array<std::shared_ptr<parallel::communicator>, 2> pencil_comm_;
+
   };
 
 }
@@ -257,6 +311,35 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 	CHECK(gr.sizes() == new_gr.sizes());
 	CHECK(new_gr.local_sizes() == new_gr.sizes());
 	CHECK(gr.cell().periodicity() == new_gr.cell().periodicity());	
+
+	SECTION("Pencil decomposition"){
+
+		auto nproc1 = (comm.size()%2 == 0) ? 2 : 1;
+		
+		basis::grid pgr(cell, {120, 45, 77}, comm, nproc1);
+
+		CHECK(pgr.pencil() == (nproc1 > 1));
+		CHECK(pgr.pencil_nproc() == nproc1);
+		CHECK(pgr.cubic_part(2).local_size() == 77);
+
+		if(pgr.pencil()) {
+			CHECK(pgr.pencil_comm(0).size() == comm.size()/2);
+			CHECK(pgr.pencil_comm(1).size() == 2);
+			CHECK(pgr.cubic_part(0).comm_size() == comm.size()/2);
+			CHECK(pgr.cubic_part(1).comm_size() == 2);
+		}
+		
+		CHECK(pgr.local_size() == long(pgr.local_sizes()[0])*pgr.local_sizes()[1]*pgr.local_sizes()[2]);
+		CHECK(pgr.part().parallel() == (comm.size() > 1));
+
+		auto total = pgr.local_size();
+		comm.all_reduce_in_place_n(&total, 1, std::plus<>{});
+		CHECK(total == pgr.size());
+	}
+
+	SECTION("Invalid pencil size"){
+		CHECK_THROWS(basis::grid(cell, {120, 45, 77}, comm, comm.size() + 1));
+	}
 	
 }
 #endif
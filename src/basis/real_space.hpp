@@ -27,18 +27,23 @@ class fourier_space;
 
 		using reciprocal_space = fourier_space;
 
-		real_space(systems::cell const & cell, double const & spacing, parallel::communicator comm):
-			grid(cell, calculate_dimensions(cell, spacing), comm)
+		real_space(systems::cell const & cell, double const & spacing, parallel::communicator comm, int pencil_nproc = 1):
+			grid(cell, calculate_dimensions(cell, spacing), comm, pencil_nproc)
 		{
     }
 
 		real_space(const grid & grid_basis):
 			grid(grid_basis){
-			
-			cubic_part_ = {inq::parallel::partition(nr_[0], grid_basis.comm()), inq::parallel::partition(nr_[1]), inq::parallel::partition(nr_[2])};
 
-			base::part_ = cubic_part_[0];
-			base::part_ *= nr_[1]*long(nr_[2]);
+			if(pencil()) {
+				// x and y are distributed, z is local
+				cubic_part_ = {inq::parallel::partition(nr_[0], pencil_comm(0)), inq::parallel::partition(nr_[1], pencil_comm(1)), inq::parallel::partition(nr_[2])};
+				base::part_ = pencil_linear_part(0, 1);
+			} else {
+				cubic_part_ = {inq::parallel::partition(nr_[0], grid_basis.comm()), inq::parallel::partition(nr_[1]), inq::parallel::partition(nr_[2])};
+				base::part_ = cubic_part_[0];
+				base::part_ *= nr_[1]*long(nr_[2]);
+			}
 			
 			for(int idir = 0; idir < 3; idir++) nr_local_[idir] = cubic_part_[idir].local_size();		
     }
@@ -135,16 +140,16 @@ class fourier_space;
 		}
 
 		auto enlarge(int factor) const {
-			return real_space(grid(cell_.enlarge(factor), {factor*nr_[0], factor*nr_[1], factor*nr_[2]}, this->comm()));
+			return real_space(grid(cell_.enlarge(factor), {factor*nr_[0], factor*nr_[1], factor*nr_[2]}, this->comm(), pencil_nproc_));
 		}
 
 		auto enlarge(vector3<int> factor) const {
-			return real_space(grid(cell_.enlarge(factor), {factor[0]*nr_[0], factor[1]*nr_[1], factor[2]*nr_[2]},  this->comm()));
+			return real_space(grid(cell_.enlarge(factor), {factor[0]*nr_[0], factor[1]*nr_[1], factor[2]*nr_[2]},  this->comm(), pencil_nproc_));
 		}
 		
 		auto refine(double factor) const {
 			assert(factor > 0.0);
-			return real_space(grid(cell_, {(int) round(factor*nr_[0]), (int) round(factor*nr_[1]), (int) round(factor*nr_[2])}, this->comm()));
+			return real_space(grid(cell_, {(int) round(factor*nr_[0]), (int) round(factor*nr_[1]), (int) round(factor*nr_[2])}, this->comm(), pencil_nproc_));
 		}
 		
 		auto volume_element() const {
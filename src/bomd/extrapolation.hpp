@@ -0,0 +1,211 @@
+/* -*- indent-tabs-mode: t -*- */
+#ifndef INQ__BOMD__EXTRAPOLATION
+#define INQ__BOMD__EXTRAPOLATION
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <observables/density.hpp>
+#include <operations/orthogonalize.hpp>
+#include <operations/overlap.hpp>
+#include <operations/rotate.hpp>
+#include <systems/electrons.hpp>
+#include <utils/profiling.hpp>
+
+#include <deque>
+#include <vector>
+
+namespace inq {
+namespace bomd {
+
+// The predictor of the always stable predictor-corrector (ASPC)
+// scheme of Kolafa, J. Comput. Chem. 25, 335 (2004). The orbitals for
+// the next step are a combination of the converged orbitals of the
+// last steps. To make the combination independent of the rotations
+// inside each subspace, each set is projected on the last orbitals,
+// the projector C_j C_j^+ is what gets extrapolated (like in CP2K).
+// The density is then calculated from the predicted orbitals.
+
+class extrapolation {
+
+	int max_size_;
+	std::deque<systems::electrons::kpin_type> history_;
+
+public:
+
+	// the coefficients for num_points steps, the first one multiplies the last step
+	static auto coefficients(int num_points) {
+		assert(num_points >= 1);
+
+		auto binomial = [](int nn, int kk){
+			auto res = 1.0;
+			for(int ii = 1; ii <= kk; ii++) res = res*(nn - kk + ii)/ii;
+			return res;
+		};
+
+		auto coeff = std::vector<double>(num_points);
+
+		if(num_points == 1) {
+			coeff[0] = 1.0;
+			return coeff;
+		}
+
+		auto order = num_points - 2;
+		for(int jj = 1; jj <= num_points; jj++){
+			coeff[jj - 1] = ((jj%2 == 1) ? 1.0 : -1.0)*jj*binomial(2*order + 4, order + 2 - jj)/binomial(2*order + 2, order + 1);
+		}
+		return coeff;
+	}
+
+	explicit extrapolation(int const max_size):
+		max_size_(max_size){
+		assert(max_size_ >= 1);
+	}
+
+	auto size() const {
+		return long(history_.size());
+	}
+
+	// stores the converged orbitals of the current step
+	void push(systems::electrons const & electrons) {
+		CALI_CXX_MARK_FUNCTION;
+
+		if(max_size_ == 1) return;
+		history_.push_front(electrons.kpin());
+		if(long(history_.size()) > max_size_) history_.pop_back();
+	}
+
+	// replaces the orbitals and the density of electrons by the prediction for the next step
+	void predict(systems::electrons & electrons) const {
+		CALI_CXX_MARK_FUNCTION;
+
+		if(history_.size() < 2) return;
+
+		auto coeff = coefficients(history_.size());
+
+		int iphi = 0;
+		for(auto & phi : electrons.kpin()) {
+			auto const & latest = history_[0][iphi];
+			for(int ihist = 0; ihist < long(history_.size()); ihist++){
+				auto const & old_phi = history_[ihist][iphi];
+				auto olap = operations::overlap(old_phi, latest);
+				operations::rotate(olap, old_phi, phi, complex(coeff[ihist], 0.0), complex((ihist == 0) ? 0.0 : 1.0, 0.0));
+			}
+			operations::orthogonalize(phi);
+			iphi++;
+		}
+
+		electrons.spin_density() = observables::density::calculate(electrons);
+	}
+
+};
+
+}
+}
+#endif
+
+#ifdef INQ_BOMD_EXTRAPOLATION_UNIT_TEST
+#undef INQ_BOMD_EXTRAPOLATION_UNIT_TEST
+
+#include <catch2/catch_all.hpp>
+#include <operations/integral.hpp>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+	using namespace inq;
+	using namespace inq::magnitude;
+	using namespace Catch::literals;
+	using Catch::Approx;
+
+	SECTION("Coefficients"){
+		auto c1 = bomd::extrapolation::coefficients(1);
+		CHECK(c1.size() == 1);
+		CHECK(c1[0] == 1.0_a);
+
+		// linear extrapolation
+		auto c2 = bomd::extrapolation::coefficients(2);
+		CHECK(c2[0] ==  2.0_a);
+		CHECK(c2[1] == -1.0_a);
+
+		auto c3 = bomd::extrapolation::coefficients(3);
+		CHECK(c3[0] ==  2.5_a);
+		CHECK(c3[1] == -2.0_a);
+		CHECK(c3[2] ==  0.5_a);
+
+		auto c4 = bomd::extrapolation::coefficients(4);
+		CHECK(c4[0] ==  2.8_a);
+		CHECK(c4[1] == -2.8_a);
+		CHECK(c4[2] ==  1.2_a);
+		CHECK(c4[3] == -0.2_a);
+
+		// the coefficients always add to one
+		for(int num = 1; num < 8; num++){
+			auto cc = bomd::extrapolation::coefficients(num);
+			auto sum = 0.0;
+			for(auto const & val : cc) sum += val;
+			CHECK(sum == 1.0_a);
+		}
+	}
+
+	SECTION("Smooth trajectory"){
+
+		parallel::communicator comm{boost::mpi3::environment::get_world_instance()};
+
+		systems::ions ions(systems::cell::cubic(8.0_b));
+		ions.insert("He", {0.0_b, 0.0_b, 0.0_b});
+
+		auto par = input::parallelization(comm);
+		systems::electrons electrons(par, ions, options::electrons{}.cutoff(20.0_Ha).extra_states(1));
+
+		// two gaussians that move with constant velocity
+		auto set_orbitals = [&electrons](double const time){
+			int iphi = 0;
+			for(auto & phi : electrons.kpin()) {
+				for(int ix = 0; ix < phi.basis().local_sizes()[0]; ix++){
+					for(int iy = 0; iy < phi.basis().local_sizes()[1]; iy++){
+						for(int iz = 0; iz < phi.basis().local_sizes()[2]; iz++){
+							auto ixg = phi.basis().cubic_part(0).local_to_global(ix);
+							auto iyg = phi.basis().cubic_part(1).local_to_global(iy);
+							auto izg = phi.basis().cubic_part(2).local_to_global(iz);
+							auto rr = phi.basis().point_op().rvector_cartesian(ixg, iyg, izg);
+							
+							for(int ist = 0; ist < phi.local_set_size(); ist++){
+								auto istg = phi.set_part().local_to_global(ist).value();
+								auto center = vector3<double>{0.2*time*(1 - istg), 1.5*istg, 0.2*time*istg};
+								phi.hypercubic()[ix][iy][iz][ist] = exp(-0.5*norm(rr - center));
+							}
+						}
+					}
+				}
+				operations::orthogonalize(phi);
+				for(int ist = 0; ist < phi.local_set_size(); ist++) electrons.occupations()[iphi][ist] = 1.0;
+				iphi++;
+			}
+			return observables::density::calculate(electrons);
+		};
+
+		auto extrap = bomd::extrapolation(3);
+		
+		for(int istep = 0; istep < 3; istep++){
+			set_orbitals(istep);
+			extrap.push(electrons);
+		}
+
+		CHECK(extrap.size() == 3);
+
+		auto previous_density = observables::density::calculate(electrons);
+		auto exact_density = set_orbitals(3.0);
+
+		extrap.predict(electrons);
+
+		auto previous_error = operations::integral_sum_absdiff(previous_density, exact_density);
+		auto predicted_error = operations::integral_sum_absdiff(electrons.spin_density(), exact_density);
+
+		CHECK(previous_error > 1e-3);
+		CHECK(predicted_error < 0.5*previous_error);
+	}
+
+}
+#endif
@@ -8,6 +8,7 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
+#include <bomd/extrapolation.hpp>
 #include <ground_state/calculate.hpp>
 #include <ionic/propagator.hpp>
 #include <options/real_time.hpp>
@@ -29,6 +30,11 @@ void propagate(systems::ions & ions, systems::electrons & electrons,  ProcessFun
 		
 		auto console = electrons.logger();
 
+		// the ionic motion breaks the symmetries, so all the k-points are needed
+		if(electrons.brillouin_zone().symmetries().size() > 1) {
+			throw std::runtime_error("INQ error: Born-Oppenheimer propagation requires the full Brillouin zone, the k-point grid cannot be reduced with symmetries.");
+		}
+
 		const double dt = opts.dt();
 		const int numsteps = opts.num_steps();
 
@@ -41,6 +47,8 @@ void propagate(systems::ions & ions, systems::electrons & electrons,  ProcessFun
 
 		ground_state::results::energy_type energy;
 		ground_state::results::forces_type forces;
+
+		auto extrap = bomd::extrapolation(opts.extrapolation_steps_value());
 		
 		if(console) console->trace("starting Born-Oppenheimer propagation");
 
@@ -50,9 +58,14 @@ void propagate(systems::ions & ions, systems::electrons & electrons,  ProcessFun
 
 			auto time = istep*dt;
 			
-			if(istep > 0) ion_propagator.propagate_positions(dt, ions, forces);
+			if(istep > 0) {
+				ion_propagator.propagate_positions(dt, ions, forces);
+				calculate_gs.update_ions(electrons);
+				extrap.predict(electrons);
+			}
 			
 			auto res = calculate_gs(electrons);
+			extrap.push(electrons);
 			energy = res.energy;
 			forces = res.forces;
 
@@ -0,0 +1,157 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef INQ__EIGENSOLVERS__BLOCK_SET
+#define INQ__EIGENSOLVERS__BLOCK_SET
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <basis/field_set.hpp>
+#include <states/orbital_set.hpp>
+#include <utils/workspace.hpp>
+
+#include <map>
+#include <string>
+
+namespace inq {
+namespace eigensolvers {
+
+// a set of nblock orbitals with the basis and labels of phi, the set is not distributed
+template <class Basis, class Type, class PartitionType>
+auto block_set(basis::field_set<Basis, Type, PartitionType> const & phi, int const nblock) {
+	return basis::field_set<Basis, Type, PartitionType>(phi.basis(), nblock);
+}
+
+template <class Basis, class Type>
+auto block_set(states::orbital_set<Basis, Type> const & phi, int const nblock) {
+	return states::orbital_set<Basis, Type>(phi.basis(), nblock, phi.spinor_dim(), phi.kpoint(), phi.spin_index(),
+																					parallel::cartesian_communicator<2>(phi.basis().comm(), {phi.basis().comm().size(), 1}));
+}
+
+namespace block_set_detail {
+
+template <class Basis, class Type, class PartitionType>
+bool same_basis(basis::field_set<Basis, Type, PartitionType> const & set, basis::field_set<Basis, Type, PartitionType> const & phi) {
+	return set.basis() == phi.basis() and set.basis().comm().size() == phi.basis().comm().size();
+}
+
+template <class Basis, class Type>
+bool same_basis(states::orbital_set<Basis, Type> const & set, states::orbital_set<Basis, Type> const & phi) {
+	return set.basis().sizes() == phi.basis().sizes() and set.basis().comm().size() == phi.basis().comm().size()
+		and set.basis().cell() == phi.basis().cell() and set.spinor_dim() == phi.spinor_dim();
+}
+
+template <class Basis, class Type, class PartitionType>
+void relabel(basis::field_set<Basis, Type, PartitionType> &, basis::field_set<Basis, Type, PartitionType> const &) {
+}
+
+template <class Basis, class Type>
+void relabel(states::orbital_set<Basis, Type> & set, states::orbital_set<Basis, Type> const & phi) {
+	set.relabel(phi.kpoint(), phi.spin_index());
+}
+
+}
+
+// The buffers of the eigensolvers that work on a few orbitals at a
+// time. buffers(name, nblock) returns a block_set of phi, there is one
+// for each name and size. They are kept in the object, or in the
+// workspace if one is given.
+template <class field_set_type>
+class block_buffers {
+
+	field_set_type const & phi_;
+	utils::workspace * work_ = nullptr;
+	mutable std::map<std::string, field_set_type> sets_;
+
+public:
+
+	block_buffers(field_set_type const & phi):
+		phi_(phi){
+	}
+
+	block_buffers(field_set_type const & phi, utils::workspace & work):
+		phi_(phi),
+		work_(&work){
+	}
+
+	field_set_type & operator()(std::string const & name, int const nblock) const {
+		// the last block can be smaller, so the size is part of the name to keep both sets
+		auto key = name + ":" + std::to_string(nblock);
+
+		if(work_ == nullptr) {
+			auto it = sets_.find(key);
+			if(it == sets_.end()) it = sets_.emplace(key, block_set(phi_, nblock)).first;
+			return it->second;
+		}
+
+		auto & set = work_->get<field_set_type>(key,
+																						[this](auto const & set){ return block_set_detail::same_basis(set, phi_); },
+																						[this, nblock](){ return block_set(phi_, nblock); });
+		block_set_detail::relabel(set, phi_);
+		return set;
+	}
+
+	auto size() const {
+		return long(sets_.size());
+	}
+
+};
+
+}
+}
+#endif
+
+#ifdef INQ_EIGENSOLVERS_BLOCK_SET_UNIT_TEST
+#undef INQ_EIGENSOLVERS_BLOCK_SET_UNIT_TEST
+
+#include <basis/trivial.hpp>
+
+#include <catch2/catch_all.hpp>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+
+	using namespace inq;
+	using namespace Catch::literals;
+
+	basis::trivial bas(100, parallel::communicator{boost::mpi3::environment::get_self_instance()});
+
+	basis::field_set<basis::trivial, complex> phi(bas, 12);
+
+	SECTION("Block set"){
+		auto set = eigensolvers::block_set(phi, 3);
+		CHECK(set.basis() == phi.basis());
+		CHECK(set.set_size() == 3);
+		CHECK(set.local_set_size() == 3);
+	}
+
+	SECTION("Buffers"){
+		auto buffers = eigensolvers::block_buffers(phi);
+
+		auto & set1 = buffers("set", 8);
+		auto & set2 = buffers("set", 4);
+		auto & set3 = buffers("other", 8);
+
+		CHECK(set1.set_size() == 8);
+		CHECK(set2.set_size() == 4);
+		CHECK(&set1 != &set3);
+		CHECK(&buffers("set", 8) == &set1);
+		CHECK(buffers.size() == 3);
+	}
+
+	SECTION("Buffers in a workspace"){
+		utils::workspace work;
+		auto buffers = eigensolvers::block_buffers(phi, work);
+
+		auto & set1 = buffers("set", 8);
+		buffers("set", 4);
+
+		CHECK(&buffers("set", 8) == &set1);
+		CHECK(work.num_allocations() == 2);
+		CHECK(buffers.size() == 0);
+	}
+
+}
+#endif
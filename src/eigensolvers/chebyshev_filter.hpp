@@ -0,0 +1,289 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef INQ__EIGENSOLVERS__CHEBYSHEV_FILTER
+#define INQ__EIGENSOLVERS__CHEBYSHEV_FILTER
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <math/complex.hpp>
+#include <gpu/array.hpp>
+#include <eigensolvers/block_set.hpp>
+#include <matrix/diagonalize.hpp>
+#include <operations/orthogonalize.hpp>
+#include <operations/overlap_diagonal.hpp>
+#include <operations/randomize.hpp>
+#include <utils/workspace.hpp>
+
+#include <algorithm>
+#include <cfloat>
+
+namespace inq {
+namespace eigensolvers {
+
+// Chebyshev-filtered subspace iteration (CheFSI), following Zhou,
+// Saad, Tiago and Chelikowsky, J. Comput. Phys. 219, 172 (2006). The
+// filter amplifies the components of the orbitals below the cutoff
+// and only needs applications of the operator, the orbitals are
+// orthogonalized once at the end. The Rayleigh-Ritz step is done by
+// the caller with subspace_diagonalization, its eigenvalues give the
+// lower bound and the cutoff of the next filter.
+
+// Runs a few Lanczos steps on each vector of vv, starting from a
+// pseudo-random vector. The upper bound of the spectrum is the
+// largest Ritz value plus the norm of the last residual. This is
+// meant for a single vector, that is the same in all the processes
+// of the set communicator, so all of them get the same bound.
+template <class apply_type, class work_set_type>
+double lanczos_upper_bound(apply_type const & apply, work_set_type & vv, work_set_type & vprev, work_set_type & ff, int const num_steps = 10){
+
+	CALI_CXX_MARK_FUNCTION;
+
+	assert(num_steps >= 1);
+
+	auto nst = vv.local_spinor_set_size();
+
+	gpu::array<double, 2> alpha({num_steps, nst});
+	gpu::array<double, 2> beta({num_steps, nst});
+
+	// the random numbers only depend on the position in the basis
+	gpu::run(vv.local_set_size(), vv.basis().local_size(),
+					 [v = begin(vv.matrix()), seed = uint64_t(vv.basis().size()), start = uint64_t(vv.basis().part().start()), ncol = uint64_t(vv.local_set_size())] GPU_LAMBDA (uint64_t ist, uint64_t ip){
+						 uniform_distribution<typename work_set_type::element_type> dist;
+						 pcg32 rng(seed);
+						 rng.discard((ist + ncol*(ip + start))*dist.rngs_per_sample);
+						 v[ip][ist] = dist(rng);
+					 });
+
+	for(int istep = 0; istep < num_steps; istep++){
+
+		if(istep == 0){
+			auto nrm = operations::overlap_diagonal_multi(operations::overlap_pair(vv, vv));
+			gpu::run(nst, vv.spinor_matrix().size(),
+							 [v = begin(vv.spinor_matrix()), nr = begin(nrm)] GPU_LAMBDA (auto ist, auto ip){
+								 v[ip][ist] /= sqrt(real(nr[0][ist]));
+							 });
+		}
+
+		apply(vv, ff);
+
+		auto aa = operations::overlap_diagonal_multi(operations::overlap_pair(vv, ff));
+
+		gpu::run(nst, vv.spinor_matrix().size(),
+						 [f = begin(ff.spinor_matrix()), v = begin(vv.spinor_matrix()), vp = begin(vprev.spinor_matrix()), a = begin(aa), be = begin(beta), istep] GPU_LAMBDA (auto ist, auto ip){
+							 f[ip][ist] -= real(a[0][ist])*v[ip][ist];
+							 if(istep > 0) f[ip][ist] -= be[istep - 1][ist]*vp[ip][ist];
+						 });
+
+		auto bb = operations::overlap_diagonal_multi(operations::overlap_pair(ff, ff));
+
+		gpu::run(nst, [al = begin(alpha), be = begin(beta), a = begin(aa), b = begin(bb), istep] GPU_LAMBDA (auto ist){
+			al[istep][ist] = real(a[0][ist]);
+			be[istep][ist] = sqrt(real(b[0][ist]));
+		});
+
+		if(istep == num_steps - 1) break;
+
+		gpu::run(nst, vv.spinor_matrix().size(),
+						 [f = begin(ff.spinor_matrix()), v = begin(vv.spinor_matrix()), vp = begin(vprev.spinor_matrix()), be = begin(beta), istep] GPU_LAMBDA (auto ist, auto ip){
+							 vp[ip][ist] = v[ip][ist];
+							 if(be[istep][ist] > DBL_EPSILON) v[ip][ist] = f[ip][ist]/be[istep][ist];
+						 });
+	}
+
+	auto upper = -DBL_MAX;
+
+	// the tridiagonal matrices are tiny, we diagonalize them in the host
+	for(int ist = 0; ist < nst; ist++){
+		gpu::array<double, 2> tridiag({num_steps, num_steps}, 0.0);
+		for(int istep = 0; istep < num_steps; istep++){
+			tridiag[istep][istep] = alpha[istep][ist];
+			if(istep > 0) {
+				tridiag[istep][istep - 1] = beta[istep - 1][ist];
+				tridiag[istep - 1][istep] = beta[istep - 1][ist];
+			}
+		}
+		auto ritz = matrix::diagonalize_raw(tridiag);
+		upper = std::max(upper, ritz[num_steps - 1] + beta[num_steps - 1][ist]);
+	}
+
+	return upper;
+}
+
+// The eigenvalues are the ones of the last Rayleigh-Ritz step for
+// the orbitals in phi. The Lanczos vectors vv, vprev and ff are sets
+// of one orbital, the buffers have the size of phi.
+template <class apply_type, class field_set_type, class eigenvalues_type>
+void chebyshev_filter(apply_type const & apply, field_set_type & phi, eigenvalues_type const & eigenvalues, field_set_type & buffer1, field_set_type & buffer2,
+											field_set_type & vv, field_set_type & vprev, field_set_type & ff, int const degree = 8){
+
+	CALI_CXX_MARK_FUNCTION;
+
+	assert(degree >= 1);
+
+	auto lower = DBL_MAX;
+	auto cutoff = -DBL_MAX;
+	for(int ist = 0; ist < phi.local_spinor_set_size(); ist++){
+		lower = std::min(lower, eigenvalues[ist]);
+		cutoff = std::max(cutoff, eigenvalues[ist]);
+	}
+	
+	if(phi.set_comm().size() > 1){
+		lower  = phi.set_comm().all_reduce_value(lower, boost::mpi3::min<>{});
+		cutoff = phi.set_comm().all_reduce_value(cutoff, boost::mpi3::max<>{});
+	}
+	
+	auto upper = lanczos_upper_bound(apply, vv, vprev, ff);
+	
+	// nothing to filter if all the orbitals have the same eigenvalue
+	if(upper <= cutoff or cutoff <= lower) return;
+
+	auto ee = 0.5*(upper - cutoff);
+	auto cc = 0.5*(upper + cutoff);
+	auto sigma = ee/(lower - cc);
+	auto tau = 2.0/sigma;
+
+	// the three term recurrence rotates over phi and the buffers
+	auto xx = &phi;
+	auto yy = &buffer1;
+	auto ynew = &buffer2;
+
+	apply(*xx, *yy);
+
+	gpu::run(xx->matrix().num_elements(),
+					 [x = raw_pointer_cast(xx->matrix().data_elements()), y = raw_pointer_cast(yy->matrix().data_elements()), cc, fac = sigma/ee] GPU_LAMBDA (auto ii){
+						 y[ii] = fac*(y[ii] - cc*x[ii]);
+					 });
+
+	for(int ideg = 1; ideg < degree; ideg++){
+		auto sigma_new = 1.0/(tau - sigma);
+
+		apply(*yy, *ynew);
+
+		gpu::run(xx->matrix().num_elements(),
+						 [x = raw_pointer_cast(xx->matrix().data_elements()), y = raw_pointer_cast(yy->matrix().data_elements()), yn = raw_pointer_cast(ynew->matrix().data_elements()),
+							cc, fac1 = 2.0*sigma_new/ee, fac2 = sigma*sigma_new] GPU_LAMBDA (auto ii){
+							 yn[ii] = fac1*(yn[ii] - cc*y[ii]) - fac2*x[ii];
+						 });
+
+		sigma = sigma_new;
+
+		auto old_x = xx;
+		xx = yy;
+		yy = ynew;
+		ynew = old_x;
+	}
+
+	if(yy != &phi) phi.matrix() = yy->matrix();
+
+	operations::orthogonalize(phi);
+}
+
+template <class operator_type, class field_set_type, class eigenvalues_type>
+void chebyshev_filter(const operator_type & ham, field_set_type & phi, eigenvalues_type const & eigenvalues, int const degree = 8){
+	field_set_type buffer1(phi.skeleton());
+	field_set_type buffer2(phi.skeleton());
+	auto vectors = block_buffers(phi);
+	chebyshev_filter([&ham](auto const & in, auto & out){ out = ham(in); }, phi, eigenvalues, buffer1, buffer2,
+									 vectors("vv", 1), vectors("vprev", 1), vectors("ff", 1), degree);
+}
+
+// In this version the operator writes its result in the output argument, and all the temporaries are taken from the workspace
+template <class operator_type, class field_set_type, class eigenvalues_type>
+void chebyshev_filter(const operator_type & ham, field_set_type & phi, eigenvalues_type const & eigenvalues, utils::workspace & work, int const degree = 8){
+	auto & buffer1 = work.orbitals("chebyshev_filter::buffer1", phi);
+	auto & buffer2 = work.orbitals("chebyshev_filter::buffer2", phi);
+	auto vectors = block_buffers(phi, work);
+	chebyshev_filter([&ham, &work](auto const & in, auto & out){ ham(in, out, work); }, phi, eigenvalues, buffer1, buffer2,
+									 vectors("chebyshev_filter::vv", 1), vectors("chebyshev_filter::vprev", 1), vectors("chebyshev_filter::ff", 1), degree);
+}
+
+}
+}
+#endif
+
+#ifdef INQ_EIGENSOLVERS_CHEBYSHEV_FILTER_UNIT_TEST
+#undef INQ_EIGENSOLVERS_CHEBYSHEV_FILTER_UNIT_TEST
+
+#include <basis/trivial.hpp>
+#include <operations/matrix_operator.hpp>
+#include <operations/overlap.hpp>
+#include <operations/rotate.hpp>
+#include <operations/shift.hpp>
+
+#include <catch2/catch_all.hpp>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+
+	using namespace inq;
+	using namespace Catch::literals;
+	using Catch::Approx;
+
+  const int npoint = 100;
+  const int nvec = 12;
+
+  basis::trivial bas(npoint, parallel::communicator{boost::mpi3::environment::get_self_instance()});
+
+	gpu::array<complex, 2> diagonal_matrix({npoint, npoint});
+
+	for(int ip = 0; ip < npoint; ip++){
+		for(int jp = 0; jp < npoint; jp++){
+			diagonal_matrix[ip][jp] = 0.0;
+			if(ip == jp) diagonal_matrix[ip][jp] = ip + 1.0;
+		}
+	}
+
+	operations::matrix_operator<complex> diagonal_op(std::move(diagonal_matrix));
+
+	basis::field_set<basis::trivial, complex> phi(bas, nvec);
+
+	for(int ip = 0; ip < npoint; ip++){
+		for(int ivec = 0; ivec < nvec; ivec++){
+			phi.matrix()[ip][ivec] = exp(complex(0.0, (ip*ivec)*0.1));
+		}
+	}
+
+	operations::orthogonalize(phi);
+
+	SECTION("Upper bound"){
+		auto vv = eigensolvers::block_set(phi, 1);
+		auto vprev = eigensolvers::block_set(phi, 1);
+		auto ff = eigensolvers::block_set(phi, 1);
+
+		auto upper = eigensolvers::lanczos_upper_bound([&diagonal_op](auto const & in, auto & out){ out = diagonal_op(in); }, vv, vprev, ff);
+
+		CHECK(upper >= 100.0 - 1e-8);
+		CHECK(upper < 200.0);
+	}
+
+	SECTION("Diagonal matrix complex"){
+
+		auto hsub = operations::overlap(phi, diagonal_op(phi));
+		auto eigenvalues = matrix::diagonalize(hsub);
+		operations::rotate(hsub, phi);
+		
+		for(int iter = 0; iter < 30; iter++){
+			eigensolvers::chebyshev_filter(diagonal_op, phi, eigenvalues);
+
+			// Rayleigh-Ritz
+			hsub = operations::overlap(phi, diagonal_op(phi));
+			eigenvalues = matrix::diagonalize(hsub);
+			operations::rotate(hsub, phi);
+		}
+
+		auto residual = diagonal_op(phi);
+		auto eigenvalues = operations::overlap_diagonal(phi, residual);
+		operations::shift(-1.0, eigenvalues, phi, residual);
+		auto normres = operations::overlap_diagonal(residual);
+
+		for(int ivec = 0; ivec < 8; ivec++) {
+			CHECK(real(eigenvalues[ivec]) == Approx(ivec + 1.0).epsilon(1e-6));
+			CHECK(fabs(normres[ivec]) < 1e-6);
+		}
+	}
+
+}
+#endif
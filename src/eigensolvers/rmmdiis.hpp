@@ -0,0 +1,436 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef INQ__EIGENSOLVERS__RMMDIIS
+#define INQ__EIGENSOLVERS__RMMDIIS
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <math/complex.hpp>
+#include <gpu/array.hpp>
+#include <basis/field_set.hpp>
+#include <eigensolvers/block_set.hpp>
+#include <operations/overlap_diagonal.hpp>
+#include <states/orbital_set.hpp>
+#include <utils/workspace.hpp>
+
+#include <algorithm>
+#include <string>
+
+namespace inq {
+namespace eigensolvers {
+
+// The residual minimization method with direct inversion in the
+// iterative subspace (RMM-DIIS), as described by Kresse and
+// Furthmuller, Phys. Rev. B 54, 11169 (1996).
+//
+// Each orbital is updated independently, the only communication is
+// the reduction over the basis of the per-orbital scalar products, so
+// the orbitals are NOT orthogonal on return. The caller must
+// orthogonalize them (or do a subspace diagonalization) once all the
+// updates are done.
+//
+// The orbitals are processed in blocks of block_size, so the history
+// (the vectors, their H and their residuals for every step) only
+// needs memory for one block and not for all the orbitals.
+
+namespace rmmdiis_detail {
+
+constexpr int max_history = 8;
+constexpr int block_size = 8;
+
+// the coefficients that minimize the norm of the combined residual, with the constraint that they add to one
+template <typename OlapType, typename AlphaType>
+GPU_FUNCTION void diis_coefficients(int nhist, long ist, OlapType const & olap, AlphaType & alpha) {
+
+	double mm[max_history][max_history];
+	double xx[max_history];
+
+	double maxdiag = 0.0;
+	for(int ih = 0; ih < nhist; ih++){
+		for(int jh = 0; jh < nhist; jh++) mm[ih][jh] = (ih <= jh) ? olap[ih][jh][ist] : olap[jh][ih][ist];
+		xx[ih] = 1.0;
+		maxdiag = fmax(maxdiag, fabs(mm[ih][ih]));
+	}
+
+	auto singular = (maxdiag == 0.0);
+
+	// Gaussian elimination with partial pivoting
+	for(int ih = 0; ih < nhist and not singular; ih++){
+		auto piv = ih;
+		for(int jh = ih + 1; jh < nhist; jh++) if(fabs(mm[jh][ih]) > fabs(mm[piv][ih])) piv = jh;
+
+		if(fabs(mm[piv][ih]) < 1e-14*maxdiag) {
+			singular = true;
+			break;
+		}
+
+		for(int jh = 0; jh < nhist; jh++) {
+			auto tmp = mm[ih][jh];
+			mm[ih][jh] = mm[piv][jh];
+			mm[piv][jh] = tmp;
+		}
+		auto tmp = xx[ih];
+		xx[ih] = xx[piv];
+		xx[piv] = tmp;
+
+		for(int jh = ih + 1; jh < nhist; jh++){
+			auto fac = mm[jh][ih]/mm[ih][ih];
+			for(int kh = ih; kh < nhist; kh++) mm[jh][kh] -= fac*mm[ih][kh];
+			xx[jh] -= fac*xx[ih];
+		}
+	}
+
+	if(not singular){
+		double sum = 0.0;
+		for(int ih = nhist - 1; ih >= 0; ih--){
+			for(int jh = ih + 1; jh < nhist; jh++) xx[ih] -= mm[ih][jh]*xx[jh];
+			xx[ih] /= mm[ih][ih];
+			sum += xx[ih];
+		}
+		if(fabs(sum) < 1e-14) singular = true;
+		for(int ih = 0; ih < nhist; ih++) alpha[ih][ist] = xx[ih]/sum;
+	}
+
+	// if the system cannot be solved we just keep the last vector
+	if(singular){
+		for(int ih = 0; ih < nhist; ih++) alpha[ih][ist] = 0.0;
+		alpha[nhist - 1][ist] = 1.0;
+	}
+}
+
+// normalizes phi (and hphi with the same factor) and calculates the Rayleigh quotient and the residual
+template <class field_set_type>
+void normalize_and_residual(field_set_type & phi, field_set_type & hphi, field_set_type & res, gpu::array<double, 2> & eigenvalues, int ihist) {
+
+	auto en = operations::overlap_diagonal_multi(operations::overlap_pair(hphi, phi), operations::overlap_pair(phi, phi));
+
+	gpu::run(phi.local_spinor_set_size(), [ev = begin(eigenvalues), en = begin(en), ihist] GPU_LAMBDA (auto ist){
+		ev[ihist][ist] = real(en[0][ist])/real(en[1][ist]);
+	});
+
+	gpu::run(phi.local_spinor_set_size(), phi.spinor_matrix().size(),
+					 [ph = begin(phi.spinor_matrix()), hph = begin(hphi.spinor_matrix()), re = begin(res.spinor_matrix()), ev = begin(eigenvalues), en = begin(en), ihist] GPU_LAMBDA (auto ist, auto ip){
+						 auto scal = 1.0/sqrt(real(en[1][ist]));
+						 ph[ip][ist] *= scal;
+						 hph[ip][ist] *= scal;
+						 re[ip][ist] = hph[ip][ist] - ev[ihist][ist]*ph[ip][ist];
+					 });
+}
+
+}
+
+// Updates the orbitals ist0 to ist0 + nblock - 1 of phi. The buffers returned by 'buffer' have nblock orbitals.
+template <class apply_type, class preconditioner_type, class field_set_type, class buffer_type>
+void rmmdiis_block(apply_type const & apply, const preconditioner_type & prec, field_set_type & phi, int const ist0, int const nblock, buffer_type const & buffer, int const num_steps){
+
+	CALI_CXX_MARK_FUNCTION;
+
+	using rmmdiis_detail::max_history;
+
+	auto nst = nblock;
+
+	gpu::array<double, 3> res_olap({max_history, max_history, nst});
+	gpu::array<double, 2> alpha({max_history, nst});
+	gpu::array<double, 2> eigenvalues({max_history, nst});
+	gpu::array<double, 1> lambda(nst);
+
+	auto phi_hist  = [&buffer](int ih) -> field_set_type & { return buffer("rmmdiis::phi" + std::to_string(ih)); };
+	auto hphi_hist = [&buffer](int ih) -> field_set_type & { return buffer("rmmdiis::hphi" + std::to_string(ih)); };
+	auto res_hist  = [&buffer](int ih) -> field_set_type & { return buffer("rmmdiis::res" + std::to_string(ih)); };
+
+	// the overlaps of the last residual with the previous ones, as the DIIS matrix is symmetric we only store the upper part
+	auto add_overlaps = [&](int ihist){
+		for(int ih = 0; ih <= ihist; ih++){
+			auto olap = operations::overlap_diagonal_multi(operations::overlap_pair(res_hist(ih), res_hist(ihist)));
+			gpu::run(nst, [ro = begin(res_olap), ol = begin(olap), ih, ihist] GPU_LAMBDA (auto ist){
+				ro[ih][ihist][ist] = real(ol[0][ist]);
+			});
+		}
+	};
+
+	gpu::run(nblock, phi.spinor_matrix().size(),
+					 [bl = begin(phi_hist(0).spinor_matrix()), ph = begin(phi.spinor_matrix()), ist0] GPU_LAMBDA (auto ist, auto ip){
+						 bl[ip][ist] = ph[ip][ist0 + ist];
+					 });
+	
+	apply(phi_hist(0), hphi_hist(0));
+	rmmdiis_detail::normalize_and_residual(phi_hist(0), hphi_hist(0), res_hist(0), eigenvalues, 0);
+	add_overlaps(0);
+
+	auto & dir = buffer("rmmdiis::dir");
+	auto & hdir = buffer("rmmdiis::hdir");
+
+	for(int istep = 0; istep < num_steps; istep++){
+
+		auto & next_phi = phi_hist(istep + 1);
+		auto & next_hphi = hphi_hist(istep + 1);
+
+		// the DIIS combination of the previous vectors, in the first step this is just the initial vector
+		if(istep == 0) {
+			next_phi.matrix() = phi_hist(0).matrix();
+			next_hphi.matrix() = hphi_hist(0).matrix();
+			dir.matrix() = res_hist(0).matrix();
+		} else {
+			gpu::run(nst, [ro = begin(res_olap), al = begin(alpha), nhist = istep + 1] GPU_LAMBDA (auto ist){
+				rmmdiis_detail::diis_coefficients(nhist, ist, ro, al);
+			});
+
+			for(int ih = 0; ih <= istep; ih++){
+				gpu::run(nst, phi.spinor_matrix().size(),
+								 [nph = begin(next_phi.spinor_matrix()), nhph = begin(next_hphi.spinor_matrix()), di = begin(dir.spinor_matrix()),
+									ph = begin(phi_hist(ih).spinor_matrix()), hph = begin(hphi_hist(ih).spinor_matrix()), re = begin(res_hist(ih).spinor_matrix()), al = begin(alpha), ih]
+								 GPU_LAMBDA (auto ist, auto ip){
+									 auto aa = al[ih][ist];
+									 if(ih == 0){
+										 nph[ip][ist] = aa*ph[ip][ist];
+										 nhph[ip][ist] = aa*hph[ip][ist];
+										 di[ip][ist] = aa*re[ip][ist];
+									 } else {
+										 nph[ip][ist] += aa*ph[ip][ist];
+										 nhph[ip][ist] += aa*hph[ip][ist];
+										 di[ip][ist] += aa*re[ip][ist];
+									 }
+								 });
+			}
+		}
+
+		prec(dir);
+		apply(dir, hdir);
+
+		// the step size is obtained by minimizing the Rayleigh quotient along the first direction, then it is kept fixed
+		if(istep == 0) {
+			auto mm = operations::overlap_diagonal_multi(operations::overlap_pair(dir, dir), operations::overlap_pair(next_phi, dir),
+																									 operations::overlap_pair(dir, hdir), operations::overlap_pair(next_phi, hdir));
+
+			gpu::run(nst, [m = begin(mm), ev = begin(eigenvalues), lam = begin(lambda)] GPU_LAMBDA (auto ist){
+				auto ca = real(m[0][ist]*m[3][ist] - m[2][ist]*m[1][ist]);
+				auto cb = real(m[2][ist]) - ev[0][ist]*real(m[0][ist]);
+				auto cc = ev[0][ist]*real(m[1][ist]) - real(m[3][ist]);
+				auto den = cb + sqrt(fabs(cb*cb - 4.0*ca*cc));
+
+				if(fabs(den) < 1e-15) { //this happens if we are perfectly converged
+					lam[ist] = 0.0;
+				} else {
+					lam[ist] = 2.0*cc/den;
+				}
+			});
+		}
+
+		gpu::run(nst, phi.spinor_matrix().size(),
+						 [nph = begin(next_phi.spinor_matrix()), nhph = begin(next_hphi.spinor_matrix()), di = begin(dir.spinor_matrix()), hdi = begin(hdir.spinor_matrix()), lam = begin(lambda)]
+						 GPU_LAMBDA (auto ist, auto ip){
+							 nph[ip][ist] += lam[ist]*di[ip][ist];
+							 nhph[ip][ist] += lam[ist]*hdi[ip][ist];
+						 });
+
+		rmmdiis_detail::normalize_and_residual(next_phi, next_hphi, res_hist(istep + 1), eigenvalues, istep + 1);
+		if(istep < num_steps - 1) add_overlaps(istep + 1);
+	}
+
+	gpu::run(nblock, phi.spinor_matrix().size(),
+					 [bl = begin(phi_hist(num_steps).spinor_matrix()), ph = begin(phi.spinor_matrix()), ist0] GPU_LAMBDA (auto ist, auto ip){
+						 ph[ip][ist0 + ist] = bl[ip][ist];
+					 });
+}
+
+// The buffers are obtained from buffer(name, nblock), that returns a set with nblock orbitals
+template <class apply_type, class preconditioner_type, class field_set_type, class buffer_type>
+void rmmdiis(apply_type const & apply, const preconditioner_type & prec, field_set_type & phi, buffer_type const & buffer, int const num_steps = 3){
+
+	CALI_CXX_MARK_FUNCTION;
+
+	assert(num_steps >= 1 and num_steps < rmmdiis_detail::max_history);
+
+	auto nst = phi.local_spinor_set_size();
+
+	for(int ist0 = 0; ist0 < nst; ist0 += rmmdiis_detail::block_size){
+		auto nblock = std::min(rmmdiis_detail::block_size, nst - ist0);
+		rmmdiis_block(apply, prec, phi, ist0, nblock, [&buffer, nblock](std::string const & name) -> field_set_type & { return buffer(name, nblock); }, num_steps);
+	}
+}
+
+template <class operator_type, class preconditioner_type, class field_set_type>
+void rmmdiis(const operator_type & ham, const preconditioner_type & prec, field_set_type & phi, int const num_steps = 3){
+	rmmdiis([&ham](auto const & in, auto & out){ out = ham(in); }, prec, phi, block_buffers(phi), num_steps);
+}
+
+// In this version the operator writes its result in the output argument, and all the temporaries are taken from the workspace
+template <class operator_type, class preconditioner_type, class field_set_type>
+void rmmdiis(const operator_type & ham, const preconditioner_type & prec, field_set_type & phi, utils::workspace & work, int const num_steps = 3){
+	rmmdiis([&ham, &work](auto const & in, auto & out){ ham(in, out, work); }, prec, phi, block_buffers(phi, work), num_steps);
+}
+
+}
+}
+#endif
+
+#ifdef INQ_EIGENSOLVERS_RMMDIIS_UNIT_TEST
+#undef INQ_EIGENSOLVERS_RMMDIIS_UNIT_TEST
+
+#include <basis/trivial.hpp>
+#include <operations/matrix_operator.hpp>
+#include <operations/orthogonalize.hpp>
+#include <operations/overlap.hpp>
+#include <operations/preconditioner.hpp>
+#include <operations/rotate.hpp>
+#include <operations/shift.hpp>
+
+#include <catch2/catch_all.hpp>
+
+#include <map>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+
+	using namespace inq;
+	using namespace Catch::literals;
+	using Catch::Approx;
+
+  const int npoint = 100;
+  const int nvec = 12;
+
+  basis::trivial bas(npoint, parallel::communicator{boost::mpi3::environment::get_self_instance()});
+
+	SECTION("DIIS coefficients"){
+		gpu::array<double, 3> olap({2, 2, 1});
+		gpu::array<double, 2> alpha({2, 1});
+
+		olap[0][0][0] = 4.0;
+		olap[0][1][0] = 1.0;
+		olap[1][1][0] = 2.0;
+
+		eigensolvers::rmmdiis_detail::diis_coefficients(2, 0, olap, alpha);
+
+		// minimizes 4a^2 + 2ab + 2b^2 with a + b = 1
+		CHECK(alpha[0][0] == 0.25_a);
+		CHECK(alpha[1][0] == 0.75_a);
+
+		olap[0][0][0] = 0.0;
+		olap[0][1][0] = 0.0;
+		olap[1][1][0] = 0.0;
+
+		eigensolvers::rmmdiis_detail::diis_coefficients(2, 0, olap, alpha);
+		CHECK(alpha[0][0] == 0.0_a);
+		CHECK(alpha[1][0] == 1.0_a);
+	}
+
+	SECTION("Diagonal matrix complex"){
+
+		gpu::array<complex, 2> diagonal_matrix({npoint, npoint});
+
+		for(int ip = 0; ip < npoint; ip++){
+			for(int jp = 0; jp < npoint; jp++){
+				diagonal_matrix[ip][jp] = 0.0;
+				if(ip == jp) diagonal_matrix[ip][jp] = ip + 1.0;
+			}
+		}
+
+		operations::matrix_operator<complex> diagonal_op(std::move(diagonal_matrix));
+
+		basis::field_set<basis::trivial, complex> phi(bas, nvec);
+
+		for(int ip = 0; ip < npoint; ip++){
+			for(int ivec = 0; ivec < nvec; ivec++){
+				phi.matrix()[ip][ivec] = exp(complex(0.0, (ip*ivec)*0.1));
+			}
+		}
+
+		operations::orthogonalize(phi);
+
+		for(int iter = 0; iter < 100; iter++){
+			eigensolvers::rmmdiis(diagonal_op, operations::no_preconditioner{}, phi);
+
+			// the orthogonalization and the subspace rotation are done once per iteration by the caller
+			operations::orthogonalize(phi);
+			auto hsub = operations::overlap(phi, diagonal_op(phi));
+			matrix::diagonalize(hsub);
+			operations::rotate(hsub, phi);
+		}
+
+		auto residual = diagonal_op(phi);
+		auto eigenvalues = operations::overlap_diagonal(phi, residual);
+		operations::shift(-1.0, eigenvalues, phi, residual);
+		auto normres = operations::overlap_diagonal(residual);
+
+		for(int ivec = 0; ivec < 6; ivec++) {
+			CHECK(real(eigenvalues[ivec]) == Approx(ivec + 1.0).epsilon(1e-6));
+			CHECK(fabs(normres[ivec]) < 1e-6);
+		}
+	}
+
+	SECTION("Dense hermitian matrix"){
+
+		// H = U D U^+ with D = diag(1, ..., npoint) and U = 1 - 2 v v^+/|v|^2 a Householder reflection, so H is dense but the spectrum is known
+		gpu::array<complex, 1> vv(npoint);
+		double vnorm = 0.0;
+		for(int ip = 0; ip < npoint; ip++){
+			vv[ip] = complex(cos(0.3*ip), sin(0.7*ip));
+			vnorm += norm(vv[ip]);
+		}
+
+		gpu::array<complex, 2> dense_matrix({npoint, npoint});
+
+		for(int ip = 0; ip < npoint; ip++){
+			for(int jp = 0; jp < npoint; jp++){
+				complex hh = 0.0;
+				for(int kp = 0; kp < npoint; kp++){
+					auto uik = ((ip == kp) ? 1.0 : 0.0) - 2.0*vv[ip]*conj(vv[kp])/vnorm;
+					auto ujk = ((jp == kp) ? 1.0 : 0.0) - 2.0*vv[jp]*conj(vv[kp])/vnorm;
+					hh += uik*(kp + 1.0)*conj(ujk);
+				}
+				dense_matrix[ip][jp] = hh;
+			}
+		}
+
+		operations::matrix_operator<complex> dense_op(std::move(dense_matrix));
+
+		basis::field_set<basis::trivial, complex> phi(bas, nvec);
+
+		for(int ip = 0; ip < npoint; ip++){
+			for(int ivec = 0; ivec < nvec; ivec++){
+				phi.matrix()[ip][ivec] = exp(complex(0.0, (ip*ivec)*0.1)) + 1.0/(ip + ivec + 1.0);
+			}
+		}
+
+		operations::orthogonalize(phi);
+
+		// the buffers only contain one block of orbitals
+		std::map<std::string, basis::field_set<basis::trivial, complex>> sets;
+		int max_block = 0;
+		auto buffer = [&sets, &bas, &max_block](std::string const & name, int const nblock) -> basis::field_set<basis::trivial, complex> & {
+			max_block = std::max(max_block, nblock);
+			auto key = name + ":" + std::to_string(nblock);
+			auto it = sets.find(key);
+			if(it == sets.end()) it = sets.emplace(key, basis::field_set<basis::trivial, complex>(bas, nblock)).first;
+			return it->second;
+		};
+
+		for(int iter = 0; iter < 100; iter++){
+			eigensolvers::rmmdiis([&dense_op](auto const & in, auto & out){ out = dense_op(in); }, operations::no_preconditioner{}, phi, buffer);
+
+			// as in the calculator, the orbitals are orthogonalized after the update
+			operations::orthogonalize(phi);
+			auto hsub = operations::overlap(phi, dense_op(phi));
+			matrix::diagonalize(hsub);
+			operations::rotate(hsub, phi);
+		}
+
+		CHECK(max_block == eigensolvers::rmmdiis_detail::block_size);
+		CHECK(sets.size() == 2*(3*4 + 2));
+
+		auto residual = dense_op(phi);
+		auto eigenvalues = operations::overlap_diagonal(phi, residual);
+		operations::shift(-1.0, eigenvalues, phi, residual);
+		auto normres = operations::overlap_diagonal(residual);
+
+		for(int ivec = 0; ivec < 6; ivec++) {
+			CHECK(real(eigenvalues[ivec]) == Approx(ivec + 1.0).epsilon(1e-6));
+			CHECK(fabs(normres[ivec]) < 1e-6);
+		}
+	}
+
+}
+#endif
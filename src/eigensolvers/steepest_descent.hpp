@@ -16,54 +16,71 @@
 #include <operations/shift.hpp>
 #include <operations/orthogonalize.hpp>
 #include <operations/overlap_diagonal.hpp>
+#include <utils/workspace.hpp>
 
 namespace inq {
 namespace eigensolvers {
 
-template <class operator_type, class preconditioner_type, class field_set_type>
-void steepest_descent(const operator_type & ham, const preconditioner_type & prec, field_set_type & phi){
+// If locking_tolerance is positive, the bands with a residual norm
+// below it are locked: they are not updated and, once all of them are
+// locked, the iterations stop without more applications of the
+// operator.
+template <class apply_type, class preconditioner_type, class field_set_type, class work_set_type>
+void steepest_descent(apply_type const & apply, const preconditioner_type & prec, field_set_type & phi, work_set_type & hphi, work_set_type & residual, work_set_type & hresidual,
+											int const num_steps = 5, double const locking_tolerance = 0.0){
 
 	CALI_CXX_MARK_FUNCTION;
 	
-	const int num_steps = 5;
-
-	auto hphi = ham(phi);
+	apply(phi, hphi);
 	
 	for(int istep = 0; istep < num_steps; istep++){
 
-		auto residual = hphi;
-		auto eigenvalues = operations::overlap_diagonal(residual, phi);
-		auto norm =	operations::overlap_diagonal(phi);
-			
-		auto evnorm = eigenvalues;
+		residual.matrix() = hphi.matrix();
+		auto evnm = operations::overlap_diagonal_multi(operations::overlap_pair(residual, phi), operations::overlap_pair(phi, phi));
 		
-		gpu::run(eigenvalues.size(),
-						 [evn = begin(evnorm), nor = begin(norm)] GPU_LAMBDA (auto ist){
-							 evn[ist] /= real(nor[ist]);
+		auto evnorm = gpu::array<typename field_set_type::element_type, 1>(evnm[0]);
+		
+		gpu::run(evnorm.size(),
+						 [evn = begin(evnorm), en = begin(evnm)] GPU_LAMBDA (auto ist){
+							 evn[ist] /= real(en[1][ist]);
 						 });
 		
 		operations::shift(-1.0, evnorm, phi, residual);
 
-		prec(residual);
+		auto locked = gpu::array<bool, 1>(phi.local_spinor_set_size(), false);
+		
+		if(locking_tolerance > 0.0) {
+			auto rr = operations::overlap_diagonal_multi(operations::overlap_pair(residual, residual));
+
+			int num_active = 0;
+			for(int ist = 0; ist < phi.local_spinor_set_size(); ist++){
+				locked[ist] = real(rr[0][ist]) < locking_tolerance*locking_tolerance;
+				if(not locked[ist]) num_active++;
+			}
 
-		auto mm = gpu::array<typename field_set_type::element_type, 2>({6, eigenvalues.size()});
+			if(phi.full_comm().size() > 1) num_active = phi.full_comm().all_reduce_value(num_active);
+			if(num_active == 0) break;
+		}
+		
+		prec(residual);
 
-		auto hresidual = ham(residual);
-		mm[0] = operations::overlap_diagonal(residual, residual);
-		mm[1] = operations::overlap_diagonal(phi, residual);
-		mm[2] = operations::overlap_diagonal(residual, hresidual);
-		mm[3] = operations::overlap_diagonal(phi, hresidual);
-		mm[4] = eigenvalues;
-		mm[5] = norm;
+		apply(residual, hresidual);
+		auto mm = operations::overlap_diagonal_multi(operations::overlap_pair(residual, residual), operations::overlap_pair(phi, residual),
+																								 operations::overlap_pair(residual, hresidual), operations::overlap_pair(phi, hresidual));
 
-		auto lambda = gpu::array<double, 1>(eigenvalues.size());
+		auto lambda = gpu::array<double, 1>(evnorm.size());
 		
 		gpu::run(phi.local_spinor_set_size(),
-						 [m = begin(mm), lam = begin(lambda)]
+						 [m = begin(mm), en = begin(evnm), lam = begin(lambda), lck = begin(locked)]
 						 GPU_LAMBDA (auto ist){
+							 if(lck[ist]) {
+								 lam[ist] = 0.0;
+								 return;
+							 }
+							 
 							 auto ca = real(m[0][ist]*m[3][ist] - m[2][ist]*m[1][ist]);
-							 auto cb = real(m[5][ist]*m[2][ist] - m[4][ist]*m[0][ist]);
-							 auto cc = real(m[4][ist]*m[1][ist] - m[3][ist]*m[5][ist]);
+							 auto cb = real(en[1][ist]*m[2][ist] - en[0][ist]*m[0][ist]);
+							 auto cc = real(en[0][ist]*m[1][ist] - m[3][ist]*en[1][ist]);
 							 auto den = cb + sqrt(cb*cb - 4.0*ca*cc);
 
 							 if(fabs(den) < 1e-15) { //this happens if we are perfectly converged
@@ -85,6 +102,23 @@ void steepest_descent(const operator_type & ham, const preconditioner_type & pre
 		
 }
 
+template <class operator_type, class preconditioner_type, class field_set_type>
+void steepest_descent(const operator_type & ham, const preconditioner_type & prec, field_set_type & phi, int const num_steps = 5, double const locking_tolerance = 0.0){
+	field_set_type hphi(phi.skeleton());
+	field_set_type residual(phi.skeleton());
+	field_set_type hresidual(phi.skeleton());
+	steepest_descent([&ham](auto const & in, auto & out){ out = ham(in); }, prec, phi, hphi, residual, hresidual, num_steps, locking_tolerance);
+}
+
+// In this version the operator writes its result in the output argument, and all the temporaries are taken from the workspace
+template <class operator_type, class preconditioner_type, class field_set_type>
+void steepest_descent(const operator_type & ham, const preconditioner_type & prec, field_set_type & phi, utils::workspace & work, int const num_steps = 5, double const locking_tolerance = 0.0){
+	auto & hphi = work.orbitals("steepest_descent::hphi", phi);
+	auto & residual = work.orbitals("steepest_descent::residual", phi);
+	auto & hresidual = work.orbitals("steepest_descent::hresidual", phi);
+	steepest_descent([&ham, &work](auto const & in, auto & out){ ham(in, out, work); }, prec, phi, hphi, residual, hresidual, num_steps, locking_tolerance);
+}
+
 }
 }
 #endif
@@ -181,6 +215,56 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
  	
  }
 
+	SECTION("Locking"){
+
+		gpu::array<complex, 2> diagonal_matrix({npoint, npoint});
+    
+		for(int ip = 0; ip < npoint; ip++){
+			for(int jp = 0; jp < npoint; jp++){
+				diagonal_matrix[ip][jp] = 0.0;
+				if(ip == jp) diagonal_matrix[ip][jp] = ip + 1.0;
+			}
+		}
+    
+		operations::matrix_operator<complex> diagonal_op(std::move(diagonal_matrix));
+
+		// the exact eigenvectors, except for band 3
+		basis::field_set<basis::trivial, complex> phi(bas, nvec);
+
+		for(int ip = 0; ip < npoint; ip++){
+			for(int ivec = 0; ivec < nvec; ivec++){
+				phi.matrix()[ip][ivec] = (ip == ivec) ? 1.0 : 0.0;
+			}
+		}
+
+		basis::field_set<basis::trivial, complex> hphi(phi.skeleton());
+		basis::field_set<basis::trivial, complex> residual(phi.skeleton());
+		basis::field_set<basis::trivial, complex> hresidual(phi.skeleton());
+
+		int num_apply = 0;
+		auto apply = [&diagonal_op, &num_apply](auto const & in, auto & out){
+			out = diagonal_op(in);
+			num_apply++;
+		};
+
+		eigensolvers::steepest_descent(apply, identity, phi, hphi, residual, hresidual, 5, 1e-8);
+		CHECK(num_apply == 1);
+		CHECK(real(phi.matrix()[3][3]) == 1.0_a);
+
+		phi.matrix()[20][3] = 0.1;
+		operations::orthogonalize(phi);
+
+		num_apply = 0;
+		eigensolvers::steepest_descent(apply, identity, phi, hphi, residual, hresidual, 5, 1e-8);
+		// the search space of band 3 only contains two eigenvectors, so it converges in one step and the iterations stop
+		CHECK(num_apply < 6);
+		
+		CHECK(real(phi.matrix()[0][0]) == 1.0_a);
+		CHECK(fabs(phi.matrix()[20][0]) < 1e-14);
+		CHECK(fabs(phi.matrix()[20][3]) < 1e-6);
+		
+	}
+
 #if 0
 	SECTION("Periodic Laplacian matrix complex"){
 		
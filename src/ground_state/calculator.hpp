@@ -29,6 +29,10 @@
 #include <parallel/gather.hpp>
 #include <mixers/linear.hpp>
 #include <mixers/broyden.hpp>
+#include <mixers/kerker.hpp>
+#include <mixers/pulay.hpp>
+#include <eigensolvers/chebyshev_filter.hpp>
+#include <eigensolvers/rmmdiis.hpp>
 #include <eigensolvers/steepest_descent.hpp>
 #include <math/complex.hpp>
 #include <observables/dipole.hpp>
@@ -37,6 +41,7 @@
 #include <systems/electrons.hpp>
 #include <ground_state/eigenvalue_output.hpp>
 #include <ground_state/results.hpp>
+#include <ground_state/lcao.hpp>
 #include <ground_state/subspace_diagonalization.hpp>
 
 #include<tinyformat/tinyformat.h>
@@ -45,8 +50,10 @@
 #include<spdlog/sinks/stdout_color_sinks.h>
 
 #include<memory>
+#include <algorithm>
 
 #include <utils/profiling.hpp>
+#include <utils/workspace.hpp>
 
 namespace inq {
 namespace ground_state {
@@ -62,6 +69,8 @@ private:
 	options::ground_state solver_;
 	hamiltonian::self_consistency<> sc_;
 	hamiltonian::ks_hamiltonian<double> ham_;
+	utils::workspace workspace_;
+	bool lcao_done_ = false;
 
 #ifdef ENABLE_CUDA
 public:
@@ -96,14 +105,90 @@ public:
 		return state_conv;
 	}
 
+	template <typename SetType, typename PreconditionerType, typename EigenvaluesType>
+	void eigensolver_step(SetType & phi, PreconditionerType const & prec, EigenvaluesType && eigenvalues, double const locking_tolerance, int const num_steps) {
+
+		switch(solver_.eigensolver()){
+			
+		case options::ground_state::scf_eigensolver::STEEPEST_DESCENT:
+			eigensolvers::steepest_descent(ham_, prec, phi, workspace_, num_steps, locking_tolerance);
+			break;
+
+		case options::ground_state::scf_eigensolver::CHEBYSHEV_FILTER:
+			eigensolvers::chebyshev_filter(ham_, phi, eigenvalues, workspace_);
+			eigenvalues = subspace_diagonalization(ham_, phi, workspace_);
+			break;
+
+		case options::ground_state::scf_eigensolver::RMM_DIIS:
+			eigensolvers::rmmdiis(ham_, prec, phi, workspace_);
+			// the bands are updated independently, this is the only orthogonalization of the iteration
+			operations::orthogonalize(phi);
+			break;
+			
+		default:
+			assert(false);
+		}
+	}
+	
+	template <typename SetType, typename NormResType>
+	static bool all_converged(SetType const & phi, NormResType const & normres, double const tolerance) {
+		int num_active = 0;
+		for(int ist = 0; ist < phi.local_spinor_set_size(); ist++){
+			if(real(normres[ist]) >= tolerance*tolerance) num_active++;
+		}
+		if(phi.full_comm().size() > 1) num_active = phi.full_comm().all_reduce_value(num_active);
+		return num_active == 0;
+	}
+	
+	// The electrons with the real orbitals that replace their complex ones during the SCF, for
+	// the routines that take the orbitals from the electrons (the density and the energy)
+	struct real_orbitals_electrons {
+		systems::electrons & el;
+		std::vector<states::orbital_set<basis::real_space, double>> & orbitals;
+
+		auto & kpin() { return orbitals; }
+		auto & kpin() const { return orbitals; }
+		decltype(auto) eigenvalues() { return el.eigenvalues(); }
+		decltype(auto) occupations() const { return el.occupations(); }
+		decltype(auto) kpin_states_comm() const { return el.kpin_states_comm(); }
+		decltype(auto) density_basis() const { return el.density_basis(); }
+		decltype(auto) states() const { return el.states(); }
+		decltype(auto) brillouin_zone() const { return el.brillouin_zone(); }
+		auto max_local_spinor_set_size() const { return el.max_local_spinor_set_size(); }
+	};
+	
+	void check_real_orbitals(systems::electrons const & electrons) const {
+		if(electrons.brillouin_zone().size() != 1 or electrons.states_basis().cell().metric().norm(electrons.brillouin_zone().kpoint(0)) != 0.0) {
+			throw std::runtime_error("INQ error: Real orbitals can only be used when the only k-point is Gamma.");
+		}
+		if(electrons.states().spinor_dim() != 1) throw std::runtime_error("INQ error: Real orbitals cannot be used with spinors.");
+		if(ham_.exchange().enabled()) throw std::runtime_error("INQ error: Real orbitals cannot be used with exact exchange.");
+		if(electrons.atomic_pot().fourier_pseudo()) throw std::runtime_error("INQ error: Real orbitals cannot be used with the pseudopotentials in Fourier space.");
+	}
+
 public:
 
+	// the inner iterations of steepest descent reduce the residual roughly by half each, so we do the ones needed to bring the
+	// largest residual of the set down to the tolerance, with at most max_steps (a zero tolerance means we don't know it yet)
+	template <typename SetType, typename NormResType>
+	static int num_inner_steps(SetType const & phi, NormResType const & normres, double const tolerance, int const max_steps = 5) {
+		if(tolerance <= 0.0) return max_steps;
+		
+		auto maxres = 0.0;
+		for(int ist = 0; ist < phi.local_spinor_set_size(); ist++) maxres = std::max(maxres, real(normres[ist]));
+		if(phi.full_comm().size() > 1) maxres = phi.full_comm().all_reduce_value(maxres, boost::mpi3::max<>{});
+
+		// normres has the square of the residual norm
+		if(maxres <= tolerance*tolerance) return 1;
+		return std::clamp(int(ceil(0.5*log2(maxres/(tolerance*tolerance)))), 1, max_steps);
+	}
+
 	calculator(systems::ions const & ions, systems::electrons const & electrons, const options::theory & inter = {}, options::ground_state const & solver = {})
 		:ions_(ions),
 		 inter_(inter),
 		 solver_(solver),
 		 sc_(inter, electrons.states_basis(), electrons.density_basis(), electrons.states().num_density_components()),
-		 ham_(electrons.states_basis(), electrons.brillouin_zone(), electrons.states(), electrons.atomic_pot(), ions_, sc_.exx_coefficient(), /* use_ace = */ true)
+		 ham_(electrons.states_basis(), electrons.brillouin_zone(), electrons.states(), electrons.atomic_pot(), ions_, sc_.exx_coefficient(), /* use_ace = */ true, sc_.isolated_poisson_solver())
 	{
 	}
 
@@ -117,6 +202,12 @@ public:
 		if(solver_.verbose_output() and console) console->trace("ground-state calculation started");
 		
 		if(electrons.full_comm().root()) ham_.info(std::cout);
+
+		if(solver_.use_real_orbitals()) check_real_orbitals(electrons);
+
+		if(electrons.brillouin_zone().symmetries().size() > 1 and ham_.exchange().enabled()) {
+			throw std::runtime_error("INQ error: Exact exchange requires the full Brillouin zone, the k-point grid cannot be reduced with symmetries.");
+		}
 		
 		results res;
 		operations::preconditioner prec;
@@ -124,9 +215,21 @@ public:
 		using mix_arr_type = std::remove_reference_t<decltype(electrons.spin_density().matrix().flatted())>;
 		
 		auto mixer = [&]()->std::unique_ptr<mixers::base<mix_arr_type>>{
+			auto dim = electrons.spin_density().matrix().flatted().size();
+			
+			if(solver_.kerker_screening() > 0.0) {
+				auto kerker = mixers::kerker(electrons.density_basis(), electrons.spin_density().set_size(), solver_.kerker_screening());
+				switch(solver_.mixing_algorithm()){
+				case options::ground_state::mixing_algo::LINEAR : return std::make_unique<mixers::linear <mix_arr_type, mixers::kerker>>(solver_.mixing(), kerker);
+				case options::ground_state::mixing_algo::BROYDEN: return std::make_unique<mixers::broyden<mix_arr_type, mixers::kerker>>(4, solver_.mixing(), dim, electrons.density_basis().comm(), kerker);
+				case options::ground_state::mixing_algo::PULAY  : return std::make_unique<mixers::pulay  <mix_arr_type, mixers::kerker>>(4, solver_.mixing(), dim, electrons.density_basis().comm(), kerker);
+				} __builtin_unreachable();
+			}
+			
 			switch(solver_.mixing_algorithm()){
 			case options::ground_state::mixing_algo::LINEAR : return std::make_unique<mixers::linear <mix_arr_type>>(solver_.mixing());
-			case options::ground_state::mixing_algo::BROYDEN: return std::make_unique<mixers::broyden<mix_arr_type>>(4, solver_.mixing(), electrons.spin_density().matrix().flatted().size(), electrons.density_basis().comm());
+			case options::ground_state::mixing_algo::BROYDEN: return std::make_unique<mixers::broyden<mix_arr_type>>(4, solver_.mixing(), dim, electrons.density_basis().comm());
+			case options::ground_state::mixing_algo::PULAY  : return std::make_unique<mixers::pulay  <mix_arr_type>>(4, solver_.mixing(), dim, electrons.density_basis().comm());
 			} __builtin_unreachable();
 		}();
 		
@@ -134,6 +237,13 @@ public:
 		
 		sc_.update_ionic_fields(electrons.states_comm(), ions_, electrons.atomic_pot());
 		sc_.update_hamiltonian(ham_, res.energy, electrons.spin_density());
+
+		// only the first calculation starts from the atomic orbitals, the next ones (molecular dynamics or
+		// geometry steps) start from the orbitals they are given
+		if(solver_.use_lcao_initial_guess() and not lcao_done_) {
+			lcao_guess(ham_, ions_, electrons);
+			lcao_done_ = true;
+		}
 		
 		res.energy.ion(ionic::interaction_energy(ions_.cell(), ions_, electrons.atomic_pot()));
 		
@@ -141,21 +251,39 @@ public:
 		double exe_diff = fabs(old_exe);
 		auto update_hf = false;
 		
+		// at Gamma the orbitals can be chosen real, they are converted once and the memory of the complex ones is released until the end of the SCF
+		std::vector<states::orbital_set<basis::real_space, double>> real_kpin;
+		if(solver_.use_real_orbitals()) {
+			for(auto & phi : electrons.kpin()) {
+				real_kpin.emplace_back(states::real_field(phi));
+				operations::orthogonalize(real_kpin.back());
+				phi.matrix().reextent({0, 0});
+			}
+		}
+		auto real_electrons = real_orbitals_electrons{electrons, real_kpin};
+		
 		electrons.full_comm().barrier();
 		auto iter_start_time = std::chrono::high_resolution_clock::now();
 
 		auto converged = false;
 		res.total_iter = solver_.max_steps();
 		int conv_count = 0;
+		auto locking_tolerance = 0.0;
+		auto inner_tolerance = 0.0;
+		auto normres = gpu::array<complex, 2>{};
 		for(int iiter = 0; iiter < solver_.max_steps(); iiter++){
 			
 			CALI_CXX_MARK_SCOPE("scf_iteration");
 			
-			if(solver_.subspace_diag()) {
-				int ilot = 0;
-				for(auto & phi : electrons.kpin()) {
-					electrons.eigenvalues()[ilot] = subspace_diagonalization(ham_, phi);
-					ilot++;
+			// the filter ends with a subspace diagonalization, for it this one only gives the first eigenvalues, that set its bounds
+			auto const chebyshev = solver_.eigensolver() == options::ground_state::scf_eigensolver::CHEBYSHEV_FILTER;
+			if(chebyshev ? iiter == 0 : solver_.subspace_diag()) {
+				for(int ilot = 0; ilot < electrons.kpin_size(); ilot++) {
+					if(solver_.use_real_orbitals()) {
+						electrons.eigenvalues()[ilot] = subspace_diagonalization(ham_, real_kpin[ilot], workspace_);
+					} else {
+						electrons.eigenvalues()[ilot] = subspace_diagonalization(ham_, electrons.kpin()[ilot], workspace_);
+					}
 				}
 				electrons.update_occupations(electrons.eigenvalues());
 			}
@@ -166,27 +294,39 @@ public:
 				old_exe = exe;
 			}
 			
+			int ilot = 0;
 			for(auto & phi : electrons.kpin()) {
-				auto fphi = operations::transform::to_fourier(std::move(phi));
-				
-				switch(solver_.eigensolver()){
-					
-				case options::ground_state::scf_eigensolver::STEEPEST_DESCENT:
-					eigensolvers::steepest_descent(ham_, prec, fphi);
-					break;
-					
-				default:
-					assert(false);
+
+				// the residuals from the previous iteration are already for the current hamiltonian, if all the bands are converged we skip the set
+				if(locking_tolerance > 0.0 and all_converged(phi, normres[ilot], locking_tolerance)) {
+					ilot++;
+					continue;
 				}
 				
-				phi = operations::transform::to_real(std::move(fphi));
+				if(solver_.use_real_orbitals()) {
+					eigensolver_step(real_kpin[ilot], prec, electrons.eigenvalues()[ilot], locking_tolerance, num_inner_steps(phi, normres[ilot], inner_tolerance));
+				} else {
+					// the memory of phi is released while the eigensolver works on fphi
+					auto & fphi = workspace_.reciprocal_orbitals("calculator::fphi", phi);
+					operations::transform::to_fourier(phi, fphi);
+					auto extensions = phi.matrix().extensions();
+					phi.matrix().reextent({0, 0});
+					eigensolver_step(fphi, prec, electrons.eigenvalues()[ilot], locking_tolerance, num_inner_steps(phi, normres[ilot], inner_tolerance));
+					phi.matrix().reextent(extensions);
+					operations::transform::to_real(fphi, phi);
+				}
+
+				ilot++;
 			}
+
+			// the Rayleigh-Ritz step of the filter gives new eigenvalues
+			if(solver_.eigensolver() == options::ground_state::scf_eigensolver::CHEBYSHEV_FILTER) electrons.update_occupations(electrons.eigenvalues());
 			
 			CALI_MARK_BEGIN("mixing");
 			
 			double density_diff = 0.0;
 			{
-				auto new_density = observables::density::calculate(electrons);
+				auto new_density = solver_.use_real_orbitals() ? observables::density::calculate(real_electrons) : observables::density::calculate(electrons);
 				density_diff = operations::integral_sum_absdiff(electrons.spin_density(), new_density);
 				density_diff /= electrons.states().num_electrons();
 				
@@ -205,7 +345,7 @@ public:
 			CALI_MARK_END("mixing");
 			
 			{
-				auto normres = res.energy.calculate(ham_, electrons);
+				normres = solver_.use_real_orbitals() ? res.energy.calculate(ham_, real_electrons) : res.energy.calculate(ham_, electrons);
 				auto energy_diff = (res.energy.eigenvalues() - old_energy)/electrons.states().num_electrons();
 
 				electrons.full_comm().barrier();
@@ -235,9 +375,22 @@ public:
 				}
 
 				old_energy = res.energy.eigenvalues();
+
+				// the orbitals do not need to be converged beyond the accuracy of the density
+				if(solver_.eigensolver() == options::ground_state::scf_eigensolver::STEEPEST_DESCENT) {
+					inner_tolerance = 0.1*density_diff;
+					if(solver_.use_band_locking()) locking_tolerance = inner_tolerance;
+				}
 			}
 		}
 
+		// the electrons get back their orbitals
+		for(unsigned ilot = 0; ilot < real_kpin.size(); ilot++) {
+			electrons.kpin()[ilot].matrix().reextent(real_kpin[ilot].matrix().extensions());
+			states::change_precision(real_kpin[ilot], electrons.kpin()[ilot]);
+		}
+		real_kpin.clear();
+		
 		if(solver_.max_steps() > 0 and not converged) {
 			throw std::runtime_error("The SCF calculation did not converge. Try reducing the mixing parameter.\n"); 
 		}
@@ -245,7 +398,7 @@ public:
 		//make sure we have a density consistent with phi
 		electrons.spin_density() = observables::density::calculate(electrons);
 		sc_.update_hamiltonian(ham_, res.energy, electrons.spin_density());
-		auto normres = res.energy.calculate(ham_, electrons);
+		normres = res.energy.calculate(ham_, electrons);
 			
 		if(solver_.calc_forces() and electrons.states().spinor_dim() == 1) {
 			res.forces = hamiltonian::calculate_forces(ions_, electrons, ham_);
@@ -277,6 +430,21 @@ public:
 	auto & hamiltonian() const {
 		return ham_;
 	}
+
+	auto & hamiltonian() {
+		return ham_;
+	}
+
+	/////////////////////////////////////////
+
+	// the ions referenced by the calculator have moved, the projectors have to be recalculated
+	void update_ions(systems::electrons const & electrons) {
+		// the k-points were reduced with the symmetries of the old positions, that the new ones might not have
+		if(electrons.brillouin_zone().symmetries().size() > 1) {
+			throw std::runtime_error("INQ error: The ions cannot be moved with a k-point grid reduced with symmetries.");
+		}
+		ham_.update_projectors(electrons.states_basis(), electrons.atomic_pot(), ions_);
+	}
 	
 	
 };
@@ -291,8 +459,28 @@ public:
 
 TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 	using namespace inq;
+	using namespace inq::magnitude;
 	using namespace Catch::literals;
 	using Catch::Approx;
+
+	parallel::communicator comm{boost::mpi3::environment::get_world_instance()};
+	parallel::cartesian_communicator<2> cart_comm(comm, {});
+
+	basis::real_space rs(systems::cell::cubic(4.0_b), /*spacing = */ 0.5, basis::basis_subcomm(cart_comm));
+	auto phi = states::orbital_set<basis::real_space, complex>(rs, 4, 1, vector3<double, covariant>{0.0, 0.0, 0.0}, 0, cart_comm);
+
+	SECTION("Number of inner steps"){
+		
+		gpu::array<complex, 1> normres(phi.local_spinor_set_size(), 1.0e-12);
+
+		CHECK(ground_state::calculator::num_inner_steps(phi, normres, 0.0) == 5);
+		CHECK(ground_state::calculator::num_inner_steps(phi, normres, 1.0e-3) == 1);
+
+		if(phi.spinor_set_part().contains(1)) normres[phi.spinor_set_part().global_to_local(parallel::global_index(1))] = 16.0e-6;
+		CHECK(ground_state::calculator::num_inner_steps(phi, normres, 1.0e-3) == 2);
+		CHECK(ground_state::calculator::num_inner_steps(phi, normres, 1.0e-4) == 5);
+		CHECK(ground_state::calculator::num_inner_steps(phi, normres, 1.0e-4, /* max_steps = */ 10) == 6);
+	}
 }
 #endif
 
@@ -0,0 +1,236 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef INQ__GROUND_STATE__LCAO
+#define INQ__GROUND_STATE__LCAO
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <pseudopod/math/sharmonic.hpp>
+
+#include <basis/real_space.hpp>
+#include <basis/spherical_grid.hpp>
+#include <hamiltonian/atomic_potential.hpp>
+#include <matrix/diagonalize.hpp>
+#include <operations/orthogonalize.hpp>
+#include <operations/overlap.hpp>
+#include <operations/randomize.hpp>
+#include <operations/rotate.hpp>
+#include <states/orbital_set.hpp>
+#include <systems/electrons.hpp>
+#include <systems/ions.hpp>
+#include <utils/profiling.hpp>
+
+#include <algorithm>
+
+namespace inq {
+namespace ground_state {
+
+// A linear combination of atomic orbitals (LCAO) initial guess. The
+// pseudopotentials don't give us the atomic pseudo-wavefunctions, so
+// the radial part of the orbitals of an atom is the square root of
+// its atomic pseudo-density (an exponential if the pseudopotential
+// doesn't have one) times r^l, with the real spherical harmonics of
+// all the angular momentum channels up to the largest one that has a
+// projector in the pseudopotential (s only for a local one). The
+// Hamiltonian is diagonalized in the space of these orbitals (plus
+// random functions if there are more states than atomic orbitals)
+// and the lowest eigenvectors are the new orbitals.
+
+template <typename PseudoType>
+int lcao_max_l(PseudoType const & ps) {
+	int lmax = 0;
+	for(int iproj_l = 0; iproj_l < ps.num_projectors_l(); iproj_l++) lmax = std::max(lmax, ps.projector_l(iproj_l));
+	return lmax;
+}
+
+inline long lcao_num_orbitals(systems::ions const & ions, hamiltonian::atomic_potential const & atomic_pot) {
+	long num = 0;
+	for(int iatom = 0; iatom < ions.size(); iatom++){
+		auto lmax = lcao_max_l(atomic_pot.pseudo_for_element(ions.species(iatom)));
+		num += (lmax + 1)*(lmax + 1);
+	}
+	return num;
+}
+
+template <typename RadialType, typename OrbitalSetType>
+void lcao_add_atom(basis::spherical_grid const & sphere, int const lmax, long const offset, RadialType const & radial, OrbitalSetType & phi) {
+
+	auto nlm = (lmax + 1)*(lmax + 1);
+
+	// the orbitals store the periodic part of the Bloch functions, so the phase only depends on the position relative to the atom
+	gpu::run(nlm, sphere.size(),
+					 [ph = begin(phi.hypercubic()), sph = sphere.ref(), radial, offset, first = phi.spinor_set_part().start(), nlocal = phi.local_spinor_set_size(),
+						metric = phi.basis().cell().metric(), kpoint = phi.kpoint()] GPU_LAMBDA (auto ilm, auto ipoint){
+						 auto ist = offset + long(ilm) - first;
+						 if(ist < 0 or ist >= nlocal) return;
+
+						 int ll = 0;
+						 while((ll + 1)*(ll + 1) <= int(ilm)) ll++;
+						 auto mm = int(ilm) - ll*ll - ll;
+
+						 auto rr = sph.distance(ipoint);
+						 auto val = radial(rr)*pow(rr, ll)*pseudo::math::sharmonic(ll, mm, metric.to_cartesian(sph.point_pos(ipoint)));
+						 auto point = sph.grid_point(ipoint);
+						 gpu::atomic::add(&ph[point[0]][point[1]][point[2]][ist], val*polar(1.0, -dot(kpoint, sph.point_pos(ipoint))));
+					 });
+}
+
+// Replaces the first columns of phi by the atomic orbitals, the rest is not modified
+template <typename OrbitalSetType>
+void lcao_orbitals(systems::ions const & ions, hamiltonian::atomic_potential const & atomic_pot, OrbitalSetType & phi) {
+
+	CALI_CXX_MARK_FUNCTION;
+
+	assert(phi.spinor_dim() == 1);
+
+	auto nao = lcao_num_orbitals(ions, atomic_pot);
+	auto first = phi.spinor_set_part().start();
+	auto nlocal = phi.local_spinor_set_size();
+
+	gpu::run(nlocal, phi.basis().local_size(),
+					 [ph = begin(phi.matrix()), first, nao] GPU_LAMBDA (auto ist, auto ip){
+						 if(first + long(ist) < nao) ph[ip][ist] = 0.0;
+					 });
+
+	long offset = 0;
+	for(int iatom = 0; iatom < ions.size(); iatom++){
+		auto & ps = atomic_pot.pseudo_for_element(ions.species(iatom));
+		auto lmax = lcao_max_l(ps);
+		auto nlm = (lmax + 1)*(lmax + 1);
+
+		// the orbitals of this atom are not stored in this processor
+		if(offset + nlm <= first or offset >= first + nlocal) {
+			offset += nlm;
+			continue;
+		}
+
+		if(ps.has_electronic_density()){
+			basis::spherical_grid sphere(phi.basis(), ions.positions()[iatom], ps.electronic_density_radius());
+			lcao_add_atom(sphere, lmax, offset, [spline = ps.electronic_density().function()] GPU_LAMBDA (auto rr) { return sqrt(fmax(spline(rr), 0.0)); }, phi);
+		} else {
+			//the same crude guess used for the atomic density
+			basis::spherical_grid sphere(phi.basis(), ions.positions()[iatom], 5.0);
+			lcao_add_atom(sphere, lmax, offset, [] GPU_LAMBDA (auto rr) { return exp(-rr); }, phi);
+		}
+
+		offset += nlm;
+	}
+}
+
+// Copies the first columns of source to destination, the two sets can be distributed differently
+template <typename OrbitalSetType>
+void lcao_copy_columns(OrbitalSetType const & source, OrbitalSetType & destination) {
+
+	CALI_CXX_MARK_FUNCTION;
+
+	auto const & spart = source.spinor_set_part();
+	auto const & dpart = destination.spinor_set_part();
+	auto np = destination.basis().local_size();
+
+	if(not dpart.parallel()){
+		gpu::run(dpart.local_size(), np,
+						 [src = begin(source.matrix()), dst = begin(destination.matrix())] GPU_LAMBDA (auto ist, auto ip){
+							 dst[ip][ist] = src[ip][ist];
+						 });
+		return;
+	}
+
+	for(int istep = 0; istep < dpart.comm_size(); istep++){
+		gpu::array<typename OrbitalSetType::element_type, 2> block({np, dpart.local_size(istep)}, 0.0);
+
+		gpu::run(dpart.local_size(istep), np,
+						 [src = begin(source.matrix()), blo = begin(block), dstart = dpart.start(istep), sstart = spart.start(), send = spart.end()] GPU_LAMBDA (auto ist, auto ip){
+							 auto gist = dstart + long(ist);
+							 if(gist >= sstart and gist < send) blo[ip][ist] = src[ip][gist - sstart];
+						 });
+
+		destination.set_comm().reduce_n(raw_pointer_cast(block.data_elements()), block.num_elements(), raw_pointer_cast(destination.matrix().data_elements()), std::plus<>{}, /* root = */ istep);
+	}
+}
+
+template <typename HamiltonianType>
+void lcao_guess(HamiltonianType const & ham, systems::ions const & ions, systems::electrons & electrons) {
+
+	CALI_CXX_MARK_FUNCTION;
+
+	if(ions.size() == 0) return;
+	if(electrons.states().spinor_dim() != 1) throw std::runtime_error("INQ error: The LCAO initial guess is not implemented for spinors.");
+
+	auto nao = lcao_num_orbitals(ions, electrons.atomic_pot());
+
+	int iphi = 0;
+	for(auto & phi : electrons.kpin()) {
+		auto nbasis = std::max(nao, long(phi.spinor_set_size()));
+
+		auto aos = states::orbital_set<basis::real_space, complex>(phi.basis(), nbasis, 1, phi.kpoint(), phi.spin_index(), phi.full_comm());
+		operations::randomize(aos, iphi + electrons.kpin_part().start());
+		lcao_orbitals(ions, electrons.atomic_pot(), aos);
+		operations::orthogonalize(aos);
+
+		auto subspace_hamiltonian = operations::overlap(aos, ham(aos));
+		auto eigenvalues = matrix::diagonalize(subspace_hamiltonian);
+		operations::rotate(subspace_hamiltonian, aos);
+
+		lcao_copy_columns(aos, phi);
+
+		for(long ist = 0; ist < phi.local_spinor_set_size(); ist++) electrons.eigenvalues()[iphi][ist] = eigenvalues[phi.spinor_set_part().start() + ist];
+
+		iphi++;
+	}
+
+	electrons.update_occupations(electrons.eigenvalues());
+}
+
+}
+}
+#endif
+
+#ifdef INQ_GROUND_STATE_LCAO_UNIT_TEST
+#undef INQ_GROUND_STATE_LCAO_UNIT_TEST
+
+#include <operations/overlap_diagonal.hpp>
+
+#include <catch2/catch_all.hpp>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+	using namespace inq;
+	using namespace inq::magnitude;
+	using namespace Catch::literals;
+	using Catch::Approx;
+
+	parallel::communicator comm{boost::mpi3::environment::get_self_instance()};
+	parallel::cartesian_communicator<2> cart_comm(comm, {});
+
+	auto ions = systems::ions::parse(config::path::unit_tests_data() + "benzene.xyz", systems::cell::cubic(20.0_b));
+	basis::real_space rs(ions.cell(), /*spacing = */ 0.49672941, comm);
+	hamiltonian::atomic_potential pot(ions.species_list(), rs.gcutoff());
+
+	// the channels come from the projectors: s and p for carbon
+	auto lmax_c = ground_state::lcao_max_l(pot.pseudo_for_element(ionic::species("C")));
+	auto lmax_h = ground_state::lcao_max_l(pot.pseudo_for_element(ionic::species("H")));
+	CHECK(lmax_c == 1);
+	
+	auto nao = 6*(lmax_c + 1)*(lmax_c + 1) + 6*(lmax_h + 1)*(lmax_h + 1);
+	CHECK(ground_state::lcao_num_orbitals(ions, pot) == nao);
+
+	// a transition metal gets d orbitals
+	pseudo::math::erf_range_separation const sep(0.625);
+	hamiltonian::atomic_potential::pseudopotential_type ps_w(config::path::unit_tests_data() + "W_ONCV_PBE-1.0.upf", sep, rs.gcutoff());
+	CHECK(ground_state::lcao_max_l(ps_w) == 2);
+	
+	auto phi = states::orbital_set<basis::real_space, complex>(rs, nao + 2, 1, vector3<double, covariant>{0.0, 0.0, 0.0}, 0, cart_comm);
+	phi.fill(1.0);
+
+	ground_state::lcao_orbitals(ions, pot, phi);
+
+	auto nrm = operations::overlap_diagonal(phi);
+
+	// all the atomic orbitals have some weight in the grid, the extra columns are not touched
+	for(int ist = 0; ist < nao; ist++) CHECK(real(nrm[ist]) > 1e-3);
+	CHECK(real(nrm[nao + 1]) == Approx(rs.size()*rs.volume_element()));
+}
+#endif
@@ -14,6 +14,7 @@
 #include <operations/overlap.hpp>
 #include <operations/rotate.hpp>
 #include <utils/profiling.hpp>
+#include <utils/workspace.hpp>
 
 namespace inq {
 namespace ground_state {
@@ -28,6 +29,19 @@ auto subspace_diagonalization(const hamiltonian_type & ham, field_set_type & phi
 	return +eigenvalues({phi.spinor_set_part().start(), phi.spinor_set_part().end()});
 }
 
+// the same, but hphi is taken from the workspace
+template <class hamiltonian_type, class field_set_type>
+auto subspace_diagonalization(const hamiltonian_type & ham, field_set_type & phi, utils::workspace & work){
+	CALI_CXX_MARK_FUNCTION;
+
+	auto & hphi = work.orbitals("subspace_diagonalization::hphi", phi);
+	ham(phi, hphi, work);
+	auto subspace_hamiltonian = operations::overlap(phi, hphi);
+	auto eigenvalues = matrix::diagonalize(subspace_hamiltonian);
+	operations::rotate(subspace_hamiltonian, phi);
+	return +eigenvalues({phi.spinor_set_part().start(), phi.spinor_set_part().end()});
+}
+
 }
 }
 #endif
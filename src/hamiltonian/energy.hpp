@@ -13,6 +13,8 @@
 
 #include <tinyformat/tinyformat.h>
 
+#include <type_traits>
+
 namespace inq {
 namespace hamiltonian {
 
@@ -84,10 +86,13 @@ public:
 					non_local_ += occ_sum(el.occupations()[iphi], nl_me);
 				}
 
-				if(ham.exchange().enabled()){
-					CALI_CXX_MARK_SCOPE("energy::calculate::exchange");
-					auto exchange_me = operations::overlap_diagonal_normalized(ham.exchange()(phi), phi);
-					exact_exchange_ += 0.5*occ_sum(el.occupations()[iphi], exchange_me);
+				// there is no exact exchange for real orbitals
+				if constexpr(not std::is_same_v<typename std::decay_t<decltype(phi)>::element_type, double>) {
+					if(ham.exchange().enabled()){
+						CALI_CXX_MARK_SCOPE("energy::calculate::exchange");
+						auto exchange_me = operations::overlap_diagonal_normalized(ham.exchange()(phi), phi);
+						exact_exchange_ += 0.5*occ_sum(el.occupations()[iphi], exchange_me);
+					}
 				}
 
 				iphi++;
@@ -22,6 +22,7 @@
 #include <solvers/poisson.hpp>
 #include <states/index.hpp>
 #include <states/orbital_set.hpp>
+#include <utils/raw_pointer_cast.hpp>
 
 #include <optional>
 
@@ -39,10 +40,13 @@ namespace hamiltonian {
 		bool use_ace_;
 		singularity_correction sing_;
 		states::index orbital_index_;
+		double ace_error_ = 0.0;
 		
   public:
 
-		exchange_operator(systems::cell const & cell, ionic::brillouin const & bzone, double const exchange_coefficient, bool const use_ace):
+		exchange_operator(systems::cell const & cell, ionic::brillouin const & bzone, double const exchange_coefficient, bool const use_ace,
+											options::theory::poisson_solver isolated_poisson = options::theory::poisson_solver::CUTOFF):
+			poisson_solver_(isolated_poisson),
 			exchange_coefficient_(exchange_coefficient),
 			use_ace_(use_ace),
 			sing_(cell, bzone){
@@ -81,10 +85,14 @@ namespace hamiltonian {
 			}
 
 			if(not use_ace_) return 0.0;
-			
-			ace_orbitals_.clear();
+
+			// the previous operator, if there is one, is compared with the exact exchange on the new orbitals
+			auto check_error = ace_orbitals_.size() == el.kpin().size();
+			std::vector<states::orbital_set<basis::real_space, complex>> new_ace_orbitals;
 			
 			auto energy = 0.0;
+			auto error = 0.0;
+			auto exact_norm = 0.0;
 			{
 				auto iphi = 0;
 				for(auto & phi : el.kpin()){
@@ -92,6 +100,17 @@ namespace hamiltonian {
 					orbital_index_[phi.key()] = iphi;
 					
 					auto exxphi = direct(phi, -1.0);
+
+					if(check_error) {
+						auto diff = ace(phi);
+						gpu::run(diff.matrix().num_elements(),
+										 [di = raw_pointer_cast(diff.matrix().data_elements()), ex = raw_pointer_cast(exxphi.matrix().data_elements())] GPU_LAMBDA (auto ii){
+											 di[ii] += ex[ii];
+										 });
+						error += real(operations::sum_product(el.occupations()[iphi], operations::overlap_diagonal(diff)));
+						exact_norm += real(operations::sum_product(el.occupations()[iphi], operations::overlap_diagonal(exxphi)));
+					}
+					
 					auto exx_matrix = operations::overlap(exxphi, phi);
 					
 					energy += -0.5*real(operations::sum_product(el.occupations()[iphi], matrix::diagonal(exx_matrix)));
@@ -99,17 +118,83 @@ namespace hamiltonian {
 					matrix::cholesky(exx_matrix);
 					operations::rotate_trs(exx_matrix, exxphi);
 					
-					ace_orbitals_.emplace_back(std::move(exxphi));
+					new_ace_orbitals.emplace_back(std::move(exxphi));
 					
 					iphi++;
 				}
 			}
 
+			ace_orbitals_ = std::move(new_ace_orbitals);
+
+			if(check_error) {
+				el.kpin_states_comm().all_reduce_n(&error, 1);
+				el.kpin_states_comm().all_reduce_n(&exact_norm, 1);
+				ace_error_ = (exact_norm > 0.0) ? sqrt(error/exact_norm) : 0.0;
+			}
+			
 			el.kpin_states_comm().all_reduce_n(&energy, 1);
 
 			return energy;
 		}
 
+		//////////////////////////////////////////////////////////////////////////////////
+
+		// How much the orbitals have changed since the last update, as the
+		// occupation-weighted average of 1 - |<phi_old|phi_new>|^2. It only
+		// needs the stored orbitals, no Poisson solutions.
+		template <class ElectronsType>
+		double drift(ElectronsType const & el) const {
+			if(not orbitals_.has_value()) return 1.0;
+			
+			CALI_CXX_MARK_SCOPE("exchange_operator::drift");
+			
+			auto drift = 0.0;
+			auto total = 0.0;
+			auto ist = 0;
+			auto iphi = 0;
+			for(auto & phi : el.kpin()){
+				auto np = phi.basis().local_size();
+				auto nst = phi.local_set_size();
+				auto olap = operations::overlap_diagonal_impl(phi.basis(), orbitals_->matrix()({0, np}, {ist, ist + nst}), phi.matrix()({0, np}, {0, nst}));
+
+				for(int jst = 0; jst < nst; jst++){
+					auto occ = el.occupations()[iphi][jst/phi.spinor_dim()];
+					drift += occ*(1.0 - norm(olap[jst]));
+					total += occ;
+				}
+				
+				ist += nst;
+				iphi++;
+			}
+
+			el.kpin_states_comm().all_reduce_n(&drift, 1);
+			el.kpin_states_comm().all_reduce_n(&total, 1);
+			
+			return (total > 0.0) ? drift/total : 0.0;
+		}
+
+		//////////////////////////////////////////////////////////////////////////////////
+
+		// Updates the operator only if the orbitals have drifted more than
+		// the tolerance since the last update. Without ACE the operator is
+		// always updated, since it uses the orbitals directly. Returns true
+		// if the operator was updated.
+		template <class ElectronsType>
+		bool refresh(ElectronsType const & el, double const tolerance){
+			if(not enabled()) return false;
+			if(use_ace_ and ace_orbitals_.size() == el.kpin().size() and tolerance > 0.0 and drift(el) < tolerance) return false;
+			update(el);
+			return true;
+		}
+
+		//////////////////////////////////////////////////////////////////////////////////
+
+		// The relative error of the previous ACE operator with respect to the
+		// direct exchange, measured on the orbitals of the last update
+		auto ace_error() const {
+			return ace_error_;
+		}
+		
 		//////////////////////////////////////////////////////////////////////////////////
 		
 		auto direct(const states::orbital_set<basis::real_space, complex> & phi, double scale = 1.0) const {
@@ -227,6 +312,12 @@ namespace hamiltonian {
 			return fabs(exchange_coefficient_) > 1.0e-14;
 		}
 
+		//////////////////////////////////////////////////////////////////////////////////
+
+		auto & poisson_solver() const {
+			return poisson_solver_;
+		}
+
   };
 
 }
@@ -238,11 +329,79 @@ namespace hamiltonian {
 
 #include <catch2/catch_all.hpp>
 #include <basis/real_space.hpp>
+#include <ground_state/initial_guess.hpp>
+#include <systems/electrons.hpp>
 
 TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG){
 
 	using namespace inq;
+	using namespace inq::magnitude;
 	using namespace Catch::literals;
+	using Catch::Approx;
+
+	parallel::communicator comm{boost::mpi3::environment::get_world_instance()};
+	auto par = input::parallelization(comm);
+
+	systems::ions ions(systems::cell::cubic(6.0_b));
+	systems::electrons electrons(par, ions, options::electrons{}.cutoff(15.0_Ha).extra_electrons(8.0));
+	ground_state::initial_guess(ions, electrons);
+
+	SECTION("Disabled"){
+		hamiltonian::exchange_operator exop(ions.cell(), electrons.brillouin_zone(), 0.0, /* use_ace = */ true);
+
+		CHECK(not exop.enabled());
+		CHECK(not exop.refresh(electrons, 0.0));
+		CHECK(not exop.refresh(electrons, 1e-3));
+	}
+	
+	SECTION("Drift and refresh"){
+		hamiltonian::exchange_operator exop(ions.cell(), electrons.brillouin_zone(), 1.0, /* use_ace = */ true);
+
+		CHECK(exop.enabled());
+
+		// without an operator there is nothing to compare with
+		CHECK(exop.drift(electrons) == 1.0);
+		CHECK(exop.refresh(electrons, 1e-3));
+		CHECK(exop.drift(electrons) == Approx(0.0).margin(1e-12));
+
+		// the orbitals have not changed
+		CHECK(not exop.refresh(electrons, 1e-3));
+
+		// a zero tolerance always updates, and the operator is exact on the orbitals it was built from
+		CHECK(exop.refresh(electrons, 0.0));
+		CHECK(exop.ace_error() == Approx(0.0).margin(1e-6));
+
+		// a global phase is not a change of the orbitals
+		for(auto & phi : electrons.kpin()) {
+			gpu::run(phi.matrix().num_elements(), [ph = raw_pointer_cast(phi.matrix().data_elements())] GPU_LAMBDA (auto ii){
+				ph[ii] *= complex(0.0, 1.0);
+			});
+		}
+		CHECK(exop.drift(electrons) == Approx(0.0).margin(1e-12));
+		CHECK(not exop.refresh(electrons, 1e-3));
+
+		// a plane-wave modulation is
+		for(auto & phi : electrons.kpin()) {
+			auto kk = 2.0*M_PI/6.0;
+			for(int ix = 0; ix < phi.basis().local_sizes()[0]; ix++){
+				for(int iy = 0; iy < phi.basis().local_sizes()[1]; iy++){
+					for(int iz = 0; iz < phi.basis().local_sizes()[2]; iz++){
+						auto rr = phi.basis().point_op().rvector_cartesian(ix, iy, iz);
+						for(int ist = 0; ist < phi.local_set_size(); ist++) phi.hypercubic()[ix][iy][iz][ist] *= exp(complex(0.0, kk*rr[0]));
+					}
+				}
+			}
+		}
+
+		auto drift = exop.drift(electrons);
+		CHECK(drift > 1e-3);
+		CHECK(drift <= 1.0);
+		CHECK(exop.refresh(electrons, 1e-3));
+		CHECK(exop.drift(electrons) == Approx(0.0).margin(1e-12));
+
+		// the operator built for the old orbitals is not accurate for the new ones
+		CHECK(exop.ace_error() > 1e-3);
+	}
 	
 }
 #endif
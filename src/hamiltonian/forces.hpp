@@ -65,7 +65,7 @@ gpu::array<vector3<double>, 1> calculate_forces(const systems::ions & ions, syst
 
 	{ CALI_CXX_MARK_SCOPE("forces_local");
 		
-		solvers::poisson poisson_solver;
+		solvers::poisson poisson_solver(ham.exchange().poisson_solver().isolated_method());
 		
 		//the force from the local potential
 		for(int iatom = 0; iatom < ions.size(); iatom++){
@@ -91,8 +91,9 @@ gpu::array<vector3<double>, 1> calculate_forces(const systems::ions & ions, syst
   }
 	
   // MISSING: the non-linear core correction term
-  
-  return forces;
+
+	// the non-local term from a reduced set of k-points only has the symmetry of the crystal after the average
+	return electrons.brillouin_zone().symmetries().symmetrize_forces(ions, forces);
 }
 
 }
@@ -25,6 +25,7 @@
 #include <states/orbital_set.hpp>
 
 #include <utils/profiling.hpp>
+#include <utils/workspace.hpp>
 
 #include <list>
 #include <unordered_map>
@@ -49,6 +50,25 @@ private:
 	std::unordered_map<std::string, projector_fourier> projectors_fourier_map_;
 	std::vector<std::unordered_map<std::string, projector_fourier>::iterator> projectors_fourier_;
 	states::ks_states states_;
+	systems::ions::positions_type projector_positions_;
+
+	// Recalculates, in place, the projectors of the atoms that moved since the last update. It
+	// returns false if an atom changed its species, then a full update is needed.
+	bool update_moved_projectors(const basis::real_space & basis, const atomic_potential & pot, systems::ions const & ions){
+
+		CALI_CXX_MARK_FUNCTION;
+		
+		for(int iproj = 0; iproj < projectors_all_.num_projectors(); iproj++){
+			auto iatom = projectors_all_.iatom(iproj);
+			if(ions.positions()[iatom] == projector_positions_[iatom]) continue;
+
+			projector proj(basis, pot.double_grid(), pot.pseudo_for_element(ions.species(iatom)), ions.positions()[iatom], iatom);
+			if(not projectors_all_.replace(iproj, proj)) return false;
+			projector_positions_[iatom] = ions.positions()[iatom];
+		}
+
+		return true;
+	}
 	
 public:
 	
@@ -56,6 +76,9 @@ public:
 			
 		CALI_CXX_MARK_FUNCTION;
 
+		// the same atoms, maybe in different positions
+		if(not non_local_in_fourier_ and long(projector_positions_.size()) == ions.size() and update_moved_projectors(basis, pot, ions)) return;
+		
 		std::list<projector> projectors;
 			
 		projectors_fourier_map_.clear();			
@@ -71,14 +94,15 @@ public:
 		}
 
 		projectors_all_ = projector_all(projectors);
+		projector_positions_ = ions.positions();
 	}
 		
 
 	////////////////////////////////////////////////////////////////////////////////////////////
 		
 	ks_hamiltonian(const basis::real_space & basis, ionic::brillouin const & bzone, states::ks_states const & states, atomic_potential const & pot, systems::ions const & ions,
-								 const double exchange_coefficient, bool use_ace = false):
-		exchange_(basis.cell(), bzone, exchange_coefficient, use_ace),
+								 const double exchange_coefficient, bool use_ace = false, options::theory::poisson_solver isolated_poisson = options::theory::poisson_solver::CUTOFF):
+		exchange_(basis.cell(), bzone, exchange_coefficient, use_ace, isolated_poisson),
 		scalar_potential_(basis, states.num_density_components()),
 		uniform_vector_potential_({0.0, 0.0, 0.0}),
 		non_local_in_fourier_(pot.fourier_pseudo()),
@@ -129,6 +153,26 @@ public:
 
 	////////////////////////////////////////////////////////////////////////////////////////////
 
+	// Real orbitals, only valid at the Gamma point
+	
+	auto non_local(const states::orbital_set<basis::real_space, double> & phi) const {
+
+		CALI_CXX_MARK_FUNCTION;
+
+		assert(not non_local_in_fourier_);
+		
+		auto proj = projectors_all_.project(phi, phi.kpoint());
+		
+		states::orbital_set<basis::real_space, double> vnlphi(phi.skeleton());
+		vnlphi.fill(0.0);
+		
+		projectors_all_.apply(proj, vnlphi, phi.kpoint());
+		
+		return vnlphi;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////
+
 	auto operator()(const states::orbital_set<basis::real_space, complex> & phi) const {
 			
 		CALI_CXX_MARK_SCOPE("hamiltonian_real");
@@ -153,6 +197,32 @@ public:
 
 	////////////////////////////////////////////////////////////////////////////////////////////
 
+	// Real orbitals, only valid at the Gamma point. The kinetic energy is applied with real to complex transforms.
+	
+	auto operator()(const states::orbital_set<basis::real_space, double> & phi) const {
+			
+		CALI_CXX_MARK_SCOPE("hamiltonian_real_gamma");
+
+		assert(not phi.spinors());
+		assert(not exchange_.enabled());
+		assert(not non_local_in_fourier_);
+		assert(phi.basis().cell().metric().norm(phi.kpoint() + uniform_vector_potential_) == 0.0);
+		
+		auto proj = projectors_all_.project(phi, phi.kpoint());
+			
+		auto phi_fs = operations::transform::to_fourier_r2c(phi);
+		operations::laplacian_in_place(phi_fs, -0.5);
+		auto hphi = operations::transform::to_real_c2r(phi_fs);
+
+		hamiltonian::scalar_potential_add(scalar_potential_, phi.spin_index(), 0.0, phi, hphi);
+
+		projectors_all_.apply(proj, hphi, phi.kpoint());
+
+		return hphi;
+	}
+	
+	////////////////////////////////////////////////////////////////////////////////////////////
+
 	auto operator()(const states::orbital_set<basis::fourier_space, complex> & phi) const{
 			
 		CALI_CXX_MARK_SCOPE("hamiltonian_fourier");
@@ -177,6 +247,96 @@ public:
 
 	////////////////////////////////////////////////////////////////////////////////////////////
 
+	// These versions write the result in hphi and take all the temporaries from the workspace.
+	
+	void operator()(const states::orbital_set<basis::real_space, complex> & phi, states::orbital_set<basis::real_space, complex> & hphi, utils::workspace & work) const {
+			
+		CALI_CXX_MARK_SCOPE("hamiltonian_real");
+
+		auto & proj = projectors_all_.project(phi, phi.kpoint() + uniform_vector_potential_, work);
+			
+		auto & phi_fs = work.reciprocal_orbitals("ks_hamiltonian::phi_fs", phi);
+		operations::transform::to_fourier(phi, phi_fs);
+
+		auto gradcoeff = -2.0*phi.basis().cell().metric().to_contravariant(phi.kpoint() + uniform_vector_potential_);
+		
+		if(non_local_in_fourier_) {
+			auto & hphi_fs = work.reciprocal_orbitals("ks_hamiltonian::hphi_fs", phi);
+			hphi_fs.matrix() = phi_fs.matrix();
+			operations::laplacian_in_place(hphi_fs, -0.5, gradcoeff);
+			non_local(phi_fs, hphi_fs);
+			operations::transform::to_real(hphi_fs, hphi);
+		} else {
+			// phi_fs is not needed anymore, so we can apply the laplacian in place
+			operations::laplacian_in_place(phi_fs, -0.5, gradcoeff);
+			operations::transform::to_real(phi_fs, hphi);
+		}
+
+		hamiltonian::scalar_potential_add(scalar_potential_, phi.spin_index(), 0.5*phi.basis().cell().metric().norm(phi.kpoint() + uniform_vector_potential_), phi, hphi);
+		exchange_(phi, hphi);
+
+		projectors_all_.apply(proj, hphi, phi.kpoint() + uniform_vector_potential_);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////
+
+	void operator()(const states::orbital_set<basis::fourier_space, complex> & phi, states::orbital_set<basis::fourier_space, complex> & hphi, utils::workspace & work) const{
+			
+		CALI_CXX_MARK_SCOPE("hamiltonian_fourier");
+
+		auto & phi_rs = work.reciprocal_orbitals("ks_hamiltonian::phi_rs", phi);
+		operations::transform::to_real(phi, phi_rs);
+
+		auto & proj = projectors_all_.project(phi_rs, phi.kpoint() + uniform_vector_potential_, work);
+
+		auto & hphi_rs = work.orbitals("ks_hamiltonian::hphi_rs", phi_rs);
+		hamiltonian::scalar_potential(scalar_potential_, phi.spin_index(), 0.5*phi.basis().cell().metric().norm(phi.kpoint() + uniform_vector_potential_), phi_rs, hphi_rs);
+		
+		exchange_(phi_rs, hphi_rs);
+ 
+		projectors_all_.apply(proj, hphi_rs, phi.kpoint() + uniform_vector_potential_);
+			
+		operations::transform::to_fourier(hphi_rs, hphi);
+
+		operations::laplacian_add(phi, hphi, -0.5, -2.0*phi.basis().cell().metric().to_contravariant(phi.kpoint() + uniform_vector_potential_));
+		non_local(phi, hphi);
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////
+
+	// the half spectrum buffer can't be obtained with reciprocal_orbitals, so it is matched by hand
+	
+	void operator()(const states::orbital_set<basis::real_space, double> & phi, states::orbital_set<basis::real_space, double> & hphi, utils::workspace & work) const {
+			
+		CALI_CXX_MARK_SCOPE("hamiltonian_real_gamma");
+
+		assert(not phi.spinors());
+		assert(not exchange_.enabled());
+		assert(not non_local_in_fourier_);
+		assert(phi.basis().cell().metric().norm(phi.kpoint() + uniform_vector_potential_) == 0.0);
+		
+		auto & proj = projectors_all_.project(phi, phi.kpoint(), work);
+
+		auto hs_basis = basis::fourier_space(phi.basis(), /* half_spectrum = */ true);
+		auto & phi_fs = work.get<states::orbital_set<basis::fourier_space, complex>>("ks_hamiltonian::phi_hs",
+																																						[&](auto const & set){
+																																							return set.basis() == hs_basis and set.basis().comm().size() == phi.basis().comm().size()
+																																								and set.local_set_size() == phi.local_set_size() and set.set_part().start() == phi.set_part().start();
+																																						},
+																																						[&phi](){ return operations::transform::half_spectrum_field(phi); });
+		phi_fs.relabel(phi.kpoint(), phi.spin_index());
+		
+		operations::transform::to_fourier_r2c(phi, phi_fs);
+		operations::laplacian_in_place(phi_fs, -0.5);
+		operations::transform::to_real_c2r(phi_fs, hphi);
+
+		hamiltonian::scalar_potential_add(scalar_potential_, phi.spin_index(), 0.0, phi, hphi);
+
+		projectors_all_.apply(proj, hphi, phi.kpoint());
+	}
+	
+	////////////////////////////////////////////////////////////////////////////////////////////
+
 	auto momentum(const states::orbital_set<basis::real_space, complex> & phi) const{
 		CALI_CXX_MARK_FUNCTION;
 
@@ -486,6 +646,122 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG){
 		CHECK(diff == 0.0051420503_a);
 		
 	}
+
+	SECTION("Workspace"){
+
+		double ww = 2.0;
+
+		for(int ix = 0; ix < rs.local_sizes()[0]; ix++){
+			for(int iy = 0; iy < rs.local_sizes()[1]; iy++){
+				for(int iz = 0; iz < rs.local_sizes()[2]; iz++){
+
+					auto ixg = rs.cubic_part(0).local_to_global(ix);
+					auto iyg = rs.cubic_part(1).local_to_global(iy);
+					auto izg = rs.cubic_part(2).local_to_global(iz);	
+					
+					double r2 = rs.point_op().r2(ixg, iyg, izg);
+					ham.scalar_potential().hypercubic()[ix][iy][iz][0] = 0.5*ww*ww*r2;
+
+					for(int ist = 0; ist < phi.local_set_size(); ist++){
+						auto istg = phi.set_part().local_to_global(ist);
+						phi.hypercubic()[ix][iy][iz][ist] = exp(-ww*r2)*complex(1.0, 0.1*istg.value());
+					}
+					
+				}
+			}
+		}
+
+		utils::workspace work;
+		
+		auto hphi = ham(phi);
+		auto fphi = operations::transform::to_fourier(phi);
+		auto hfphi = ham(fphi);
+
+		states::orbital_set<basis::real_space, complex> hphi_ws(phi.skeleton());
+		auto hfphi_ws = operations::transform::to_fourier(phi);
+		
+		for(int iter = 0; iter < 3; iter++){
+			ham(phi, hphi_ws, work);
+			ham(fphi, hfphi_ws, work);
+		}
+
+		auto num_allocations = work.num_allocations();
+		ham(phi, hphi_ws, work);
+		ham(fphi, hfphi_ws, work);
+		CHECK(work.num_allocations() == num_allocations);
+		
+		double diff = 0.0;
+		double fdiff = 0.0;
+		for(int ip = 0; ip < hphi.basis().local_size(); ip++){
+			for(int ist = 0; ist < phi.local_set_size(); ist++) diff += fabs(hphi.matrix()[ip][ist] - hphi_ws.matrix()[ip][ist]);
+		}
+		for(int ip = 0; ip < hfphi.basis().local_size(); ip++){
+			for(int ist = 0; ist < phi.local_set_size(); ist++) fdiff += fabs(hfphi.matrix()[ip][ist] - hfphi_ws.matrix()[ip][ist]);
+		}
+
+		cart_comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+		cart_comm.all_reduce_in_place_n(&fdiff, 1, std::plus<>{});
+
+		CHECK(diff < 1e-12);
+		CHECK(fdiff < 1e-12);
+	}
+
+	SECTION("Gamma real"){
+
+		double ww = 2.0;
+
+		for(int ix = 0; ix < rs.local_sizes()[0]; ix++){
+			for(int iy = 0; iy < rs.local_sizes()[1]; iy++){
+				for(int iz = 0; iz < rs.local_sizes()[2]; iz++){
+
+					auto ixg = rs.cubic_part(0).local_to_global(ix);
+					auto iyg = rs.cubic_part(1).local_to_global(iy);
+					auto izg = rs.cubic_part(2).local_to_global(iz);	
+					
+					double r2 = rs.point_op().r2(ixg, iyg, izg);
+					ham.scalar_potential().hypercubic()[ix][iy][iz][0] = 0.5*ww*ww*r2;
+
+					for(int ist = 0; ist < phi.local_set_size(); ist++){
+						auto istg = phi.set_part().local_to_global(ist);
+						phi.hypercubic()[ix][iy][iz][ist] = (1.0 + 0.1*istg.value())*exp(-ww*r2);
+					}
+					
+				}
+			}
+		}
+
+		auto hphi = ham(phi);
+		auto rhphi = ham(states::real_field(phi));
+
+		static_assert(std::is_same_v<decltype(rhphi), states::orbital_set<basis::real_space, double>>);
+
+		utils::workspace work;
+		auto rphi = states::real_field(phi);
+		states::orbital_set<basis::real_space, double> rhphi_ws(rphi.skeleton());
+		
+		for(int iter = 0; iter < 3; iter++) ham(rphi, rhphi_ws, work);
+
+		auto num_allocations = work.num_allocations();
+		ham(rphi, rhphi_ws, work);
+		CHECK(work.num_allocations() == num_allocations);
+		
+		double diff = 0.0;
+		double wsdiff = 0.0;
+		for(int ip = 0; ip < hphi.basis().local_size(); ip++){
+			for(int ist = 0; ist < phi.local_set_size(); ist++) {
+				diff += fabs(hphi.matrix()[ip][ist] - rhphi.matrix()[ip][ist]);
+				wsdiff += fabs(rhphi_ws.matrix()[ip][ist] - rhphi.matrix()[ip][ist]);
+			}
+		}
+
+		cart_comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+		cart_comm.all_reduce_in_place_n(&wsdiff, 1, std::plus<>{});
+		diff /= hphi.set_size()*hphi.basis().size();
+		wsdiff /= hphi.set_size()*hphi.basis().size();
+		
+		CHECK(diff < 1e-12);
+		CHECK(wsdiff < 1e-12);
+	}
 	
 }
 #endif
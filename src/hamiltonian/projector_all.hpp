@@ -16,6 +16,7 @@
 #include <hamiltonian/atomic_potential.hpp>
 #include <utils/profiling.hpp>
 #include <utils/raw_pointer_cast.hpp>
+#include <utils/workspace.hpp>
 
 namespace inq {
 namespace hamiltonian {
@@ -43,35 +44,41 @@ public: // for CUDA
 		
     auto iproj = 0;
     for(auto it = projectors.cbegin(); it != projectors.cend(); ++it) {
-			gpu::run(max_sphere_size_,
-							 [poi = begin(points_), pos = begin(positions_), sph = it->sphere_.ref(), iproj, npoint = it->sphere_.size()] GPU_LAMBDA (auto ipoint){
-								 if(ipoint < unsigned (npoint)){
-									 poi[iproj][ipoint] = sph.grid_point(ipoint);	
-									 pos[iproj][ipoint] = sph.point_pos(ipoint);							 
-								 } else {
-									 poi[iproj][ipoint] = {-1, -1, -1};
-								 }
-							 });
-			
-			gpu::run(max_sphere_size_, max_nlm_,
-							 [mat = begin(matrices_), itmat = begin(it->matrix_), iproj, np = it->sphere_.size(), nlm = it->nproj_] GPU_LAMBDA (auto ipoint, auto ilm){
-								 if(ipoint < (unsigned) np and ilm < (unsigned) nlm) {
-									 mat[iproj][ilm][ipoint] = itmat[ilm][ipoint];
-								 } else {
-									 mat[iproj][ilm][ipoint] = 0.0;								 
-								 }
-							 });
-								 
-      coeff_[iproj]({0, it->nproj_}) = it->kb_coeff_;
-
-			nlm_[iproj] = it->nproj_;
+			copy_projector(iproj, *it);
 			iatom_[iproj] = it->iatom_;
-			locally_empty_[iproj] = it->locally_empty();
-			
       iproj++;
     }
     
 	}
+
+	// copies the points, the values and the KB coefficients of a projector to the padded arrays
+	template <typename ProjectorType>
+	void copy_projector(int const iproj, ProjectorType const & proj){
+
+		coeff_[iproj]({0, proj.nproj_}) = proj.kb_coeff_;
+		
+		gpu::run(max_sphere_size_,
+						 [poi = begin(points_), pos = begin(positions_), sph = proj.sphere_.ref(), iproj, npoint = proj.sphere_.size()] GPU_LAMBDA (auto ipoint){
+							 if(ipoint < unsigned (npoint)){
+								 poi[iproj][ipoint] = sph.grid_point(ipoint);	
+								 pos[iproj][ipoint] = sph.point_pos(ipoint);							 
+							 } else {
+								 poi[iproj][ipoint] = {-1, -1, -1};
+							 }
+						 });
+		
+		gpu::run(max_sphere_size_, max_nlm_,
+						 [mat = begin(matrices_), itmat = begin(proj.matrix_), iproj, np = proj.sphere_.size(), nlm = proj.nproj_] GPU_LAMBDA (auto ipoint, auto ilm){
+							 if(ipoint < (unsigned) np and ilm < (unsigned) nlm) {
+								 mat[iproj][ilm][ipoint] = itmat[ilm][ipoint];
+							 } else {
+								 mat[iproj][ilm][ipoint] = 0.0;								 
+							 }
+						 });
+		
+		nlm_[iproj] = proj.nproj_;
+		locally_empty_[iproj] = proj.locally_empty();
+	}
 	
 public:
 
@@ -94,22 +101,89 @@ public:
 	}
 
 	////////////////////////////////////////////////////////////////////////////////////////////		
+
+	// makes the padded arrays large enough for spheres of new_size points, keeping their contents
+	void grow_spheres(long const new_size){
+		CALI_CXX_MARK_FUNCTION;
+
+		assert(new_size > max_sphere_size_);
+		
+		auto new_points = decltype(points_)({nprojs_, new_size}, vector3<int>{-1, -1, -1});
+		auto new_positions = decltype(positions_)({nprojs_, new_size}, vector3<float, contravariant>{0.0, 0.0, 0.0});
+		auto new_matrices = decltype(matrices_)({nprojs_, max_nlm_, new_size}, 0.0);
+
+		gpu::run(max_sphere_size_, max_nlm_, nprojs_,
+						 [poi = begin(points_), pos = begin(positions_), mat = begin(matrices_), npoi = begin(new_points), npos = begin(new_positions), nmat = begin(new_matrices)]
+						 GPU_LAMBDA (auto ipoint, auto ilm, auto iproj){
+							 nmat[iproj][ilm][ipoint] = mat[iproj][ilm][ipoint];
+							 if(ilm != 0) return;
+							 npoi[iproj][ipoint] = poi[iproj][ipoint];
+							 npos[iproj][ipoint] = pos[iproj][ipoint];
+						 });
+
+		points_ = std::move(new_points);
+		positions_ = std::move(new_positions);
+		matrices_ = std::move(new_matrices);
+		max_sphere_size_ = new_size;
+	}
 	
-	template <typename KpointType>
-	gpu::array<complex, 3> project(states::orbital_set<basis::real_space, complex> const & phi, KpointType const & kpoint) const {
-    
-		gpu::array<complex, 3> sphere_phi_all({nprojs_, max_sphere_size_, phi.local_set_size()});
-		gpu::array<complex, 3> projections_all({nprojs_, max_nlm_, phi.local_set_size()}, 0.0);
+	// Replaces projector iproj by proj (of the same atom, after it moved) in the existing
+	// storage, that only grows if the new sphere has more points than all the previous ones.
+	// The KB coefficients are copied too, so the species can change as long as the number of
+	// projectors is the same. It returns false, without changing anything, otherwise.
+	template <typename ProjectorType>
+	bool replace(int const iproj, ProjectorType const & proj){
+		CALI_CXX_MARK_FUNCTION;
+
+		assert(iproj >= 0 and iproj < nprojs_);
+		assert(proj.iatom_ == iatom_[iproj]);
+		
+		if(proj.nproj_ != nlm_[iproj]) return false;
+		if(proj.sphere_.size() > max_sphere_size_) grow_spheres(proj.sphere_.size());
+		copy_projector(iproj, proj);
+		return true;
+	}
+
+	auto num_projectors() const {
+		return nprojs_;
+	}
+
+	auto iatom(int const iproj) const {
+		return iatom_[iproj];
+	}
+	
+	////////////////////////////////////////////////////////////////////////////////////////////
+
+	// real orbitals are only used at the Gamma point, so there is no phase
+	template <typename Type>
+	GPU_FUNCTION static auto phase_factor(double angle) {
+		if constexpr(std::is_same_v<Type, double>) {
+			return 1.0;
+		} else {
+			return polar(1.0, angle);
+		}
+	}
+	
+	////////////////////////////////////////////////////////////////////////////////////////////		
+	
+	template <typename Type, typename KpointType>
+	void calculate_projections(states::orbital_set<basis::real_space, Type> const & phi, KpointType const & kpoint, gpu::array<Type, 3> & sphere_phi_all, gpu::array<Type, 3> & projections_all) const {
 
+		// the number of doubles per element
+		constexpr int nreal = sizeof(Type)/sizeof(double);
+
+		assert(sphere_phi_all.num_elements() == long(nprojs_)*max_sphere_size_*phi.local_set_size());
+		assert(projections_all.num_elements() == long(nprojs_)*max_nlm_*phi.local_set_size());
+		
 		{ CALI_CXX_MARK_SCOPE("projector::gather");
 				
 			gpu::run(phi.local_set_size(), max_sphere_size_, nprojs_,
 							 [sgr = begin(sphere_phi_all), gr = begin(phi.hypercubic()), poi = begin(points_), pos = begin(positions_), kpoint] GPU_LAMBDA (auto ist, auto ipoint, auto iproj){
 								 if(poi[iproj][ipoint][0] >= 0){
-									 auto phase = polar(1.0, dot(kpoint, pos[iproj][ipoint]));
+									 auto phase = phase_factor<Type>(dot(kpoint, pos[iproj][ipoint]));
 									 sgr[iproj][ipoint][ist] = phase*gr[poi[iproj][ipoint][0]][poi[iproj][ipoint][1]][poi[iproj][ipoint][2]][ist];
 								 } else {
-									 sgr[iproj][ipoint][ist] = complex(0.0, 0.0);
+									 sgr[iproj][ipoint][ist] = Type(0.0);
 								 }
 							 });
 		}
@@ -121,7 +195,11 @@ public:
 			if(locally_empty_[iproj]) continue;
 			
 			namespace blas = boost::multi::blas;
-			blas::real_doubled(projections_all[iproj]) = blas::gemm(phi.basis().volume_element(), matrices_[iproj], blas::real_doubled(sphere_phi_all[iproj]));
+			if constexpr(std::is_same_v<Type, double>) {
+				projections_all[iproj] = blas::gemm(phi.basis().volume_element(), matrices_[iproj], sphere_phi_all[iproj]);
+			} else {
+				blas::real_doubled(projections_all[iproj]) = blas::gemm(phi.basis().volume_element(), matrices_[iproj], blas::real_doubled(sphere_phi_all[iproj]));
+			}
 		}
 #else
 		if(max_sphere_size_ > 0) {
@@ -133,20 +211,20 @@ public:
 			auto status = cublasDgemmStridedBatched(/*cublasHandle_t handle = */ boost::multi::cuda::cublas::context::get_instance().get(),
 																							/*cublasOperation_t transa = */ CUBLAS_OP_N,
 																							/*cublasOperation_t transb = */ CUBLAS_OP_N,
-																							/*int m = */ 2*phi.local_set_size(),
+																							/*int m = */ nreal*phi.local_set_size(),
 																							/*int n = */ max_nlm_,
 																							/*int k = */ max_sphere_size_,
 																							/*const double *alpha = */ &vol,
 																							/*const double *A = */ reinterpret_cast<double const *>(raw_pointer_cast(sphere_phi_all.data_elements())),
-																							/*int lda = */ 2*phi.local_set_size(),
-																							/*long long int strideA = */ 2*max_sphere_size_*phi.local_set_size(),
+																							/*int lda = */ nreal*phi.local_set_size(),
+																							/*long long int strideA = */ nreal*max_sphere_size_*phi.local_set_size(),
 																							/*const double *B = */ raw_pointer_cast(matrices_.data_elements()),
 																							/*int ldb = */ max_sphere_size_,
 																							/*long long int strideB =*/ max_nlm_*max_sphere_size_,
 																							/*const double *beta = */ &zero,
 																							/*double *C = */ reinterpret_cast<double *>(raw_pointer_cast(projections_all.data_elements())),
-																							/*int ldc = */ 2*phi.local_set_size(),
-																							/*long long int strideC = */ 2*max_nlm_*phi.local_set_size(),
+																							/*int ldc = */ nreal*phi.local_set_size(),
+																							/*long long int strideC = */ nreal*max_nlm_*phi.local_set_size(),
 																							/*int batchCount = */ nprojs_);
 			gpu::sync();
 			
@@ -176,7 +254,11 @@ public:
 			if(locally_empty_[iproj]) continue;
 			
 			namespace blas = boost::multi::blas;
-			blas::real_doubled(sphere_phi_all[iproj]) = blas::gemm(1., blas::T(matrices_[iproj]), blas::real_doubled(projections_all[iproj]));
+			if constexpr(std::is_same_v<Type, double>) {
+				sphere_phi_all[iproj] = blas::gemm(1., blas::T(matrices_[iproj]), projections_all[iproj]);
+			} else {
+				blas::real_doubled(sphere_phi_all[iproj]) = blas::gemm(1., blas::T(matrices_[iproj]), blas::real_doubled(projections_all[iproj]));
+			}
 		}
 #else
 		if(max_sphere_size_ > 0) {
@@ -188,20 +270,20 @@ public:
 			auto status = cublasDgemmStridedBatched(/*cublasHandle_t handle = */ boost::multi::cuda::cublas::context::get_instance().get(),
 																							/*cublasOperation_t transa = */ CUBLAS_OP_N,
 																							/*cublasOperation_t transb = */ CUBLAS_OP_T,
-																							/*int m = */ 2*phi.local_set_size(),
+																							/*int m = */ nreal*phi.local_set_size(),
 																							/*int n = */ max_sphere_size_,
 																							/*int k = */ max_nlm_,
 																							/*const double *alpha = */ &one,
 																							/*const double *A = */ reinterpret_cast<double const *>(raw_pointer_cast(projections_all.data_elements())),
-																							/*int lda = */ 2*phi.local_set_size(),
-																							/*long long int strideA = */ 2*max_nlm_*phi.local_set_size(),
+																							/*int lda = */ nreal*phi.local_set_size(),
+																							/*long long int strideA = */ nreal*max_nlm_*phi.local_set_size(),
 																							/*const double *B = */ raw_pointer_cast(matrices_.data_elements()),
 																							/*int ldb = */ max_sphere_size_,
 																							/*long long int strideB =*/ max_nlm_*max_sphere_size_,
 																							/*const double *beta = */ &zero,
 																							/*double *C = */ reinterpret_cast<double *>(raw_pointer_cast(sphere_phi_all.data_elements())),
-																							/*int ldc = */ 2*phi.local_set_size(),
-																							/*long long int strideC = */ 2*max_sphere_size_*phi.local_set_size(),
+																							/*int ldc = */ nreal*phi.local_set_size(),
+																							/*long long int strideC = */ nreal*max_sphere_size_*phi.local_set_size(),
 																							/*int batchCount = */ nprojs_);
 
 			gpu::sync();
@@ -211,21 +293,45 @@ public:
 		}
 #endif
 
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////		
+	
+	template <typename Type, typename KpointType>
+	gpu::array<Type, 3> project(states::orbital_set<basis::real_space, Type> const & phi, KpointType const & kpoint) const {
+		gpu::array<Type, 3> sphere_phi_all({nprojs_, max_sphere_size_, phi.local_set_size()});
+		gpu::array<Type, 3> projections_all({nprojs_, max_nlm_, phi.local_set_size()}, 0.0);
+		calculate_projections(phi, kpoint, sphere_phi_all, projections_all);
+		return sphere_phi_all;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////		
+
+	// the same as above, but the buffers are taken from the workspace. The returned array is valid until the next call.
+	template <typename Type, typename KpointType>
+	gpu::array<Type, 3> & project(states::orbital_set<basis::real_space, Type> const & phi, KpointType const & kpoint, utils::workspace & work) const {
+		auto & sphere_phi_all = work.array<gpu::array<Type, 3>>("projector_all::sphere_phi_all", {nprojs_, max_sphere_size_, phi.local_set_size()});
+		auto & projections_all = work.array<gpu::array<Type, 3>>("projector_all::projections_all", {nprojs_, max_nlm_, phi.local_set_size()});
+
+		gpu::run(projections_all.num_elements(), [proj = raw_pointer_cast(projections_all.data_elements())] GPU_LAMBDA (auto ii){
+			proj[ii] = Type(0.0);
+		});
+		
+		calculate_projections(phi, kpoint, sphere_phi_all, projections_all);
 		return sphere_phi_all;
-			
 	}
 
 	////////////////////////////////////////////////////////////////////////////////////////////		
 
-	template <typename SpherePhiType, typename KpointType>
-	void apply(SpherePhiType & sphere_vnlphi, states::orbital_set<basis::real_space, complex> & vnlphi, KpointType const & kpoint) const {
+	template <typename SpherePhiType, typename Type, typename KpointType>
+	void apply(SpherePhiType & sphere_vnlphi, states::orbital_set<basis::real_space, Type> & vnlphi, KpointType const & kpoint) const {
 
 		CALI_CXX_MARK_SCOPE("projector_all::apply");
 
 		gpu::run(vnlphi.local_set_size(), max_sphere_size_, nprojs_,
 						 [sgr = begin(sphere_vnlphi), gr = begin(vnlphi.hypercubic()), poi = begin(points_), pos = begin(positions_), kpoint, empty = begin(locally_empty_)] GPU_LAMBDA (auto ist, auto ipoint, auto iproj){
 							 if(not empty[iproj] and poi[iproj][ipoint][0] >= 0){
-								 auto phase = polar(1.0, -dot(kpoint, pos[iproj][ipoint]));
+								 auto phase = phase_factor<Type>(-dot(kpoint, pos[iproj][ipoint]));
 								 gpu::atomic::add(&gr[poi[iproj][ipoint][0]][poi[iproj][ipoint][1]][poi[iproj][ipoint][2]][ist], phase*sgr[iproj][ipoint][ist]);
 							 }
 						 });
@@ -429,13 +535,77 @@ private:
 #ifdef INQ_HAMILTONIAN_PROJECTOR_ALL_UNIT_TEST
 #undef INQ_HAMILTONIAN_PROJECTOR_ALL_UNIT_TEST
 
+#include <config/path.hpp>
+#include <hamiltonian/projector.hpp>
+#include <operations/randomize.hpp>
+
 #include <catch2/catch_all.hpp>
 
+#include <list>
+
 TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 
 	using namespace inq;
 	using namespace inq::magnitude;
 	using namespace Catch::literals;
+	using Catch::Approx;
+
+	pseudo::math::erf_range_separation const sep(0.625);
+
+	parallel::communicator comm{boost::mpi3::environment::get_self_instance()};
+	parallel::cartesian_communicator<2> cart_comm(comm, {});
+
+	basis::real_space rs(systems::cell::cubic(10.0_b), /*spacing = */ 0.49672941, comm);
+	basis::double_grid dg(false);
+	
+	hamiltonian::atomic_potential::pseudopotential_type ps(config::path::unit_tests_data() + "N.upf", sep, rs.gcutoff());
+
+	auto build = [&](vector3<double> const & pos1){
+		std::list<hamiltonian::projector> projectors;
+		projectors.emplace_back(rs, dg, ps, vector3<double>(0.0, 0.0, 0.0), 0);
+		projectors.emplace_back(rs, dg, ps, pos1, 1);
+		return hamiltonian::projector_all(projectors);
+	};
+
+	auto projs = build({2.0, 0.0, 0.0});
+
+	CHECK(projs.num_projectors() == 2);
+	CHECK(projs.iatom(1) == 1);
+
+	// moving the second atom in place gives the same projectors as building them again
+	CHECK(projs.replace(1, hamiltonian::projector(rs, dg, ps, vector3<double>(2.1, 0.05, 0.0), 1)));
+	
+	auto moved = build({2.1, 0.05, 0.0});
+	
+	states::orbital_set<basis::real_space, double> phi(rs, 3, 1, vector3<double, covariant>{0.0, 0.0, 0.0}, 0, cart_comm);
+	operations::randomize(phi);
+	
+	auto proj1 = projs.project(phi, phi.kpoint());
+	auto proj2 = moved.project(phi, phi.kpoint());
+
+	for(int iproj = 0; iproj < 2; iproj++){
+		for(int ilm = 0; ilm < 8; ilm++){
+			for(int ist = 0; ist < 3; ist++) CHECK(proj1[iproj][ilm][ist] == Approx(proj2[iproj][ilm][ist]));
+		}
+	}
+
+	// another species can take the place of the atom if it has the same number of projectors, its KB coefficients are used
+	hamiltonian::atomic_potential::pseudopotential_type ps_f(config::path::unit_tests_data() + "F.UPF", sep, rs.gcutoff());
+	hamiltonian::projector proj_f(rs, dg, ps_f, vector3<double>(2.1, 0.05, 0.0), 1);
+	
+	if(projs.replace(1, proj_f)) {
+		std::list<hamiltonian::projector> projectors;
+		projectors.emplace_back(rs, dg, ps, vector3<double>(0.0, 0.0, 0.0), 0);
+		projectors.emplace_back(rs, dg, ps_f, vector3<double>(2.1, 0.05, 0.0), 1);
+		auto rebuilt = hamiltonian::projector_all(projectors);
+		
+		auto proj3 = projs.project(phi, phi.kpoint());
+		auto proj4 = rebuilt.project(phi, phi.kpoint());
+		
+		for(int ilm = 0; ilm < 8; ilm++){
+			for(int ist = 0; ist < 3; ist++) CHECK(proj3[1][ilm][ist] == Approx(proj4[1][ilm][ist]));
+		}
+	}
 	
 }
 #endif
@@ -20,8 +20,8 @@
 namespace inq {
 namespace hamiltonian {
 
-template <class PotentialType, class ShiftType>
-void scalar_potential_add(basis::field_set<basis::real_space, PotentialType> const & potential, int const index, ShiftType shift, states::orbital_set<basis::real_space, complex> const & phi, states::orbital_set<basis::real_space, complex> & vphi) {
+template <class PotentialType, class ShiftType, class Type>
+void scalar_potential_add(basis::field_set<basis::real_space, PotentialType> const & potential, int const index, ShiftType shift, states::orbital_set<basis::real_space, Type> const & phi, states::orbital_set<basis::real_space, Type> & vphi) {
 	CALI_CXX_MARK_FUNCTION;
   
   assert(potential.basis() == phi.basis());
@@ -32,7 +32,7 @@ void scalar_potential_add(basis::field_set<basis::real_space, PotentialType> con
 						 [pot = begin(potential.matrix()), vph = begin(vphi.matrix()), ph = begin(phi.matrix()), shift, index] GPU_LAMBDA (auto ist, auto ip){
 							 vph[ip][ist] += (pot[ip][index] + shift)*ph[ip][ist];
 						 });
-	} else {
+	} else if constexpr(not std::is_same_v<Type, double>) {
 
 		assert(potential.local_set_size() == 4);
 		
@@ -42,17 +42,17 @@ void scalar_potential_add(basis::field_set<basis::real_space, PotentialType> con
 							 vph[ip][0][ist] += (pot[ip][0] + shift)*ph[ip][0][ist] + offdiag*ph[ip][1][ist];
 							 vph[ip][1][ist] += (pot[ip][1] + shift)*ph[ip][1][ist] + conj(offdiag)*ph[ip][0][ist];
 						 });
+	} else {
+		assert(false and "real orbitals cannot be spinors");
 	}
 	
 }
 
 template <class PotentialType, class ShiftType>
-states::orbital_set<basis::real_space, complex> scalar_potential(basis::field_set<basis::real_space, PotentialType> const & potential, int const index, ShiftType shift, states::orbital_set<basis::real_space, complex> const & phi) {
+void scalar_potential(basis::field_set<basis::real_space, PotentialType> const & potential, int const index, ShiftType shift, states::orbital_set<basis::real_space, complex> const & phi, states::orbital_set<basis::real_space, complex> & vphi) {
 
 	CALI_CXX_MARK_FUNCTION;
 
-  states::orbital_set<basis::real_space, complex> vphi(phi.skeleton());
-  
   assert(potential.basis() == phi.basis());
 
 	if(not phi.spinors()){
@@ -74,8 +74,13 @@ states::orbital_set<basis::real_space, complex> scalar_potential(basis::field_se
 
 	}
 		
+}
+
+template <class PotentialType, class ShiftType>
+states::orbital_set<basis::real_space, complex> scalar_potential(basis::field_set<basis::real_space, PotentialType> const & potential, int const index, ShiftType shift, states::orbital_set<basis::real_space, complex> const & phi) {
+  states::orbital_set<basis::real_space, complex> vphi(phi.skeleton());
+	scalar_potential(potential, index, shift, phi, vphi);
   return vphi;
-  
 }
 
 }
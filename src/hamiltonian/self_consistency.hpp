@@ -28,6 +28,7 @@ template <typename Perturbation = perturbations::none>
 class self_consistency {
 	
 	options::theory theory_;
+	solvers::poisson poisson_solver_;
 	hamiltonian::xc_term xc_;
 	basis::field<basis::real_space, double> vion_;
 	basis::field<basis::real_space, double> core_density_;
@@ -41,6 +42,7 @@ public:
 	
 	self_consistency(options::theory interaction, basis::real_space const & potential_basis, basis::real_space const & density_basis, int const spin_components, Perturbation const & pert = {}):
 		theory_(interaction),
+		poisson_solver_(interaction.isolated_poisson_solver()),
 		xc_(interaction, spin_components),
 		vion_(density_basis),
 		core_density_(density_basis),
@@ -56,6 +58,7 @@ public:
 	
 	self_consistency(self_consistency && old, parallel::communicator new_comm):
 		theory_(std::move(old.theory_)),
+		poisson_solver_(theory_.isolated_poisson_solver()),
 		xc_(std::move(old.xc_)),
 		vion_(std::move(old.vion_), new_comm),
 		core_density_(std::move(old.core_density_), new_comm),
@@ -74,9 +77,7 @@ public:
 		
 		CALI_CXX_MARK_FUNCTION;
 		
-		solvers::poisson poisson_solver;
-		
-		auto ionic_long_range = poisson_solver(atomic_pot.ionic_density(comm, density_basis_, ions));
+		auto ionic_long_range = poisson_solver_(atomic_pot.ionic_density(comm, density_basis_, ions));
 		auto ionic_short_range = atomic_pot.local_potential(comm, density_basis_, ions);
 		vion_ = operations::add(ionic_long_range, ionic_short_range);
 		
@@ -94,33 +95,22 @@ public:
 		assert(core_density_.basis() == spin_density.basis());
 
 		auto total_density = observables::density::total(spin_density);
-			
-		energy.external(operations::integral_product(total_density, vion_));
-
-		solvers::poisson poisson_solver;
 
 		//IONIC POTENTIAL
 		auto vscalar = vion_;
 
 		//Time-dependent perturbation
-		if(pert_.has_uniform_electric_field()){
-			auto efield = pert_.uniform_electric_field(time);
-
-			gpu::run(vscalar.basis().local_sizes()[2], vscalar.basis().local_sizes()[1], vscalar.basis().local_sizes()[0],
-								 [point_op = vscalar.basis().point_op(), efield, vk = begin(vscalar.cubic())] GPU_LAMBDA (auto iz, auto iy, auto ix){
-									 auto rr = point_op.rvector_cartesian(ix, iy, iz);
-									 vk[ix][iy][iz] += -dot(efield, rr);
-								 });
-		}
-
 		pert_.potential(time, vscalar);
 		
 		// Hartree
 		if(theory_.hartree_potential()){
-			auto vhartree = poisson_solver(total_density);
-			energy.hartree(0.5*operations::integral_product(total_density, vhartree));
+			auto vhartree = poisson_solver_(total_density);
+			auto energies = operations::integral_product_bundle(total_density, vion_, vhartree);
+			energy.external(energies[0]);
+			energy.hartree(0.5*energies[1]);
 			operations::increment(vscalar, vhartree);
 		} else {
+			energy.external(operations::integral_product(total_density, vion_));
 			energy.hartree(0.0);
 		}
 
@@ -177,6 +167,12 @@ public:
 
 	////////////////////////////////////////////////////////////////////////////////////////////
 	
+	auto isolated_poisson_solver() const {
+		return theory_.isolated_poisson_solver();
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////
+	
 	auto exx_coefficient(){
 		if(xc_.exchange().true_functional()) return xc_.exchange().exx_coefficient();
 		return theory_.exchange_coefficient();
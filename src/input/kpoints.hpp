@@ -22,12 +22,15 @@ class grid {
 	
 	vector3<int> dims_;
 	bool shifted_;
+	bool use_symmetries_;
 	
 public:
-	
-  grid(vector3<int> const & dims, bool shifted = false):
+
+	// if use_symmetries is true only the irreducible points of the grid are used
+  grid(vector3<int> const & dims, bool shifted = false, bool use_symmetries = false):
     dims_(dims),
-		shifted_(shifted){
+		shifted_(shifted),
+		use_symmetries_(use_symmetries){
   }
 	
   auto & dims() const {
@@ -43,6 +46,10 @@ public:
 		return {0, 0, 0};
 	}
 
+	auto & use_symmetries() const {
+		return use_symmetries_;
+	}
+
 };
 
 class list {
@@ -145,6 +152,16 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
     CHECK(kpts.is_shifted()[2] == 1);
 	}
 
+	SECTION("Grid - symmetries"){
+		CHECK(not input::kpoints::grid({4, 4, 4}).use_symmetries());
+		
+		auto kpts = input::kpoints::grid({4, 4, 4}, false, true);
+
+    CHECK(kpts.size() == 64);
+    CHECK(kpts.is_shifted()[0] == 0);
+		CHECK(kpts.use_symmetries());
+	}
+
 	SECTION("List"){
 		auto kpts = input::kpoints::list();
 
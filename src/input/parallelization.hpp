@@ -48,6 +48,7 @@ namespace input {
 			nproc_kpts_(boost::mpi3::fill),
 			nproc_states_(1),
 			nproc_domains_(boost::mpi3::fill),
+			pencil_nproc_(1),
       comm_(comm)			
 		{
     }
@@ -87,6 +88,18 @@ namespace input {
 			return ret;
 		}
 
+		// Distributes the domains in two dimensions (the pencil
+		// decomposition), over a (domains/num) x num grid of processes
+		auto pencil(int num){
+			auto ret = *this;
+			ret.pencil_nproc_ = num;
+			return ret;
+		}
+
+		auto pencil_nproc() const {
+			return pencil_nproc_;
+		}
+		
 		auto kpoints(int num = boost::mpi3::fill){
 			auto ret = *this;
 			ret.nproc_kpts_ = num;
@@ -102,6 +115,7 @@ namespace input {
 		int nproc_kpts_;
 		int nproc_states_;
 		int nproc_domains_;
+		int pencil_nproc_;
     mutable parallel::communicator comm_;
 		constexpr static double const efficiency_threshold = 0.1;
   };
@@ -130,6 +144,9 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 	CHECK(par.comm() == comm);
 	CHECK(cart_comm.size() == comm.size());
 
+	CHECK(par.pencil_nproc() == 1);
+	CHECK(par.pencil(2).pencil_nproc() == 2);
+
 	SECTION("optimize parallelization"){
 		CHECK(input::parallelization::optimal_nprocs(16, 4, 0.05) == 4);
 		CHECK(input::parallelization::optimal_nprocs(15, 8, 0.1) == 8);
@@ -34,8 +34,13 @@ The 'kpoints' command
 This command defines the kpoints to be used in the simulation. Kpoints
 have to be given after the ions are defined.
 
-Note that right now inq doesn't use symmetries to reduce the kpoint
-grid.
+By default the full kpoint grid is used. The 'symmetric-grid'
+variant reduces it to the irreducible points using the symmetries of
+the ions, in that case the density and the forces are symmetrized.
+This cannot be used with exact exchange, spin polarization, spinors,
+real-time propagation or Born-Oppenheimer dynamics. The
+symmetrization keeps a copy of the full density grid in each
+process, so it is meant for small cells.
 
 These are the options available:
 
@@ -78,6 +83,17 @@ These are the options available:
    Python example: `pinq.kpoints.shifted_grid(4, 4, 4)`
 
 
+-  Shell:  `kpoints symmetric-grid <nx> <ny> <nz>`
+   Python: `kpoints.symmetric_grid(nx, ny, nz)`
+
+   Like `grid`, but only the points in the irreducible wedge of the
+   Brillouin zone are kept, with weights given by the number of
+   equivalent points. The ions must be defined before this command.
+
+   Shell example:  `inq kpoints symmetric-grid 8 8 8`
+   Python example: `pinq.kpoints.symmetric_grid(8, 8, 8)`
+
+
 -  Shell:  `kpoints insert <kx> <ky> <kz> <w>`
    Python: `kpoints.insert(kx, ky, kz, w)`
 
@@ -125,6 +141,11 @@ These are the options available:
 		bz.save(input::environment::global().comm(), ".inq/default_brillouin");
 	}
 
+  static void symmetric_grid(int nx, int ny, int nz) {
+		auto bz = ionic::brillouin(systems::ions::load(".inq/default_ions"), input::kpoints::grid({nx, ny, nz}, false, true));
+		bz.save(input::environment::global().comm(), ".inq/default_brillouin");
+	}
+
   static void insert(double const & kx, double const & ky, double const & kz, double const & weight) {
     auto bz = ionic::brillouin{};
     try { bz = ionic::brillouin::load(".inq/default_brillouin"); }
@@ -168,6 +189,13 @@ These are the options available:
 			actions::normal_exit();
 		}
     
+    if(args.size() == 4 and args[0] == "symmetric-grid") {
+      
+      symmetric_grid(str_to<int>(args[1]), str_to<int>(args[2]), str_to<int>(args[3]));
+      if(not quiet) operator()();
+			actions::normal_exit();
+		}
+    
     if(args.size() == 5 and args[0] == "insert") {
       
       insert(str_to<double>(args[1]), str_to<double>(args[2]), str_to<double>(args[3]), str_to<double>(args[4]));
@@ -195,6 +223,7 @@ These are the options available:
 		sub.def("gamma",        &gamma);
 		sub.def("grid",         &grid, "nx"_a, "ny"_a, "nz"_a);
 		sub.def("shifted_grid", &shifted_grid, "nx"_a, "ny"_a, "nz"_a);
+		sub.def("symmetric_grid", &symmetric_grid, "nx"_a, "ny"_a, "nz"_a);
 		sub.def("insert",       &insert, "kx"_a, "ky"_a, "kz"_a, "weight"_a);
 		sub.def("clear",        &clear);
 		
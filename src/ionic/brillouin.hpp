@@ -10,6 +10,7 @@
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
 #include <input/kpoints.hpp>
+#include <ionic/symmetries.hpp>
 #include <systems/ions.hpp>
 
 namespace inq {
@@ -19,6 +20,7 @@ class brillouin {
 
 	std::vector<vector3<double, covariant>> kpoints_;
 	std::vector<double> weights_;	
+	ionic::symmetries symmetries_;
 
 	brillouin(int size):
 		kpoints_(size),
@@ -29,9 +31,7 @@ public:
 
 	brillouin() = default;
 	
-  brillouin(inq::systems::ions const & ions, input::kpoints::grid const & kpts):
-		kpoints_(kpts.size()),
-		weights_(kpts.size())
+  brillouin(inq::systems::ions const & ions, input::kpoints::grid const & kpts)
   {
 		auto num_atoms = std::max(1, ions.size());
 		
@@ -67,17 +67,37 @@ public:
 		auto grid_address = std::vector<int>(3*kpts.size());
     auto map = std::vector<int>(kpts.size());
 		
-		spg_get_ir_reciprocal_mesh(reinterpret_cast<int (*)[3]>(grid_address.data()), map.data(), (int const *) &kpts.dims(), (int const *) &is_shifted, 0,
-															 reinterpret_cast<double (*)[3]>(amat), reinterpret_cast<double (*)[3]>(positions.data()), types.data(), num_atoms, 1e-4);
+		if(not kpts.use_symmetries()) {
+			spg_get_ir_reciprocal_mesh(reinterpret_cast<int (*)[3]>(grid_address.data()), map.data(), (int const *) &kpts.dims(), (int const *) &is_shifted, 0,
+																 reinterpret_cast<double (*)[3]>(amat), reinterpret_cast<double (*)[3]>(positions.data()), types.data(), num_atoms, 1e-4);
+
+			// we keep all the points of the grid
+			for(int ik = 0; ik < kpts.size(); ik++) map[ik] = ik;
+			
+		} else {
+			// the reduction uses the same operations that are later used to symmetrize the density, time reversal is also included
+			symmetries_ = ionic::symmetries(ions);
+			auto rotations = symmetries_.point_group();
+			double qpoints[1][3] = {{0.0, 0.0, 0.0}};
+			
+			spg_get_stabilized_reciprocal_mesh(reinterpret_cast<int (*)[3]>(grid_address.data()), map.data(), (int const *) &kpts.dims(), (int const *) &is_shifted, 1,
+																				 rotations.size()/9, reinterpret_cast<int const (*)[3][3]>(rotations.data()), 1, qpoints);
+		}
+
+		// each irreducible point gets the weight of the points that are mapped to it
+		auto multiplicity = std::vector<int>(kpts.size(), 0);
+		for(int ik = 0; ik < kpts.size(); ik++) multiplicity[map[ik]]++;
 		
 		for(int ik = 0; ik < kpts.size(); ik++){
+			if(multiplicity[ik] == 0) continue;
+			
 			auto kpr = vector3<double, covariant>{
 				(grid_address[3*ik + 0] + 0.5*is_shifted[0])/kpts.dims()[0],
 				(grid_address[3*ik + 1] + 0.5*is_shifted[1])/kpts.dims()[1],
 				(grid_address[3*ik + 2] + 0.5*is_shifted[2])/kpts.dims()[2]};
 			kpr.transform([](auto xx){ return (xx >= 0.5) ? xx - 1.0 : xx; });
-			kpoints_[ik] = 2.0*M_PI*kpr;
-			weights_[ik] = 1.0/kpts.size();
+			kpoints_.emplace_back(2.0*M_PI*kpr);
+			weights_.emplace_back(double(multiplicity[ik])/kpts.size());
 		}
 		
   }
@@ -123,6 +143,11 @@ public:
     return weights_[ik];
   }
 
+	// the operations used to reduce the grid, only the identity if the full grid is used
+	auto & symmetries() const {
+		return symmetries_;
+	}
+
 	auto insert(vector3<double, covariant> kpt, double const & weight){
 		kpt.transform([](auto xx){ return (xx >= 0.5) ? xx - 1.0 : xx; });
 		kpoints_.emplace_back(2.0*M_PI*kpt);
@@ -147,6 +172,7 @@ public:
 		utils::save_value(comm, dirname + "/num_kpoints",   size(),    error_message);
 		utils::save_container(comm, dirname + "/kpoints",       kpoints_,  error_message);
 		utils::save_container(comm, dirname + "/weights",       weights_,  error_message);
+		symmetries_.save(comm, dirname + "/symmetries");
 	}
 	
 	static auto load(std::string const & dirname) {
@@ -159,6 +185,7 @@ public:
 
 		utils::load_array(dirname + "/kpoints", bz.kpoints_, error_message);
 		utils::load_array(dirname + "/weights", bz.weights_, error_message);
+		bz.symmetries_ = ionic::symmetries::load(dirname + "/symmetries");
 		
 		return bz;
 	}
@@ -362,5 +389,39 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		
 	}
 
+	SECTION("Diamond irreducible"){
+
+		auto a =  3.567095_A;
+
+		auto ions = systems::ions(systems::cell::lattice({0.0_b, a/2.0, a/2.0}, {a/2, 0.0_b, a/2.0}, {a/2.0, a/2.0, 0.0_b}));
+		
+		ions.insert_fractional("C", {0.0 , 0.0 , 0.0 });
+		ions.insert_fractional("C", {0.25, 0.25, 0.25});
+
+		auto full = ionic::brillouin(ions, input::kpoints::grid({4, 4, 4}));
+		CHECK(full.size() == 64);
+		CHECK(full.symmetries().size() == 1);
+		
+		auto bz = ionic::brillouin(ions, input::kpoints::grid({4, 4, 4}, false, true));
+
+		CHECK(bz.size() == 8);
+		CHECK(bz.symmetries().size() == 48);
+
+		CHECK(bz.kpoint(0)[0] == 0.0_a);
+		CHECK(bz.kpoint(0)[1] == 0.0_a);
+		CHECK(bz.kpoint(0)[2] == 0.0_a);
+		CHECK(bz.kpoint_weight(0) == Approx(1.0/64.0));
+		
+		auto totalw = 0.0;
+		for(int ik = 0; ik < bz.size(); ik++) totalw += bz.kpoint_weight(ik);
+		CHECK(totalw == 1.0_a);
+
+		bz.save(comm, "save_brillouin_irreducible");
+		auto read_bz = ionic::brillouin::load("save_brillouin_irreducible");
+		CHECK(read_bz.size() == 8);
+		CHECK(read_bz.symmetries().size() == 48);
+		CHECK(read_bz.kpoint_weight(0) == Approx(1.0/64.0));
+	}
+
 }
 #endif
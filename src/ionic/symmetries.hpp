@@ -0,0 +1,266 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef INQ__IONIC__SYMMETRIES
+#define INQ__IONIC__SYMMETRIES
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <gpu/array.hpp>
+#include <math/vector3.hpp>
+#include <systems/ions.hpp>
+#include <utils/load_save.hpp>
+
+#include <spglib.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace inq {
+namespace ionic {
+
+// The space group operations of the ions, as given by spglib. Each
+// operation maps the fractional (contravariant) coordinates x to
+// R x + t, where R is an integer matrix and t a fractional
+// translation. A default constructed object only contains the
+// identity.
+
+class symmetries {
+
+	gpu::array<int, 3> rotations_;
+	gpu::array<double, 2> translations_;
+
+	void set_identity() {
+		rotations_ = gpu::array<int, 3>({1, 3, 3}, 0);
+		translations_ = gpu::array<double, 2>({1, 3}, 0.0);
+		for(int ii = 0; ii < 3; ii++) rotations_[0][ii][ii] = 1;
+	}
+
+public:
+
+	symmetries() {
+		set_identity();
+	}
+
+	symmetries(systems::ions const & ions, double const symprec = 1e-4) {
+
+		auto num_atoms = std::max(1, ions.size());
+
+		std::vector<int> types(num_atoms);
+		std::vector<double> positions(3*num_atoms);
+
+		//add a dummy atom, since spg doesn't work without atoms
+		types[0] = 0;
+		positions[0] = 0.0;
+		positions[1] = 0.0;
+		positions[2] = 0.0;
+
+		for(int iatom = 0; iatom < ions.size(); iatom++){
+			types[iatom] = ions.species(iatom).atomic_number();
+			auto pos = ions.cell().metric().to_contravariant(ions.cell().position_in_cell(ions.positions()[iatom]));
+			positions[3*iatom + 0] = pos[0];
+			positions[3*iatom + 1] = pos[1];
+			positions[3*iatom + 2] = pos[2];
+		}
+
+		// spglib takes the lattice vectors as columns
+		double amat[3][3];
+		for(int ii = 0; ii < 3; ii++){
+			for(int jj = 0; jj < 3; jj++) amat[ii][jj] = ions.cell().lattice(jj)[ii];
+		}
+
+		// 48 point group operations times the pure translations of a supercell
+		auto max_size = 48*num_atoms;
+		auto rot = std::vector<int>(9*max_size);
+		auto trans = std::vector<double>(3*max_size);
+
+		auto num_ops = spg_get_symmetry(reinterpret_cast<int (*)[3][3]>(rot.data()), reinterpret_cast<double (*)[3]>(trans.data()), max_size,
+																		amat, reinterpret_cast<double (*)[3]>(positions.data()), types.data(), num_atoms, symprec);
+
+		if(num_ops == 0) {
+			set_identity();
+			return;
+		}
+
+		rotations_ = gpu::array<int, 3>({num_ops, 3, 3});
+		translations_ = gpu::array<double, 2>({num_ops, 3});
+
+		for(int iop = 0; iop < num_ops; iop++){
+			for(int ii = 0; ii < 3; ii++){
+				for(int jj = 0; jj < 3; jj++) rotations_[iop][ii][jj] = rot[9*iop + 3*ii + jj];
+				translations_[iop][ii] = trans[3*iop + ii];
+			}
+		}
+	}
+
+	auto size() const {
+		return long(rotations_.size());
+	}
+
+	auto & rotations() const {
+		return rotations_;
+	}
+
+	auto & translations() const {
+		return translations_;
+	}
+
+	template <typename Type>
+	auto rotate(int iop, vector3<Type, contravariant> const & vv) const {
+		vector3<Type, contravariant> res{0.0, 0.0, 0.0};
+		for(int ii = 0; ii < 3; ii++){
+			for(int jj = 0; jj < 3; jj++) res[ii] += rotations_[iop][ii][jj]*vv[jj];
+		}
+		return res;
+	}
+
+	auto translation(int iop) const {
+		return vector3<double, contravariant>{translations_[iop][0], translations_[iop][1], translations_[iop][2]};
+	}
+
+	// the different rotations, flattened in the layout that spglib uses
+	auto point_group() const {
+		std::vector<std::array<int, 9>> unique;
+		for(int iop = 0; iop < size(); iop++){
+			std::array<int, 9> rr;
+			for(int ii = 0; ii < 9; ii++) rr[ii] = rotations_[iop][ii/3][ii%3];
+			if(std::find(unique.begin(), unique.end(), rr) == unique.end()) unique.push_back(rr);
+		}
+
+		std::vector<int> flat;
+		for(auto const & rr : unique) flat.insert(flat.end(), rr.begin(), rr.end());
+		return flat;
+	}
+
+	// averages the force of each atom with the rotated forces of its images
+	template <typename ForcesType>
+	auto symmetrize_forces(systems::ions const & ions, ForcesType const & forces) const {
+
+		CALI_CXX_MARK_FUNCTION;
+
+		if(size() == 1) return forces;
+
+		auto metric = ions.cell().metric();
+		auto sym_forces = ForcesType(forces.size(), {0.0, 0.0, 0.0});
+
+		for(int iatom = 0; iatom < ions.size(); iatom++){
+			auto pos = metric.to_contravariant(ions.cell().position_in_cell(ions.positions()[iatom]));
+			auto force = metric.to_contravariant(forces[iatom]);
+
+			for(int iop = 0; iop < size(); iop++){
+				auto image = rotate(iop, pos) + translation(iop);
+
+				for(int jatom = 0; jatom < ions.size(); jatom++){
+					if(ions.species(jatom).atomic_number() != ions.species(iatom).atomic_number()) continue;
+
+					auto diff = image - metric.to_contravariant(ions.cell().position_in_cell(ions.positions()[jatom]));
+					diff.transform([](auto xx){ return xx - std::round(xx); });
+					if(metric.length(diff) > 1e-4) continue;
+
+					sym_forces[jatom] += metric.to_cartesian(rotate(iop, force))/double(size());
+					break;
+				}
+			}
+		}
+
+		return sym_forces;
+	}
+
+	void save(parallel::communicator & comm, std::string const & dirname) const {
+		auto error_message = "INQ error: Cannot save the symmetries to directory '" + dirname + "'.";
+
+		utils::create_directory(comm, dirname);
+		utils::save_container(comm, dirname + "/rotations",    std::vector<int>(rotations_.data_elements(), rotations_.data_elements() + rotations_.num_elements()),       error_message);
+		utils::save_container(comm, dirname + "/translations", std::vector<double>(translations_.data_elements(), translations_.data_elements() + translations_.num_elements()), error_message);
+	}
+
+	static auto load(std::string const & dirname) {
+		auto symm = symmetries{};
+
+		std::vector<int> rot;
+		std::vector<double> trans;
+		utils::load_vector(dirname + "/rotations", rot);
+		utils::load_vector(dirname + "/translations", trans);
+
+		// nothing saved means no symmetries
+		if(rot.size() == 0) return symm;
+
+		auto num_ops = long(rot.size()/9);
+		assert(long(trans.size()) == 3*num_ops);
+
+		symm.rotations_ = gpu::array<int, 3>({num_ops, 3, 3});
+		symm.translations_ = gpu::array<double, 2>({num_ops, 3});
+
+		for(int iop = 0; iop < num_ops; iop++){
+			for(int ii = 0; ii < 3; ii++){
+				for(int jj = 0; jj < 3; jj++) symm.rotations_[iop][ii][jj] = rot[9*iop + 3*ii + jj];
+				symm.translations_[iop][ii] = trans[3*iop + ii];
+			}
+		}
+
+		return symm;
+	}
+
+};
+
+}
+}
+#endif
+
+#ifdef INQ_IONIC_SYMMETRIES_UNIT_TEST
+#undef INQ_IONIC_SYMMETRIES_UNIT_TEST
+
+#include <catch2/catch_all.hpp>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+
+	using namespace inq;
+	using namespace inq::magnitude;
+	using Catch::Approx;
+	using namespace Catch::literals;
+
+	parallel::communicator comm{boost::mpi3::environment::get_world_instance()};
+
+	SECTION("Identity"){
+		auto symm = ionic::symmetries{};
+		CHECK(symm.size() == 1);
+		CHECK(symm.point_group().size() == 9);
+		CHECK(symm.rotate(0, vector3<double, contravariant>{0.1, 0.2, 0.3})[1] == 0.2_a);
+	}
+
+	SECTION("Diamond"){
+
+		auto a =  3.567095_A;
+
+		auto ions = systems::ions(systems::cell::lattice({0.0_b, a/2.0, a/2.0}, {a/2, 0.0_b, a/2.0}, {a/2.0, a/2.0, 0.0_b}));
+
+		ions.insert_fractional("C", {0.0 , 0.0 , 0.0 });
+		ions.insert_fractional("C", {0.25, 0.25, 0.25});
+
+		auto symm = ionic::symmetries(ions);
+
+		// Fd-3m
+		CHECK(symm.size() == 48);
+		CHECK(symm.point_group().size() == 9*48);
+
+		// the site symmetry of the atoms does not allow a net force, so any force is averaged to zero
+		auto forces = gpu::array<vector3<double>, 1>(2, {0.0, 0.0, 0.0});
+		forces[0] = {0.1, -0.3, 0.2};
+		auto sym_forces = symm.symmetrize_forces(ions, forces);
+		CHECK(fabs(sym_forces[0][0]) < 1e-12);
+		CHECK(fabs(sym_forces[0][1]) < 1e-12);
+		CHECK(fabs(sym_forces[1][2]) < 1e-12);
+
+		symm.save(comm, "save_symmetries_diamond");
+		auto read_symm = ionic::symmetries::load("save_symmetries_diamond");
+		CHECK(read_symm.size() == 48);
+		CHECK(read_symm.rotations()[7][1][2] == symm.rotations()[7][1][2]);
+		CHECK(read_symm.translations()[5][0] == Approx(symm.translations()[5][0]));
+	}
+
+}
+#endif
@@ -22,9 +22,11 @@ namespace inq {
 
 #ifdef ENABLE_GPU
 using complex = thrust::complex<double>;
+using complex_float = thrust::complex<float>;
 using thrust::polar;
 #else
 using complex = std::complex<double>;
+using complex_float = std::complex<float>;
 using std::polar;
 #endif
 
@@ -22,12 +22,18 @@
 #define zpotrf FC_GLOBAL(zpotrf, ZPOTRF) 
 extern "C" void zpotrf(const char * uplo, const int * n, inq::complex * a, const int * lda, int * info);
 
+#define dpotrf FC_GLOBAL(dpotrf, DPOTRF) 
+extern "C" void dpotrf(const char * uplo, const int * n, double * a, const int * lda, int * info);
+
 namespace inq {
 namespace matrix {
 
 template <class matrix_type>
 void cholesky_raw(matrix_type && matrix, bool nocheck = false){
   
+	using element_type = typename std::decay_t<matrix_type>::element_type;
+	constexpr auto is_real = std::is_same_v<element_type, double>;
+	
 	const int nst = matrix.size();
 	int info;
   
@@ -43,13 +49,17 @@ void cholesky_raw(matrix_type && matrix, bool nocheck = false){
 			
 		//query the work size
 		int lwork;
-		cusolver_status = cusolverDnZpotrf_bufferSize(cusolver_handle, CUBLAS_FILL_MODE_UPPER, nst, (cuDoubleComplex *) raw_pointer_cast(matrix.data_elements()), nst, &lwork);
+		if constexpr(is_real) {
+			cusolver_status = cusolverDnDpotrf_bufferSize(cusolver_handle, CUBLAS_FILL_MODE_UPPER, nst, raw_pointer_cast(matrix.data_elements()), nst, &lwork);
+		} else {
+			cusolver_status = cusolverDnZpotrf_bufferSize(cusolver_handle, CUBLAS_FILL_MODE_UPPER, nst, (cuDoubleComplex *) raw_pointer_cast(matrix.data_elements()), nst, &lwork);
+		}
 		assert(cusolver_status == CUSOLVER_STATUS_SUCCESS);
 		assert(lwork >= 0);
 			
 		//allocate the work array
-		cuDoubleComplex * work;
-		[[maybe_unused]] auto cuda_status = cudaMalloc((void**)&work, sizeof(cuDoubleComplex)*lwork);
+		element_type * work;
+		[[maybe_unused]] auto cuda_status = cudaMalloc((void**)&work, sizeof(element_type)*lwork);
 		assert(cudaSuccess == cuda_status);
 
 		//finaly do the decomposition
@@ -57,7 +67,11 @@ void cholesky_raw(matrix_type && matrix, bool nocheck = false){
 		cuda_status = cudaMallocManaged((void**)&devInfo, sizeof(int));
 		assert(cudaSuccess == cuda_status);
 
-		cusolver_status = cusolverDnZpotrf(cusolver_handle, CUBLAS_FILL_MODE_UPPER, nst, (cuDoubleComplex *) raw_pointer_cast(matrix.data_elements()), nst, work, lwork, devInfo);
+		if constexpr(is_real) {
+			cusolver_status = cusolverDnDpotrf(cusolver_handle, CUBLAS_FILL_MODE_UPPER, nst, raw_pointer_cast(matrix.data_elements()), nst, work, lwork, devInfo);
+		} else {
+			cusolver_status = cusolverDnZpotrf(cusolver_handle, CUBLAS_FILL_MODE_UPPER, nst, (cuDoubleComplex *) raw_pointer_cast(matrix.data_elements()), nst, (cuDoubleComplex *) work, lwork, devInfo);
+		}
 		assert(cusolver_status == CUSOLVER_STATUS_SUCCESS);
 		cudaDeviceSynchronize();
 		info = *devInfo ;
@@ -70,7 +84,11 @@ void cholesky_raw(matrix_type && matrix, bool nocheck = false){
 #else
 	{
 		CALI_CXX_MARK_SCOPE("cuda_zpotrf");
-		zpotrf("U", &nst, raw_pointer_cast(matrix.data_elements()), &nst, &info);
+		if constexpr(is_real) {
+			dpotrf("U", &nst, raw_pointer_cast(matrix.data_elements()), &nst, &info);
+		} else {
+			zpotrf("U", &nst, raw_pointer_cast(matrix.data_elements()), &nst, &info);
+		}
 	}
 #endif
 
@@ -146,5 +164,29 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		CHECK(real(array[1][1]) == 0.0824620974_a);    
   }
 
+  SECTION("Real 2x2"){
+    
+		using namespace inq;
+    using namespace Catch::literals;
+		
+		gpu::array<double, 2> array({2, 2});
+		
+		array[0][0] = 6432.12;
+		array[0][1] = 4502.48;
+		array[1][0] = 4502.48;
+		array[1][1] = 3151.74;
+
+		matrix::distributed matrix = matrix::scatter(cart_comm, array, /* root = */ 0);
+		
+		matrix::cholesky(matrix);
+
+    array = matrix::all_gather(matrix);
+	 
+		CHECK(array[0][0] == 80.2005_a);
+		CHECK(array[0][1] == 0.0_a);
+		CHECK(array[1][0] == 56.1402992511_a);
+		CHECK(array[1][1] == 0.0824620974_a);    
+  }
+
 }
 #endif
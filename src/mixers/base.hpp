@@ -23,6 +23,13 @@ public:
 	
 };
 
+// the default preconditioner for the residual, it does nothing
+struct no_preconditioner {
+	template <class ArrayType>
+	void operator()(ArrayType &) const {
+	}
+};
+
 }
 }
 #endif
@@ -22,29 +22,34 @@
 namespace inq {
 namespace mixers {
 
-template <class ArrayType>
+template <class ArrayType, class PreconditionerType = no_preconditioner>
 class broyden : public base<ArrayType> {
 	
 public:
 
 	using element_type = typename ArrayType::element_type;
+
+	// with a preconditioner P the initial guess for the inverse jacobian is mix_factor*P instead of mix_factor
+	static constexpr bool preconditioned = not std::is_same_v<PreconditionerType, no_preconditioner>;
 	
 	template <class CommType>
-	broyden(const int arg_steps, const double arg_mix_factor, const long long dim, CommType & comm):
+	broyden(const int arg_steps, const double arg_mix_factor, const long long dim, CommType & comm, PreconditionerType const & prec = {}):
 		iter_(0),
 		max_size_(arg_steps),
 		mix_factor_(arg_mix_factor),
 		dv_({max_size_, dim}, NAN),
 		df_({max_size_, dim}, NAN),
+		pdf_({preconditioned ? max_size_ : 0, preconditioned ? dim : 0}, NAN),
 		f_old_(dim, NAN),
 		vin_old_(dim, NAN),
 		last_pos_(-1),
-		comm_(comm){
+		comm_(comm),
+		prec_(prec){
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////////////////
 		
-	void broyden_extrapolation(ArrayType & input_value, int const iter_used, gpu::array<element_type, 1> const & ff){
+	void broyden_extrapolation(ArrayType & input_value, int const iter_used, gpu::array<element_type, 1> const & ff, gpu::array<element_type, 1> const & pff){
 
 		CALI_CXX_MARK_SCOPE("broyden_extrapolation");
 		
@@ -53,7 +58,7 @@ public:
 
 		if(iter_used == 0){
 			gpu::run(input_value.size(),
-							 [iv = begin(input_value), ffp = begin(ff),  mix = mix_factor_] GPU_LAMBDA (auto ip){
+							 [iv = begin(input_value), ffp = begin(pff),  mix = mix_factor_] GPU_LAMBDA (auto ip){
 								 iv[ip] += mix*ffp[ip];
 							 });
 
@@ -81,7 +86,7 @@ public:
 		solvers::least_squares(beta, work);
 		
 		gpu::run(input_value.size(), 
-						 [iv = begin(input_value),  ffp = begin(ff), ww, wo = begin(work), mix = mix_factor_, df = begin(df_), dv = begin(dv_), iter_used] GPU_LAMBDA (auto ip){
+						 [iv = begin(input_value),  ffp = begin(pff), ww, wo = begin(work), mix = mix_factor_, df = begin(preconditioned ? pdf_ : df_), dv = begin(dv_), iter_used] GPU_LAMBDA (auto ip){
 							 iv[ip] += mix*ffp[ip];							 
 							 for(int ii = 0; ii < iter_used; ii++){
 								 iv[ip] -= ww*ww*wo[ii]*(mix*df[ii][ip] + dv[ii][ip]);
@@ -139,6 +144,12 @@ public:
 								 dv[pos][ip] /= gamma;
 							 });
 
+			if constexpr(preconditioned) {
+				gpu::array<element_type, 1> pdf = df_[pos];
+				prec_(pdf);
+				pdf_[pos] = pdf;
+			}
+
 			last_pos_ = pos;
 				
 		}
@@ -148,7 +159,13 @@ public:
 
 		auto iter_used = std::min(iter_ - 1, max_size_);
 
-		broyden_extrapolation(input_value, iter_used, ff);
+		if constexpr(preconditioned) {
+			auto pff = ff;
+			prec_(pff);
+			broyden_extrapolation(input_value, iter_used, ff, pff);
+		} else {
+			broyden_extrapolation(input_value, iter_used, ff, ff);
+		}
 				
 	}
 
@@ -159,11 +176,13 @@ private:
 	double mix_factor_;
 	gpu::array<element_type, 2> dv_;
 	gpu::array<element_type, 2> df_;
+	gpu::array<element_type, 2> pdf_;
 	gpu::array<element_type, 1> f_old_;
 	gpu::array<element_type, 1> vin_old_;
 	element_type gamma_;
 	int last_pos_;
 	mutable parallel::communicator comm_;
+	PreconditionerType prec_;
 	
 };
 	
@@ -0,0 +1,186 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef INQ__MIXERS__KERKER
+#define INQ__MIXERS__KERKER
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <gpu/array.hpp>
+#include <basis/field_set.hpp>
+#include <basis/real_space.hpp>
+#include <operations/transform.hpp>
+
+#include <utils/profiling.hpp>
+
+namespace inq {
+namespace mixers {
+
+// The Kerker preconditioner for the density residual, G. P. Kerker,
+// Phys. Rev. B 23, 3082 (1981). The residual of the total density is
+// multiplied in Fourier space by G^2/(G^2 + q0^2), this damps the
+// long wavelength components that cause charge sloshing in metals
+// and large cells. The G = 0 component is removed, so the number of
+// electrons is not changed by the mixing. The magnetization is not
+// screened, so its residual is left as it is and it is mixed linearly
+// (or by the mixer alone), this includes the total magnetization.
+
+class kerker {
+
+	basis::real_space basis_;
+	int num_components_;
+	double screening_;
+	
+public:
+
+	kerker(basis::real_space const & basis, int const num_components, double const screening_wavevector):
+		basis_(basis),
+		num_components_(num_components),
+		screening_(screening_wavevector){
+	}
+
+	auto & screening_wavevector() const {
+		return screening_;
+	}
+	
+	template <class ArrayType>
+	void operator()(ArrayType & residual) const {
+
+		CALI_CXX_MARK_SCOPE("kerker_preconditioner");
+		
+		basis::field_set<basis::real_space, double> rfield(basis_, num_components_);
+
+		assert(residual.size() == rfield.matrix().num_elements());
+		
+		rfield.matrix().flatted() = residual;
+
+		auto ffield = operations::transform::to_fourier_r2c(rfield);
+
+		assert(ffield.local_set_size() == num_components_);
+		
+		// the first two components are the up and down densities, the rest is the non-collinear magnetization
+		gpu::run(ffield.basis().local_sizes()[2], ffield.basis().local_sizes()[1], ffield.basis().local_sizes()[0],
+						 [point_op = ffield.basis().point_op(), fcub = begin(ffield.hypercubic()), q02 = screening_*screening_, ncomp = num_components_] GPU_LAMBDA (auto iz, auto iy, auto ix){
+							 auto g2 = point_op.g2(ix, iy, iz);
+							 auto factor = g2/(g2 + q02);
+							 
+							 if(ncomp == 1) {
+								 fcub[ix][iy][iz][0] *= factor;
+								 return;
+							 }
+							 
+							 auto tot = factor*(fcub[ix][iy][iz][0] + fcub[ix][iy][iz][1]);
+							 auto mag = fcub[ix][iy][iz][0] - fcub[ix][iy][iz][1];
+							 fcub[ix][iy][iz][0] = 0.5*(tot + mag);
+							 fcub[ix][iy][iz][1] = 0.5*(tot - mag);
+						 });
+
+		rfield = operations::transform::to_real_c2r(ffield);
+
+		residual = rfield.matrix().flatted();
+	}
+	
+};
+
+}
+}
+#endif
+
+#ifdef INQ_MIXERS_KERKER_UNIT_TEST
+#undef INQ_MIXERS_KERKER_UNIT_TEST
+
+#include <operations/integral.hpp>
+
+#include <catch2/catch_all.hpp>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+
+	using namespace inq;
+	using namespace inq::magnitude;
+	using namespace Catch::literals;
+	using Catch::Approx;
+
+	parallel::communicator comm{boost::mpi3::environment::get_world_instance()};
+	
+	basis::real_space bas(systems::cell::cubic(10.0_b), /*spacing =*/ 0.49672941, comm);
+
+	basis::field_set<basis::real_space, double> res(bas, 2);
+
+	auto kk = 2.0*M_PI/10.0;
+	
+	for(int ix = 0; ix < bas.local_sizes()[0]; ix++){
+		for(int iy = 0; iy < bas.local_sizes()[1]; iy++){
+			for(int iz = 0; iz < bas.local_sizes()[2]; iz++){
+				auto rr = bas.point_op().rvector_cartesian(ix, iy, iz);
+				res.hypercubic()[ix][iy][iz][0] = 1.0 + cos(kk*rr[0]);
+				res.hypercubic()[ix][iy][iz][1] = cos(3.0*kk*rr[1]);
+			}
+		}
+	}
+
+	mixers::kerker prec(bas, 2, 0.8);
+
+	CHECK(prec.screening_wavevector() == 0.8_a);
+
+	gpu::array<double, 1> flat = res.matrix().flatted();
+	prec(flat);
+	
+	basis::field_set<basis::real_space, double> pres(bas, 2);
+	pres.matrix().flatted() = flat;
+
+	// in the total density the constant is removed and each plane wave is scaled by G^2/(G^2 + q0^2), the magnetization is not changed
+	auto fac1 = kk*kk/(kk*kk + 0.64);
+	auto fac3 = 9.0*kk*kk/(9.0*kk*kk + 0.64);
+	
+	double diff = 0.0;
+	for(int ix = 0; ix < bas.local_sizes()[0]; ix++){
+		for(int iy = 0; iy < bas.local_sizes()[1]; iy++){
+			for(int iz = 0; iz < bas.local_sizes()[2]; iz++){
+				auto rr = bas.point_op().rvector_cartesian(ix, iy, iz);
+				auto tot = fac1*cos(kk*rr[0]) + fac3*cos(3.0*kk*rr[1]);
+				auto mag = 1.0 + cos(kk*rr[0]) - cos(3.0*kk*rr[1]);
+				diff += fabs(pres.hypercubic()[ix][iy][iz][0] - 0.5*(tot + mag));
+				diff += fabs(pres.hypercubic()[ix][iy][iz][1] - 0.5*(tot - mag));
+			}
+		}
+	}
+
+	comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+	
+	CHECK(diff/bas.size() < 1e-10);
+
+	SECTION("Unpolarized"){
+		basis::field_set<basis::real_space, double> res1(bas, 1);
+		for(int ix = 0; ix < bas.local_sizes()[0]; ix++){
+			for(int iy = 0; iy < bas.local_sizes()[1]; iy++){
+				for(int iz = 0; iz < bas.local_sizes()[2]; iz++){
+					auto rr = bas.point_op().rvector_cartesian(ix, iy, iz);
+					res1.hypercubic()[ix][iy][iz][0] = 1.0 + cos(kk*rr[0]);
+				}
+			}
+		}
+
+		gpu::array<double, 1> flat1 = res1.matrix().flatted();
+		mixers::kerker(bas, 1, 0.8)(flat1);
+		res1.matrix().flatted() = flat1;
+
+		double diff1 = 0.0;
+		for(int ix = 0; ix < bas.local_sizes()[0]; ix++){
+			for(int iy = 0; iy < bas.local_sizes()[1]; iy++){
+				for(int iz = 0; iz < bas.local_sizes()[2]; iz++){
+					auto rr = bas.point_op().rvector_cartesian(ix, iy, iz);
+					diff1 += fabs(res1.hypercubic()[ix][iy][iz][0] - fac1*cos(kk*rr[0]));
+				}
+			}
+		}
+
+		comm.all_reduce_in_place_n(&diff1, 1, std::plus<>{});
+		
+		CHECK(diff1/bas.size() < 1e-10);
+	}
+	
+}
+#endif
@@ -17,19 +17,34 @@
 namespace inq {
 namespace mixers {
 
-template <class ArrayType>
+template <class ArrayType, class PreconditionerType = no_preconditioner>
 class linear : public base<ArrayType> {
 
 public:
 	
-	linear(double arg_mix_factor):
-		mix_factor_(arg_mix_factor){
+	linear(double arg_mix_factor, PreconditionerType const & prec = {}):
+		mix_factor_(arg_mix_factor),
+		prec_(prec){
 	}
 	
 	void operator()(ArrayType & input_value, ArrayType const & output_value){
 		//note: arguments might alias here
 		
 		CALI_CXX_MARK_SCOPE("linear_mixing");
+
+		if constexpr(not std::is_same_v<PreconditionerType, no_preconditioner>) {
+			gpu::array<typename ArrayType::element_type, 1> res(input_value.size());
+			gpu::run(input_value.size(),
+							 [iv = begin(input_value), ov = begin(output_value), re = begin(res)] GPU_LAMBDA (auto ii){
+								 re[ii] = ov[ii] - iv[ii];
+							 });
+			prec_(res);
+			gpu::run(input_value.size(),
+							 [iv = begin(input_value), re = begin(res), mix = mix_factor_] GPU_LAMBDA (auto ii){
+								 iv[ii] += mix*re[ii];
+							 });
+			return;
+		}
 		
 		gpu::run(input_value.size(),
 						 [iv = begin(input_value), ov = begin(output_value), mix = mix_factor_] GPU_LAMBDA (auto ii){
@@ -40,6 +55,7 @@ public:
 private:
 		
 	double mix_factor_;
+	PreconditionerType prec_;
 		
 };
 
@@ -0,0 +1,169 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef INQ__MIXERS__PULAY
+#define INQ__MIXERS__PULAY
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <math/complex.hpp>
+#include <gpu/array.hpp>
+#include <solvers/least_squares.hpp>
+#include <mixers/base.hpp>
+
+#include <parallel/communicator.hpp>
+#include <mpi3/environment.hpp>
+#include <utils/raw_pointer_cast.hpp>
+
+namespace inq {
+namespace mixers {
+
+// Pulay (DIIS) mixing, P. Pulay, Chem. Phys. Lett. 73, 393 (1980).
+// The new input is the combination of the previous inputs that
+// minimizes the norm of the combined residual, plus the (optionally
+// preconditioned) combined residual times the mixing factor.
+
+template <class ArrayType, class PreconditionerType = no_preconditioner>
+class pulay : public base<ArrayType> {
+
+public:
+
+	using element_type = typename ArrayType::element_type;
+
+	static_assert(std::is_same_v<element_type, double>, "pulay mixing is only implemented for double");
+
+	template <class CommType>
+	pulay(const int arg_steps, const double arg_mix_factor, const long long dim, CommType & comm, PreconditionerType const & prec = {}):
+		iter_(0),
+		max_size_(arg_steps),
+		mix_factor_(arg_mix_factor),
+		vin_({max_size_, dim}, NAN),
+		ff_({max_size_, dim}, NAN),
+		comm_(comm),
+		prec_(prec){
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+
+	void operator()(ArrayType & input_value, ArrayType const & output_value){
+
+		CALI_CXX_MARK_SCOPE("pulay_mixing");
+
+		assert((typename gpu::array<double, 2>::size_type) input_value.size() == vin_[0].size());
+		assert((typename gpu::array<double, 2>::size_type) output_value.size() == vin_[0].size());
+
+		auto pos = iter_%max_size_;
+		iter_++;
+
+		gpu::run(input_value.size(),
+						 [iv = begin(input_value), ov = begin(output_value), vin = begin(vin_), ff = begin(ff_), pos] GPU_LAMBDA (auto ip){
+							 vin[pos][ip] = iv[ip];
+							 ff[pos][ip] = ov[ip] - iv[ip];
+						 });
+
+		int const nhist = std::min(iter_, max_size_);
+
+		// the residual overlap matrix, bordered by the constraint that the coefficients add to one
+		namespace blas = boost::multi::blas;
+
+		auto subff = ff_({0, nhist}, {0, input_value.size()});
+		auto olap = +blas::gemm(1.0, subff, blas::H(subff));
+
+		if(comm_.size() > 1){
+			CALI_CXX_MARK_SCOPE("pulay_mixing::reduce");
+			comm_.all_reduce_n(raw_pointer_cast(olap.data_elements()), olap.num_elements());
+		}
+
+		gpu::array<double, 2> matrix({nhist + 1, nhist + 1});
+		gpu::array<double, 1> coeff(nhist + 1);
+
+		for(int ih = 0; ih < nhist; ih++){
+			for(int jh = 0; jh < nhist; jh++) matrix[ih][jh] = olap[ih][jh];
+			matrix[ih][nhist] = 1.0;
+			matrix[nhist][ih] = 1.0;
+			coeff[ih] = 0.0;
+		}
+		matrix[nhist][nhist] = 0.0;
+		coeff[nhist] = 1.0;
+
+		solvers::least_squares(matrix, coeff);
+
+		gpu::array<element_type, 1> res(input_value.size(), 0.0);
+
+		gpu::run(input_value.size(),
+						 [iv = begin(input_value), re = begin(res), vin = begin(vin_), ff = begin(ff_), co = begin(coeff), nhist] GPU_LAMBDA (auto ip){
+							 iv[ip] = 0.0;
+							 for(int ih = 0; ih < nhist; ih++){
+								 iv[ip] += co[ih]*vin[ih][ip];
+								 re[ip] += co[ih]*ff[ih][ip];
+							 }
+						 });
+
+		prec_(res);
+
+		gpu::run(input_value.size(),
+						 [iv = begin(input_value), re = begin(res), mix = mix_factor_] GPU_LAMBDA (auto ip){
+							 iv[ip] += mix*re[ip];
+						 });
+	}
+
+private:
+
+	int iter_;
+	int max_size_;
+	double mix_factor_;
+	gpu::array<element_type, 2> vin_;
+	gpu::array<element_type, 2> ff_;
+	mutable parallel::communicator comm_;
+	PreconditionerType prec_;
+
+};
+
+}
+}
+#endif
+
+#ifdef INQ_MIXERS_PULAY_UNIT_TEST
+#undef INQ_MIXERS_PULAY_UNIT_TEST
+
+#include <catch2/catch_all.hpp>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+
+	using namespace inq;
+	using namespace Catch::literals;
+	using Catch::Approx;
+
+	gpu::array<double, 1> vin({10.0, -20.0});
+	gpu::array<double, 1> vout({0.0,  22.2});
+
+  mixers::pulay<decltype(vin)> pm(5, 0.5, 2, boost::mpi3::environment::get_self_instance());
+
+	// the first step is linear mixing
+	pm(vin, vout);
+
+	CHECK(vin[0] == 5.0_a);
+  CHECK(vin[1] == 1.1_a);
+
+	// for a linear map the residual is linear in the input, so the fixed point is found once the history spans the space
+	auto func = [](auto const & vv){
+		return gpu::array<double, 1>({0.5*vv[0] + 1.0, 0.25*vv[1] - 1.0});
+	};
+
+	mixers::pulay<decltype(vin)> pm2(5, 0.5, 2, boost::mpi3::environment::get_self_instance());
+
+	vin = gpu::array<double, 1>({10.0, -20.0});
+	
+	for(int iter = 0; iter < 5; iter++){
+		vout = func(vin);
+		pm2(vin, vout);
+	}
+
+	CHECK(vin[0] == 2.0_a);
+	CHECK(vin[1] == Approx(-4.0/3.0));
+
+}
+#endif
@@ -13,6 +13,7 @@
 #include <basis/field_set.hpp>
 #include <operations/integral.hpp>
 #include <operations/transfer.hpp>
+#include <operations/transform.hpp>
 #include <utils/profiling.hpp>
 #include <utils/raw_pointer_cast.hpp>
 
@@ -74,6 +75,87 @@ void calculate_gradient_add(const occupations_array_type & occupations, field_se
 
 ///////////////////////////////////////////////////////////////
 
+// Averages the density over the space group operations {R|t},
+// rho(x) -> 1/N sum rho(R^-1 (x - t)). It is done in Fourier space,
+// where the coefficient of the frequency m gets the ones of R^T m
+// times exp(-2 pi i m.t), so the translations do not need to be
+// commensurate with the grid. The frequencies with an image outside
+// the grid are removed.
+//
+// Scaling: each process gets a copy of the full Fourier grid (16
+// bytes per point and per density component) that is obtained with
+// an all_reduce, so the memory and the communication do not decrease
+// with the number of processes. This is acceptable for the densities
+// of the systems where k-point symmetries are useful (small cells
+// with many k-points), but not for large grids; a distributed version
+// would only exchange the points of each star.
+template <typename SymmetriesType>
+void symmetrize(basis::field_set<basis::real_space, double> & density, SymmetriesType const & symm){
+
+	CALI_CXX_MARK_FUNCTION;
+	
+	if(symm.size() == 1) return;
+	
+	auto fdensity = operations::transform::to_fourier(complex_field(density));
+	auto const & fbasis = fdensity.basis();
+	auto nn = fbasis.sizes();
+
+	// the operations mix all the frequencies, so every process gets the full array
+	gpu::array<complex, 4> full({nn[0], nn[1], nn[2], fdensity.local_set_size()}, complex(0.0, 0.0));
+
+	gpu::run(fdensity.local_set_size(), fbasis.local_sizes()[2], fbasis.local_sizes()[1], fbasis.local_sizes()[0],
+					 [fu = begin(full), fcub = begin(fdensity.hypercubic()), px = fbasis.cubic_part(0), py = fbasis.cubic_part(1), pz = fbasis.cubic_part(2)] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+						 fu[px.local_to_global(ix).value()][py.local_to_global(iy).value()][pz.local_to_global(iz).value()][ist] = fcub[ix][iy][iz][ist];
+					 });
+
+	if(fbasis.comm().size() > 1) fbasis.comm().all_reduce_n(raw_pointer_cast(full.data_elements()), full.num_elements());
+
+	gpu::run(fdensity.local_set_size(), fbasis.local_sizes()[2], fbasis.local_sizes()[1], fbasis.local_sizes()[0],
+					 [fu = begin(full), fcub = begin(fdensity.hypercubic()), px = fbasis.cubic_part(0), py = fbasis.cubic_part(1), pz = fbasis.cubic_part(2),
+						nn, nops = symm.size(), rot = begin(symm.rotations()), trans = begin(symm.translations())] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+
+						 auto mm = basis::grid::to_symmetric_range(nn, px.local_to_global(ix).value(), py.local_to_global(iy).value(), pz.local_to_global(iz).value());
+
+						 auto sum = complex(0.0, 0.0);
+						 for(int iop = 0; iop < nops; iop++){
+							 vector3<int> image{0, 0, 0};
+							 auto phase = 0.0;
+							 for(int ii = 0; ii < 3; ii++){
+								 for(int jj = 0; jj < 3; jj++) image[ii] += rot[iop][jj][ii]*mm[jj];
+								 phase -= 2.0*M_PI*mm[ii]*trans[iop][ii];
+							 }
+
+							 for(int ii = 0; ii < 3; ii++){
+								 if(image[ii] < -nn[ii]/2 or image[ii] >= (nn[ii] + 1)/2) {
+									 fcub[ix][iy][iz][ist] = 0.0;
+									 return;
+								 }
+							 }
+							 
+							 auto jj = basis::grid::from_symmetric_range(nn, image);
+							 sum += fu[jj[0]][jj[1]][jj[2]][ist]*complex(cos(phase), sin(phase));
+						 }
+						 
+						 fcub[ix][iy][iz][ist] = sum/double(nops);
+					 });
+
+	density = real_field(operations::transform::to_real(fdensity));
+}
+
+///////////////////////////////////////////////////////////////
+
+// completes a density accumulated with calculate_add from the local orbitals of elec
+template <typename ElecType>
+void calculate_reduce(ElecType & elec, basis::field_set<basis::real_space, double> & density){
+
+	density.all_reduce(elec.kpin_states_comm());
+
+	// with a reduced Brillouin zone the sum over k-points only has the symmetry after the average over the operations
+	symmetrize(density, elec.brillouin_zone().symmetries());
+}
+
+///////////////////////////////////////////////////////////////
+
 template <typename ElecType>
 basis::field_set<basis::real_space, double> calculate(ElecType & elec){
 	
@@ -89,8 +171,8 @@ basis::field_set<basis::real_space, double> calculate(ElecType & elec){
 		iphi++;
 	}
 
-	density.all_reduce(elec.kpin_states_comm());
-
+	calculate_reduce(elec, density);
+	
 	return density;
 }
 
@@ -140,6 +222,7 @@ basis::field<BasisType, ElementType> total(basis::field_set<BasisType, ElementTy
 #undef INQ_OBSERVABLES_DENSITY_UNIT_TEST
 
 #include <basis/trivial.hpp>
+#include <ionic/symmetries.hpp>
 #include <math/complex.hpp>
 
 #include <catch2/catch_all.hpp>
@@ -291,6 +374,48 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		CHECK(real(operations::integral_sum(aa)) == 19.2354_a);
 		
 	}
+
+	SECTION("symmetrize"){
+
+		using namespace inq::magnitude;
+		
+		auto ions = systems::ions(systems::cell::cubic(10.0_b));
+		ions.insert_fractional("Na", {0.0, 0.0, 0.0});
+
+		auto symm = ionic::symmetries(ions);
+		CHECK(symm.size() == 48);
+
+		basis::real_space rs(ions.cell(), /*spacing = */ 0.5, parallel::communicator{boost::mpi3::environment::get_self_instance()});
+
+		basis::field_set<basis::real_space, double> den(rs, 2);
+		basis::field_set<basis::real_space, double> sym_den(rs, 2);
+
+		auto nn = rs.sizes();
+		for(int ix = 0; ix < nn[0]; ix++){
+			for(int iy = 0; iy < nn[1]; iy++){
+				for(int iz = 0; iz < nn[2]; iz++){
+					auto xx = vector3<double>{double(ix)/nn[0], double(iy)/nn[1], double(iz)/nn[2]};
+					auto sym_part = 1.0 + cos(2.0*M_PI*xx[0]) + cos(2.0*M_PI*xx[1]) + cos(2.0*M_PI*xx[2]);
+					den.hypercubic()[ix][iy][iz][0] = sym_part;
+					den.hypercubic()[ix][iy][iz][1] = sym_part + 0.3*sin(2.0*M_PI*(xx[0] + 2.0*xx[1]));
+					sym_den.hypercubic()[ix][iy][iz][0] = sym_part;
+					sym_den.hypercubic()[ix][iy][iz][1] = sym_part;
+				}
+			}
+		}
+
+		auto charge = operations::integral_sum(den);
+		
+		observables::density::symmetrize(den, symm);
+
+		CHECK(operations::integral_sum(den) == Approx(charge));
+		CHECK(operations::integral_sum_absdiff(den, sym_den) < 1e-10);
+
+		// nothing happens without symmetries
+		auto copy = den;
+		observables::density::symmetrize(copy, ionic::symmetries{});
+		CHECK(operations::integral_sum_absdiff(den, copy) == 0.0_a);
+	}
 	
 }
 #endif
@@ -14,6 +14,7 @@
 #include <operations/shift.hpp>
 
 #include <utils/profiling.hpp>
+#include <utils/workspace.hpp>
 
 namespace inq {
 namespace operations {
@@ -34,6 +35,30 @@ namespace operations {
   }
 
 	///////////////////////////////////////////////////////////////////////////
+
+	// the same as above, but the operator writes its result in the output argument, and the temporaries are taken from the workspace
+	template <class operator_type, class field_set_type>
+	void exponential_in_place(const operator_type & ham, typename field_set_type::element_type const & factor, field_set_type & phi, utils::workspace & work, int const order = 4){
+
+    CALI_CXX_MARK_FUNCTION;
+
+		auto hnphi = &work.orbitals("exponential::hnphi", phi);
+		auto hnphi_next = &work.orbitals("exponential::hnphi_next", phi);
+		
+		ham(phi, *hnphi, work);
+		
+		typename field_set_type::element_type coeff = 1.0;
+		for(int iter = 1; iter <= order; iter++){
+			if(iter > 1) {
+				ham(*hnphi, *hnphi_next, work);
+				std::swap(hnphi, hnphi_next);
+			}
+			coeff *= factor/typename complex::value_type(iter);
+			shift(coeff, *hnphi, phi);
+		}
+  }
+
+	///////////////////////////////////////////////////////////////////////////
 	
 	template <class operator_type, class field_set_type>
 	auto exponential(const operator_type & ham, typename field_set_type::element_type const & factor, field_set_type const & phi, int const order = 4){
@@ -68,6 +93,37 @@ namespace operations {
 		return expphi;		
   }
 
+	///////////////////////////////////////////////////////////////////////////
+	
+	// the returned set belongs to the workspace, it is valid until the next call
+	template <class operator_type, class field_set_type>
+	field_set_type & exponential_2_for_1(const operator_type & ham, typename field_set_type::element_type const & factor1, typename field_set_type::element_type const & factor2, field_set_type & phi, utils::workspace & work, int const order = 4){
+
+		CALI_CXX_MARK_FUNCTION;
+
+		auto & expphi = work.orbitals("exponential::expphi", phi);
+		expphi.matrix() = phi.matrix();
+		auto hnphi = &work.orbitals("exponential::hnphi", phi);
+		auto hnphi_next = &work.orbitals("exponential::hnphi_next", phi);
+
+		ham(phi, *hnphi, work);
+		
+		typename field_set_type::element_type coeff1 = 1.0;
+		typename field_set_type::element_type coeff2 = 1.0;
+		for(int iter = 1; iter <= order; iter++){
+			if(iter > 1) {
+				ham(*hnphi, *hnphi_next, work);
+				std::swap(hnphi, hnphi_next);
+			}
+			coeff1 *= factor1/typename complex::value_type(iter);
+			coeff2 *= factor2/typename complex::value_type(iter);
+			shift(coeff1, *hnphi, expphi);
+			shift(coeff2, *hnphi, phi);
+		}
+
+		return expphi;		
+  }
+
 }
 }
 #endif
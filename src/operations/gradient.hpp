@@ -30,7 +30,7 @@ ResultType gradient(FieldSetType const & ff, double factor = 1.0, vector3<double
 
 	if constexpr(std::is_same_v<typename FieldSetType::basis_type, basis::real_space>) {
 		if constexpr(std::is_same_v<typename FieldSetType::element_type, double>) {		
-			return real_field(operations::transform::to_real(operations::gradient(operations::transform::to_fourier(complex_field(ff)), factor, shift)));
+			return operations::transform::to_real_c2r(operations::gradient(operations::transform::to_fourier_r2c(ff), factor, shift));
 		} else {
 			return operations::transform::to_real(operations::gradient(operations::transform::to_fourier(ff), factor, shift));
 		}
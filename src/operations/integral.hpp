@@ -9,8 +9,10 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
+#include <array>
 #include <cassert>
 #include <numeric>
+#include <type_traits>
 
 #include <basis/field.hpp>
 #include <basis/field_set.hpp>
@@ -38,17 +40,49 @@ auto integral_sum(basis::field_set<BasisType, ElementType> const & phi){
 	return integral_value;
 }
 
+// The integrals below are evaluated directly with a reduction kernel, no temporary array of
+// the size of the grid is needed.
+
+template <typename Type, class KernelType>
+Type integral_reduce(long size, KernelType const & kernel){
+	if(size == 0) return Type(0.0);
+	return gpu::run(gpu::reduce(size), kernel);
+}
+
+template <class ArrayType>
+struct integral_abs_kernel {
+	ArrayType ph;
+	
+	GPU_FUNCTION auto operator()(long ip) const {
+		return fabs(ph[ip]);
+	}
+};
+
+template <class ArrayType1, class ArrayType2>
+struct integral_product_kernel {
+	ArrayType1 p1;
+	ArrayType2 p2;
+	
+	GPU_FUNCTION auto operator()(long ip) const {
+		return p1[ip]*p2[ip];
+	}
+};
+
+template <class ArrayType1, class ArrayType2>
+struct integral_absdiff_kernel {
+	ArrayType1 p1;
+	ArrayType2 p2;
+	
+	GPU_FUNCTION double operator()(long ip) const {
+		return fabs(p1[ip] - p2[ip]);
+	}
+};
+
 template <class BasisType, class ElementType>
 double integral_abs(basis::field<BasisType, ElementType> const & phi){
 	CALI_CXX_MARK_FUNCTION;
 
-	gpu::array<ElementType, 1> sum_array(phi.basis().local_size());
-	gpu::run(phi.basis().local_size(),
-					 [su = begin(sum_array), ph = begin(phi.linear())] GPU_LAMBDA (auto ip) {
-						 su[ip] = fabs(ph[ip]);
-					 });
-
-	auto integral_value = phi.basis().volume_element()*sum(sum_array);
+	auto integral_value = phi.basis().volume_element()*integral_reduce<double>(phi.basis().local_size(), integral_abs_kernel<decltype(begin(phi.linear()))>{begin(phi.linear())});
 	if(phi.basis().comm().size() > 1) phi.basis().comm().all_reduce_in_place_n(&integral_value, 1, std::plus<>{});
 	return integral_value;
 }
@@ -60,14 +94,9 @@ auto integral_product(basis::field<BasisType, ElementType1> const & phi1, basis:
 	assert(phi1.basis() == phi2.basis());
 	
 	using type = decltype(ElementType1{}*ElementType2{});
-	gpu::array<type, 1> sum_array(phi1.basis().local_size());
-
-	gpu::run(phi1.basis().local_size(),
-					 [su = begin(sum_array), p1 = begin(phi1.linear()), p2 = begin(phi2.linear())] GPU_LAMBDA (auto ip) {
-						 su[ip] = p1[ip]*p2[ip];
-					 });
-
-	auto integral_value = phi1.basis().volume_element()*sum(sum_array);
+	using kernel_type = integral_product_kernel<decltype(begin(phi1.linear())), decltype(begin(phi2.linear()))>;
+	
+	auto integral_value = phi1.basis().volume_element()*integral_reduce<type>(phi1.basis().local_size(), kernel_type{begin(phi1.linear()), begin(phi2.linear())});
 	if(phi1.basis().comm().size() > 1) phi1.basis().comm().all_reduce_in_place_n(&integral_value, 1, std::plus<>{});
 	return integral_value;
 }
@@ -79,14 +108,9 @@ auto integral_product_sum(basis::field_set<BasisType, ElementType1> const & phi1
 	assert(phi1.basis() == phi2.basis());
 	
 	using type = decltype(ElementType1{}*ElementType2{});
-	gpu::array<type, 1> sum_array(phi1.matrix().flatted().size());
-
-	gpu::run(phi1.matrix().flatted().size(),
-					 [su = begin(sum_array), p1 = begin(phi1.matrix().flatted()), p2 = begin(phi2.matrix().flatted())] GPU_LAMBDA (auto ip) {
-						 su[ip] = p1[ip]*p2[ip];
-					 });
+	using kernel_type = integral_product_kernel<decltype(begin(phi1.matrix().flatted())), decltype(begin(phi2.matrix().flatted()))>;
 
-	auto integral_value = phi1.basis().volume_element()*sum(sum_array);
+	auto integral_value = phi1.basis().volume_element()*integral_reduce<type>(phi1.matrix().flatted().size(), kernel_type{begin(phi1.matrix().flatted()), begin(phi2.matrix().flatted())});
 	if(phi1.basis().comm().size() > 1) phi1.basis().comm().all_reduce_in_place_n(&integral_value, 1, std::plus<>{});
 	return integral_value;
 }
@@ -96,15 +120,10 @@ double integral_absdiff(basis::field<BasisType, ElementType1> const & phi1, basi
 	CALI_CXX_MARK_FUNCTION;
 	
 	assert(phi1.basis() == phi2.basis());
-	
-	gpu::array<double, 1> sum_array(phi1.basis().local_size());
-
-	gpu::run(phi1.basis().local_size(),
-					 [su = begin(sum_array), p1 = begin(phi1.linear()), p2 = begin(phi2.linear())] GPU_LAMBDA (auto ip) {
-						 su[ip] = fabs(p1[ip] - p2[ip]);
-					 });
 
-	auto integral_value = phi1.basis().volume_element()*sum(sum_array);
+	using kernel_type = integral_absdiff_kernel<decltype(begin(phi1.linear())), decltype(begin(phi2.linear()))>;
+	
+	auto integral_value = phi1.basis().volume_element()*integral_reduce<double>(phi1.basis().local_size(), kernel_type{begin(phi1.linear()), begin(phi2.linear())});
 	if(phi1.basis().comm().size() > 1) phi1.basis().comm().all_reduce_in_place_n(&integral_value, 1, std::plus<>{});
 	return integral_value;
 }
@@ -114,19 +133,72 @@ double integral_sum_absdiff(basis::field_set<BasisType, ElementType1> const & ph
 	CALI_CXX_MARK_FUNCTION;
 
 	assert(phi1.basis() == phi2.basis());
-	
-	gpu::array<double, 1> sum_array(phi1.matrix().flatted().size());
 
-	gpu::run(phi1.matrix().flatted().size(),
-					 [su = begin(sum_array), p1 = begin(phi1.matrix().flatted()), p2 = begin(phi2.matrix().flatted())] GPU_LAMBDA (auto ip) {
-						 su[ip] = fabs(p1[ip] - p2[ip]);
-					 });
-
-	auto integral_value = phi1.basis().volume_element()*sum(sum_array);
+	using kernel_type = integral_absdiff_kernel<decltype(begin(phi1.matrix().flatted())), decltype(begin(phi2.matrix().flatted()))>;
+	
+	auto integral_value = phi1.basis().volume_element()*integral_reduce<double>(phi1.matrix().flatted().size(), kernel_type{begin(phi1.matrix().flatted()), begin(phi2.matrix().flatted())});
 	if(phi1.basis().comm().size() > 1) phi1.basis().comm().all_reduce_in_place_n(&integral_value, 1, std::plus<>{});
 	return integral_value;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+
+// A small fixed-size set of values that can be accumulated in a single reduction.
+
+template <typename Type, int NumValues>
+struct multi_value {
+
+	multi_value() = default;
+	
+	GPU_FUNCTION multi_value(double val){
+		for(int ival = 0; ival < NumValues; ival++) values[ival] = val;
+	}
+
+	GPU_FUNCTION multi_value & operator+=(multi_value const & term){
+		for(int ival = 0; ival < NumValues; ival++) values[ival] += term.values[ival];
+		return *this;
+	}
+	
+	Type values[NumValues];
+};
+
+template <class ArrayType1, class ArrayType2, int NumFields>
+struct integral_product_bundle_kernel {
+	ArrayType1 p1;
+	ArrayType2 p2[NumFields];
+	
+	GPU_FUNCTION auto operator()(long ip) const {
+		multi_value<decltype(p1[0]*p2[0][0]), NumFields> res;
+		for(int ifield = 0; ifield < NumFields; ifield++) res.values[ifield] = p1[ip]*p2[ifield][ip];
+		return res;
+	}
+};
+
+// Calculates the integrals of the product of phi with each one of the other fields, in a
+// single pass over the grid and with one reduction. This is useful to evaluate several
+// energy terms that share the density.
+
+template <class BasisType, class ElementType1, class ElementType2, class... FieldTypes>
+auto integral_product_bundle(basis::field<BasisType, ElementType1> const & phi, basis::field<BasisType, ElementType2> const & first, FieldTypes const & ... rest){
+	CALI_CXX_MARK_FUNCTION;
+
+	static_assert((std::is_same_v<FieldTypes, basis::field<BasisType, ElementType2>> and ...), "All the fields in the bundle must be of the same type");
+	
+	constexpr int num_fields = 1 + sizeof...(rest);
+	using type = decltype(ElementType1{}*ElementType2{});
+	using kernel_type = integral_product_bundle_kernel<decltype(begin(phi.linear())), decltype(begin(first.linear())), num_fields>;
+
+	assert(phi.basis() == first.basis());
+	assert(((phi.basis() == rest.basis()) and ...));
+	
+	auto values = integral_reduce<multi_value<type, num_fields>>(phi.basis().local_size(), kernel_type{begin(phi.linear()), {begin(first.linear()), begin(rest.linear())...}});
+	if(phi.basis().comm().size() > 1) phi.basis().comm().all_reduce_in_place_n(values.values, num_fields, std::plus<>{});
+
+	std::array<type, num_fields> integrals;
+	for(int ifield = 0; ifield < num_fields; ifield++) integrals[ifield] = phi.basis().volume_element()*values.values[ifield];
+	return integrals;
+}
+
 }
 }
 #endif
@@ -222,6 +294,31 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		
 	}
 	
+	SECTION("Integral product bundle"){
+		
+		basis::field<basis::trivial, double> aa(bas);
+		basis::field<basis::trivial, double> bb(bas);
+		basis::field<basis::trivial, double> cc(bas);
+		
+		for(int ii = 0; ii < aa.basis().part().local_size(); ii++)	{
+			auto iig = aa.basis().part().local_to_global(ii);
+			aa.linear()[ii] = pow(iig.value() + 1, 2);
+			bb.linear()[ii] = 1.0/(iig.value() + 1);
+			cc.linear()[ii] = -3.0;
+		}
+
+		auto bundle = operations::integral_product_bundle(aa, bb, cc);
+
+		CHECK(bundle.size() == 2);
+		CHECK(bundle[0] == Approx(0.5*N*(N + 1.0)*bas.volume_element()));
+		CHECK(bundle[0] == Approx(operations::integral_product(aa, bb)));
+		CHECK(bundle[1] == Approx(operations::integral_product(aa, cc)));
+
+		auto single = operations::integral_product_bundle(bb, aa);
+		CHECK(single.size() == 1);
+		CHECK(single[0] == Approx(0.5*N*(N + 1.0)*bas.volume_element()));
+	}
+	
 	SECTION("Integral product complex"){
 		
 		basis::field<basis::trivial, complex> aa(bas);
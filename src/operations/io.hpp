@@ -20,6 +20,8 @@
 #include <utils/profiling.hpp>
 #include <utils/raw_pointer_cast.hpp>
 
+#include <stdexcept>
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -130,6 +132,8 @@ void save(std::string const & dirname, basis::field_set<Basis, Type> const & phi
 
 	CALI_CXX_MARK_SCOPE("save(field_set)");
 	
+	if(phi.basis().pencil()) throw std::runtime_error("inq error: the files of a grid are not implemented for the pencil decomposition");
+	
 	gpu::array<Type, 1> buffer(phi.basis().part().local_size());
 
 	utils::create_directory(phi.full_comm(), dirname);
@@ -148,6 +152,8 @@ auto load(std::string const & dirname, basis::field_set<Basis, Type> & phi){
 
 	CALI_CXX_MARK_FUNCTION;
 
+	if(phi.basis().pencil()) throw std::runtime_error("inq error: the files of a grid are not implemented for the pencil decomposition");
+	
 	gpu::array<Type, 1> buffer(phi.basis().part().local_size());
 
 	DIR* dir = opendir(dirname.c_str());
@@ -173,6 +179,8 @@ void save(std::string const & dirname, states::orbital_set<Basis, Type> const &
 
 	CALI_CXX_MARK_SCOPE("save(field_set)");
 	
+	if(phi.basis().pencil()) throw std::runtime_error("inq error: the files of a grid are not implemented for the pencil decomposition");
+	
 	gpu::array<Type, 1> buffer(phi.basis().part().local_size());
 
 	utils::create_directory(phi.full_comm(), dirname);
@@ -193,6 +201,8 @@ auto load(std::string const & dirname, states::orbital_set<Basis, Type> & phi){
 
 	CALI_CXX_MARK_FUNCTION;
 
+	if(phi.basis().pencil()) throw std::runtime_error("inq error: the files of a grid are not implemented for the pencil decomposition");
+	
 	gpu::array<Type, 1> buffer(phi.basis().part().local_size());
 
 	DIR* dir = opendir(dirname.c_str());
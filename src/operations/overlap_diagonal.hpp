@@ -12,7 +12,9 @@
 #include <inq_config.h>
 
 #include <gpu/array.hpp>
+#include <array>
 #include <cassert>
+#include <utility>
 #include <operations/integral.hpp>
 
 #include <utils/profiling.hpp>
@@ -88,6 +90,79 @@ auto overlap_diagonal(const field_set_type & phi){
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Several band-wise overlaps <a_k|b_k> computed in a single pass over the points and with a
+// single reduction. The result is a (number of pairs) x (number of local states) array.
+
+template <class SetType>
+struct set_pair {
+	SetType const & first;
+	SetType const & second;
+};
+
+template <class SetType>
+auto overlap_pair(SetType const & first, SetType const & second){
+	assert(first.basis() == second.basis());
+	return set_pair<SetType>{first, second};
+}
+
+template <class mat_type, int NumPairs>
+struct overlap_diagonal_multi_mult {
+
+	double factor;
+	mat_type mat1[NumPairs];
+	mat_type mat2[NumPairs];
+	
+	GPU_FUNCTION auto operator()(long ist, long ip) const {
+		multi_value<decltype(conj(mat1[0][0][0])*mat2[0][0][0]), NumPairs> res;
+		for(int ipair = 0; ipair < NumPairs; ipair++) res.values[ipair] = factor*conj(mat1[ipair][ip][ist])*mat2[ipair][ip][ist];
+		return res;
+	}
+};
+
+template <class SetType, std::size_t NumPairs, std::size_t... Index>
+auto overlap_diagonal_multi_impl(std::array<set_pair<SetType>, NumPairs> const & pairs, std::index_sequence<Index...>){
+
+	CALI_CXX_MARK_SCOPE("overlap_diagonal_multi");
+
+	using type = typename SetType::element_type;
+
+	auto & basis = pairs[0].first.basis();
+	auto nn = std::get<1>(sizes(pairs[0].first.spinor_matrix()));
+	auto np = pairs[0].first.spinor_matrix().size();
+
+	for(auto & pair : pairs){
+		assert(sizes(pair.first.spinor_matrix()) == sizes(pairs[0].first.spinor_matrix()));
+		assert(sizes(pair.second.spinor_matrix()) == sizes(pairs[0].first.spinor_matrix()));
+	}
+	
+	using mat_type = decltype(begin(pairs[0].first.spinor_matrix()));
+	
+	auto values = gpu::run(nn, gpu::reduce(np),
+												 overlap_diagonal_multi_mult<mat_type, NumPairs>{basis.volume_element(), {begin(pairs[Index].first.spinor_matrix())...}, {begin(pairs[Index].second.spinor_matrix())...}});
+
+	if(basis.comm().size() > 1){
+		CALI_CXX_MARK_SCOPE("overlap_diagonal_multi::reduce");
+		basis.comm().all_reduce_in_place_n(reinterpret_cast<type *>(raw_pointer_cast(values.data_elements())), NumPairs*values.size(), std::plus<>{});
+	}
+
+	gpu::array<type, 2> overlaps({long(NumPairs), nn});
+
+	gpu::run(nn, NumPairs,
+					 [olp = begin(overlaps), val = begin(values)] GPU_LAMBDA (auto ist, auto ipair){
+						 olp[ipair][ist] = val[ist].values[ipair];
+					 });
+
+	return overlaps;
+}
+
+template <class SetType, class... PairTypes>
+auto overlap_diagonal_multi(set_pair<SetType> const & first, PairTypes const & ... rest){
+	constexpr std::size_t num_pairs = 1 + sizeof...(rest);
+	return overlap_diagonal_multi_impl(std::array<set_pair<SetType>, num_pairs>{first, rest...}, std::make_index_sequence<num_pairs>{});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 template <typename Type>
 struct value_and_norm {
 
@@ -340,6 +415,26 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 			}
 		}
 
+		{
+			auto mm = operations::overlap_diagonal_multi(operations::overlap_pair(aa, bb), operations::overlap_pair(cc, cc), operations::overlap_pair(bb, aa));
+			auto ee = operations::overlap_diagonal(cc);
+			auto hh = operations::overlap_diagonal(bb, aa);
+			
+			CHECK(typeid(decltype(mm)) == typeid(gpu::array<complex, 2>));
+
+			CHECK(std::get<0>(sizes(mm)) == 3);
+			CHECK(std::get<1>(sizes(mm)) == aa.set_part().local_size());
+			
+			for(int jj = 0; jj < aa.set_part().local_size(); jj++) {
+				CHECK(real(mm[0][jj]) == Approx(real(dd[jj])).margin(1e-12));
+				CHECK(imag(mm[0][jj]) == Approx(imag(dd[jj])));
+				CHECK(real(mm[1][jj]) == Approx(real(ee[jj])));
+				CHECK(imag(mm[1][jj]) == Approx(imag(ee[jj])).margin(1e-12));
+				CHECK(real(mm[2][jj]) == Approx(real(hh[jj])).margin(1e-12));
+				CHECK(imag(mm[2][jj]) == Approx(imag(hh[jj])));
+			}
+		}
+
 	}
 
 	SECTION("orbital_set double"){
@@ -397,6 +492,18 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 			for(int jj = 0; jj < ff.size(); jj++) CHECK(ff[jj] == Approx(dd[jj]/gg[jj]));
  
 		}
+
+		{
+			auto mm = operations::overlap_diagonal_multi(operations::overlap_pair(aa, bb), operations::overlap_pair(cc, cc));
+
+			CHECK(typeid(decltype(mm)) == typeid(gpu::array<double, 2>));
+			
+			for(int jj = 0; jj < aa.set_part().local_size(); jj++) {
+				auto jjg = aa.set_part().local_to_global(jj).value();
+				CHECK(mm[0][jj] == Approx(-jjg - 1));
+				CHECK(mm[1][jj] == Approx(0.5*npoint*(npoint - 1.0)*bas.volume_element()*jjg));
+			}
+		}
 	}
 
 	SECTION("orbital_set complex"){
@@ -62,6 +62,14 @@ public:
 		phi = operations::transform::to_real(fphi);
 	}
 
+	// for real orbitals only half of the spectrum is stored, the kinetic energy estimate is slightly different but it is only used as a scale
+	void operator()(states::orbital_set<basis::real_space, double> & phi) const {
+			
+		auto fphi = operations::transform::to_fourier_r2c(phi);
+		operator()(fphi);
+		phi = operations::transform::to_real_c2r(fphi);
+	}
+
 };
 
 class no_preconditioner {
@@ -22,13 +22,285 @@
 #endif
 
 #include <cassert>
+#include <list>
 
 namespace inq {
 namespace operations {
 namespace transfer {
 
+// A plan holds the index maps and the communication pattern needed to move the points of
+// a grid to a grid with a different size (in the symmetric range sense). It is generated
+// once per pair of bases and then executed with pack and unpack kernels. The plan keeps a
+// duplicate of the communicator of the bases, so it has to be destroyed before MPI is
+// finalized.
+
+class plan {
+
+	std::array<int, 3> source_sizes_;
+	std::array<int, 3> destination_sizes_;
+	mutable parallel::communicator comm_;
+	int comm_size_;
+	gpu::array<long, 1> send_points_;
+	gpu::array<long, 1> recv_points_;
+	std::vector<int> send_sizes_;
+	std::vector<int> send_displs_;
+	std::vector<int> recv_sizes_;
+	std::vector<int> recv_displs_;
+
+public:
+
+	template <class BasisType>
+	plan(BasisType const & source_basis, BasisType const & destination_basis):
+		source_sizes_(source_basis.sizes()),
+		destination_sizes_(destination_basis.sizes()),
+		comm_(source_basis.comm()),
+		comm_size_(comm_.size())
+	{
+		CALI_CXX_MARK_FUNCTION;
+
+		assert(destination_basis.comm().size() == comm_size_);
+		
+		// the points of the destination that we hold and where they come from
+		std::vector<long> source_list;
+		std::vector<long> destination_list;
+
+		source_list.reserve(destination_basis.local_size());
+		destination_list.reserve(destination_basis.local_size());
+		
+		long idest = 0;
+		for(int ix = 0; ix < destination_basis.local_sizes()[0]; ix++){
+			for(int iy = 0; iy < destination_basis.local_sizes()[1]; iy++){
+				for(int iz = 0; iz < destination_basis.local_sizes()[2]; iz++){
+					
+					auto ixg = destination_basis.cubic_part(0).local_to_global(ix);
+					auto iyg = destination_basis.cubic_part(1).local_to_global(iy);
+					auto izg = destination_basis.cubic_part(2).local_to_global(iz);
+					
+					auto ii = destination_basis.to_symmetric_range(ixg, iyg, izg);
+					
+					bool outside = false;
+					for(int idir = 0; idir < 3; idir++) outside = outside or ii[idir] < source_basis.symmetric_range_begin(idir) or ii[idir] >= source_basis.symmetric_range_end(idir);
+					
+					if(not outside) {
+						auto isource = source_basis.from_symmetric_range(ii);
+						source_list.push_back(source_basis.linear_index(isource[0], isource[1], isource[2]));
+						destination_list.push_back(idest);
+					}
+					
+					idest++;
+				}
+			}
+		}
+
+		assert(idest == destination_basis.local_size());
+
+		send_sizes_.resize(comm_size_);
+		send_displs_.resize(comm_size_);
+		recv_sizes_.resize(comm_size_);
+		recv_displs_.resize(comm_size_);
+		
+		if(comm_size_ == 1) {
+			send_points_ = gpu::array<long, 1>(source_list.begin(), source_list.end());
+			recv_points_ = gpu::array<long, 1>(destination_list.begin(), destination_list.end());
+			send_sizes_[0] = recv_sizes_[0] = source_list.size();
+			send_displs_[0] = recv_displs_[0] = 0;
+			return;
+		}
+		
+		gpu::array<long, 1> list(source_list.begin(), source_list.end());
+		parallel::remote_points_table rp(source_basis, list);
+
+		// what we send: the requested points, converted to local indices
+		send_points_.reextent(rp.total_requested);
+		for(long ip = 0; ip < rp.total_requested; ip++) {
+			send_points_[ip] = source_basis.part().global_to_local(parallel::global_index(rp.list_points_requested[ip]));
+		}
+
+		// what we receive: the destination position of each point, in arrival order
+		recv_points_.reextent(rp.total_needed);
+		long irecv = 0;
+		for(int iproc = 0; iproc < comm_size_; iproc++){
+			for(auto const & point : rp.points_needed[iproc]) {
+				recv_points_[irecv] = destination_list[point.position];
+				irecv++;
+			}
+		}
+		assert(irecv == rp.total_needed);
+
+		for(int iproc = 0; iproc < comm_size_; iproc++){
+			send_sizes_[iproc] = rp.list_sizes_requested[iproc];
+			send_displs_[iproc] = rp.list_displs_requested[iproc];
+			recv_sizes_[iproc] = rp.list_sizes_needed[iproc];
+			recv_displs_[iproc] = rp.list_displs_needed[iproc];
+		}
+	}
+
+	////////////////////////////////////////////////////////
+	
+	// the plan can be used with any communicator that has the same processes in the same order
+	template <class BasisType>
+	auto matches(BasisType const & source_basis, BasisType const & destination_basis) const {
+		if(source_basis.sizes() != source_sizes_ or destination_basis.sizes() != destination_sizes_ or source_basis.comm().size() != comm_size_) return false;
+		
+		int result;
+		MPI_Comm_compare(comm_.get(), source_basis.comm().get(), &result);
+		return result == MPI_IDENT or result == MPI_CONGRUENT;
+	}
+
+	////////////////////////////////////////////////////////
+	
+	auto send_size() const {
+		return long(send_points_.size());
+	}
+
+	auto recv_size() const {
+		return long(recv_points_.size());
+	}
+
+	////////////////////////////////////////////////////////
+
+	template <class ElementType>
+	void exchange(gpu::array<ElementType, 2> const & send_buffer, gpu::array<ElementType, 2> & recv_buffer) const {
+
+		CALI_CXX_MARK_FUNCTION;
+		
+		MPI_Datatype mpi_type;
+		MPI_Type_contiguous(send_buffer.transposed().size(), boost::mpi3::detail::basic_datatype<ElementType>(), &mpi_type);
+		MPI_Type_commit(&mpi_type);
+		
+		MPI_Alltoallv(raw_pointer_cast(send_buffer.data_elements()), send_sizes_.data(), send_displs_.data(), mpi_type,
+									raw_pointer_cast(recv_buffer.data_elements()), recv_sizes_.data(), recv_displs_.data(), mpi_type, comm_.get());
+
+		MPI_Type_free(&mpi_type);
+	}
+	
+	////////////////////////////////////////////////////////
+	
+	template <class BasisType, class ElementType>
+	void execute(basis::field<BasisType, ElementType> const & source, basis::field<BasisType, ElementType> & destination, double const factor) const {
+
+		CALI_CXX_MARK_SCOPE("transfer::plan::execute(field)");
+
+		if(comm_size_ == 1) {
+			gpu::run(recv_size(),
+							 [des = begin(destination.linear()), sou = begin(source.linear()), spo = begin(send_points_), rpo = begin(recv_points_), factor] GPU_LAMBDA (auto ip){
+								 des[rpo[ip]] = factor*sou[spo[ip]];
+							 });
+			return;
+		}
+		
+		gpu::array<ElementType, 2> send_buffer({send_size(), 1});
+		gpu::array<ElementType, 2> recv_buffer({recv_size(), 1});
+
+		gpu::run(send_size(),
+						 [buf = begin(send_buffer), sou = begin(source.linear()), spo = begin(send_points_)] GPU_LAMBDA (auto ip){
+							 buf[ip][0] = sou[spo[ip]];
+						 });
+
+		exchange(send_buffer, recv_buffer);
+		
+		gpu::run(recv_size(),
+						 [des = begin(destination.linear()), buf = begin(recv_buffer), rpo = begin(recv_points_), factor] GPU_LAMBDA (auto ip){
+							 des[rpo[ip]] = factor*buf[ip][0];
+						 });
+	}
+
+	////////////////////////////////////////////////////////
+	
+	template <class FieldSetType>
+	void execute(FieldSetType const & source, FieldSetType & destination, double const factor) const {
+
+		CALI_CXX_MARK_SCOPE("transfer::plan::execute(field_set)");
+
+		using element_type = typename FieldSetType::element_type;
+		auto nset = source.local_set_size();
+		
+		if(comm_size_ == 1) {
+			gpu::run(nset, recv_size(),
+							 [des = begin(destination.matrix()), sou = begin(source.matrix()), spo = begin(send_points_), rpo = begin(recv_points_), factor] GPU_LAMBDA (auto iset, auto ip){
+								 des[rpo[ip]][iset] = factor*sou[spo[ip]][iset];
+							 });
+			return;
+		}
+		
+		gpu::array<element_type, 2> send_buffer({send_size(), nset});
+		gpu::array<element_type, 2> recv_buffer({recv_size(), nset});
+
+		gpu::run(nset, send_size(),
+						 [buf = begin(send_buffer), sou = begin(source.matrix()), spo = begin(send_points_)] GPU_LAMBDA (auto iset, auto ip){
+							 buf[ip][iset] = sou[spo[ip]][iset];
+						 });
+
+		exchange(send_buffer, recv_buffer);
+		
+		gpu::run(nset, recv_size(),
+						 [des = begin(destination.matrix()), buf = begin(recv_buffer), rpo = begin(recv_points_), factor] GPU_LAMBDA (auto iset, auto ip){
+							 des[rpo[ip]][iset] = factor*buf[ip][iset];
+						 });
+	}
+	
+};
+
+//////////////////////////////////////////////////////////
+
+// A small cache of plans, for the objects that use the same pairs of bases over and over (like
+// the Poisson solver). The cache belongs to that object, so the plans are released with it.
+// A copy starts empty.
+
+class plan_cache {
+
+	std::list<plan> plans_;
+	long capacity_;
+
+public:
+
+	plan_cache(long capacity = 8):
+		capacity_(capacity){
+		assert(capacity_ > 0);
+	}
+
+	plan_cache(plan_cache const & other):
+		capacity_(other.capacity_){
+	}
+
+	plan_cache(plan_cache &&) = default;
+
+	plan_cache & operator=(plan_cache const & other) {
+		plans_.clear();
+		capacity_ = other.capacity_;
+		return *this;
+	}
+
+	plan_cache & operator=(plan_cache &&) = default;
+	
+	template <class BasisType>
+	plan const & operator()(BasisType const & source_basis, BasisType const & destination_basis) {
+
+		for(auto it = plans_.begin(); it != plans_.end(); ++it){
+			if(not it->matches(source_basis, destination_basis)) continue;
+			plans_.splice(plans_.begin(), plans_, it);
+			return plans_.front();
+		}
+
+		if(size() >= capacity_) plans_.pop_back();
+		plans_.emplace_front(source_basis, destination_basis);
+		return plans_.front();
+	}
+
+	auto size() const {
+		return long(plans_.size());
+	}
+
+	void clear() {
+		plans_.clear();
+	}
+	
+};
+
+//////////////////////////////////////////////////////////
+
 template <class FieldType>
-FieldType enlarge(FieldType const & source, typename FieldType::basis_type const & new_basis, double const factor = 1.0) {
+FieldType enlarge(FieldType const & source, typename FieldType::basis_type const & new_basis, plan_cache & plans, double const factor = 1.0) {
 
 	CALI_CXX_MARK_FUNCTION;
 	
@@ -48,47 +320,7 @@ FieldType enlarge(FieldType const & source, typename FieldType::basis_type const
 		
 	} else {
 
-		std::vector<long> point_list;
-
-		for(int ix = 0; ix < source.basis().sizes()[0]; ix++){
-			for(int iy = 0; iy < source.basis().sizes()[1]; iy++){
-				for(int iz = 0; iz < source.basis().sizes()[2]; iz++){
-					
-					auto ii = source.basis().to_symmetric_range(ix, iy, iz);
-					auto idest = destination.basis().from_symmetric_range(ii);
-
-					if(not destination.basis().local_contains(idest)) continue;
-
-					point_list.push_back(source.basis().linear_index(ix, iy, iz));
-					
-				}
-			}
-		}
-
-		gpu::array<long, 1> list(point_list.begin(), point_list.end());
-		
-		auto points = parallel::get_remote_points(source, list);
-		
-		long ip = 0;
-		for(int ix = 0; ix < source.basis().sizes()[0]; ix++){
-			for(int iy = 0; iy < source.basis().sizes()[1]; iy++){
-				for(int iz = 0; iz < source.basis().sizes()[2]; iz++){
-
-					auto ii = source.basis().to_symmetric_range(ix, iy, iz);
-					auto idest = destination.basis().from_symmetric_range(ii);
-
-					if(not destination.basis().local_contains(idest)) continue;
-
-					auto il0 = destination.basis().cubic_part(0).global_to_local(parallel::global_index(idest[0]));
-					auto il1 = destination.basis().cubic_part(1).global_to_local(parallel::global_index(idest[1]));
-					auto il2 = destination.basis().cubic_part(2).global_to_local(parallel::global_index(idest[2]));
-
-					destination.cubic()[il0][il1][il2] = factor*points[ip];
-					ip++;
-					
-				}
-			}
-		}
+		plans(source.basis(), destination.basis()).execute(source, destination, factor);
 
 	}
 
@@ -99,7 +331,7 @@ FieldType enlarge(FieldType const & source, typename FieldType::basis_type const
 //////////////////////////////////////////////////////////
 
 template <class Type, class BasisType>
-basis::field_set<BasisType, Type> enlarge(basis::field_set<BasisType, Type> const & source, BasisType const & new_basis, double const factor = 1.0) {
+basis::field_set<BasisType, Type> enlarge(basis::field_set<BasisType, Type> const & source, BasisType const & new_basis, plan_cache & plans, double const factor = 1.0) {
 	CALI_CXX_MARK_FUNCTION;
 	
 	basis::field_set<BasisType, Type> destination(new_basis, source.set_size(), source.full_comm());
@@ -119,47 +351,7 @@ basis::field_set<BasisType, Type> enlarge(basis::field_set<BasisType, Type> cons
 		
 	} else {
 
-		std::vector<long> point_list;
-
-		for(int ix = 0; ix < source.basis().sizes()[0]; ix++){
-			for(int iy = 0; iy < source.basis().sizes()[1]; iy++){
-				for(int iz = 0; iz < source.basis().sizes()[2]; iz++){
-					
-					auto ii = source.basis().to_symmetric_range(ix, iy, iz);
-					auto idest = destination.basis().from_symmetric_range(ii);
-
-					if(not destination.basis().local_contains(idest)) continue;
-
-					point_list.push_back(source.basis().linear_index(ix, iy, iz));
-					
-				}
-			}
-		}
-
-		gpu::array<long, 1> list(point_list.begin(), point_list.end());
-		
-		auto points = parallel::get_remote_points(source, list);
-		
-		long ip = 0;
-		for(int ix = 0; ix < source.basis().sizes()[0]; ix++){
-			for(int iy = 0; iy < source.basis().sizes()[1]; iy++){
-				for(int iz = 0; iz < source.basis().sizes()[2]; iz++){
-	
-					auto ii = source.basis().to_symmetric_range(ix, iy, iz);
-					auto idest = destination.basis().from_symmetric_range(ii);
-
-					if(not destination.basis().local_contains(idest)) continue;
-
-					auto il0 = destination.basis().cubic_part(0).global_to_local(parallel::global_index(idest[0]));
-					auto il1 = destination.basis().cubic_part(1).global_to_local(parallel::global_index(idest[1]));
-					auto il2 = destination.basis().cubic_part(2).global_to_local(parallel::global_index(idest[2]));
-
-					for(int ist = 0; ist < source.set_part().local_size(); ist++) destination.hypercubic()[il0][il1][il2][ist] = factor*points[ip][ist];
-					ip++;
-					
-				}
-			}
-		}
+		plans(source.basis(), destination.basis()).execute(source, destination, factor);
 
 	}
 	
@@ -170,7 +362,7 @@ basis::field_set<BasisType, Type> enlarge(basis::field_set<BasisType, Type> cons
 //////////////////////////////////////////////////////////
 		
 template <class FieldType>
-FieldType shrink(FieldType const & source, typename FieldType::basis_type const & new_basis, double const factor = 1.0) {
+FieldType shrink(FieldType const & source, typename FieldType::basis_type const & new_basis, plan_cache & plans, double const factor = 1.0) {
 
 	CALI_CXX_MARK_FUNCTION;
 	
@@ -191,45 +383,8 @@ FieldType shrink(FieldType const & source, typename FieldType::basis_type const
 
 	} else {
 
-		gpu::array<long, 1> point_list(destination.basis().local_size());
-
-		{
-			long ip = 0;
-			for(int ix = 0; ix < destination.basis().local_sizes()[0]; ix++){
-				for(int iy = 0; iy < destination.basis().local_sizes()[1]; iy++){
-					for(int iz = 0; iz < destination.basis().local_sizes()[2]; iz++){	
-
-						auto ixg = destination.basis().cubic_part(0).local_to_global(ix);
-						auto iyg = destination.basis().cubic_part(1).local_to_global(iy);
-						auto izg = destination.basis().cubic_part(2).local_to_global(iz);						
-						
-						auto ii = destination.basis().to_symmetric_range(ixg, iyg, izg);
-						auto isource = source.basis().from_symmetric_range(ii);
-						
-						point_list[ip] = source.basis().linear_index(isource[0], isource[1], isource[2]);
-						ip++;
-					}
-				}
-			}
-
-			assert(ip == point_list.size());
-		}
-
-		auto points = parallel::get_remote_points(source, point_list);
+		plans(source.basis(), destination.basis()).execute(source, destination, factor);
 
-		{
-			long ip = 0;
-			for(int ix = 0; ix < destination.basis().local_sizes()[0]; ix++){
-				for(int iy = 0; iy < destination.basis().local_sizes()[1]; iy++){
-					for(int iz = 0; iz < destination.basis().local_sizes()[2]; iz++){	
-						
-						destination.cubic()[ix][iy][iz] = factor*points[ip];
-						ip++;
-					}
-				}
-			}
-		}
-		
 	}
 
 	return destination;
@@ -238,7 +393,7 @@ FieldType shrink(FieldType const & source, typename FieldType::basis_type const
 //////////////////////////////////////////////////////////
 		
 template <class Type, class BasisType>
-basis::field_set<BasisType, Type> shrink(basis::field_set<BasisType, Type> const & source, BasisType const & new_basis, double const factor = 1.0) {
+basis::field_set<BasisType, Type> shrink(basis::field_set<BasisType, Type> const & source, BasisType const & new_basis, plan_cache & plans, double const factor = 1.0) {
 
 	CALI_CXX_MARK_FUNCTION;
 	
@@ -258,50 +413,41 @@ basis::field_set<BasisType, Type> shrink(basis::field_set<BasisType, Type> const
 		
 	} else {
 
-		gpu::array<long, 1> point_list(destination.basis().local_size());
+		plans(source.basis(), destination.basis()).execute(source, destination, factor);
+
+	}
+
+	return destination;
+}
 		
-		{
-			long ip = 0;
-			for(int ix = 0; ix < destination.basis().local_sizes()[0]; ix++){
-				for(int iy = 0; iy < destination.basis().local_sizes()[1]; iy++){
-					for(int iz = 0; iz < destination.basis().local_sizes()[2]; iz++){	
-						
-						auto ixg = destination.basis().cubic_part(0).local_to_global(ix);
-						auto iyg = destination.basis().cubic_part(1).local_to_global(iy);
-						auto izg = destination.basis().cubic_part(2).local_to_global(iz);						
-						
-						auto ii = destination.basis().to_symmetric_range(ixg, iyg, izg);
-						auto isource = source.basis().from_symmetric_range(ii);
-						
-						point_list[ip] = source.basis().linear_index(isource[0], isource[1], isource[2]);
-						ip++;
-					}
-				}
-			}
+//////////////////////////////////////////////////////////
 
-			assert(ip == point_list.size());
-		}
+// without a cache the plans are only used once
 
-		auto points = parallel::get_remote_points(source, point_list);
+template <class FieldType>
+FieldType enlarge(FieldType const & source, typename FieldType::basis_type const & new_basis, double const factor = 1.0) {
+	plan_cache plans;
+	return enlarge(source, new_basis, plans, factor);
+}
 
-		{
-			long ip = 0;
-			for(int ix = 0; ix < destination.basis().local_sizes()[0]; ix++){
-				for(int iy = 0; iy < destination.basis().local_sizes()[1]; iy++){
-					for(int iz = 0; iz < destination.basis().local_sizes()[2]; iz++){	
-						
-						for(int ist = 0; ist < source.set_part().local_size(); ist++) destination.hypercubic()[ix][iy][iz][ist] = factor*points[ip][ist];
-						ip++;
-					}
-				}
-			}
-		}
+template <class Type, class BasisType>
+basis::field_set<BasisType, Type> enlarge(basis::field_set<BasisType, Type> const & source, BasisType const & new_basis, double const factor = 1.0) {
+	plan_cache plans;
+	return enlarge(source, new_basis, plans, factor);
+}
 
-	}
+template <class FieldType>
+FieldType shrink(FieldType const & source, typename FieldType::basis_type const & new_basis, double const factor = 1.0) {
+	plan_cache plans;
+	return shrink(source, new_basis, plans, factor);
+}
 
-	return destination;
+template <class Type, class BasisType>
+basis::field_set<BasisType, Type> shrink(basis::field_set<BasisType, Type> const & source, BasisType const & new_basis, double const factor = 1.0) {
+	plan_cache plans;
+	return shrink(source, new_basis, plans, factor);
 }
-		
+
 //////////////////////////////////////////////////////////
 
 template <class FieldType,
@@ -547,6 +693,45 @@ TEMPLATE_TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG, double, inq::complex) {
 		
 	}
 
+	SECTION("Transfer plan"){
+
+		basis::real_space grid(cell, spacing, basis_comm);
+		auto large_grid = grid.enlarge(2);
+
+		operations::transfer::plan_cache plans;
+		
+		auto & enlarge_plan = plans(grid, large_grid);
+		auto & shrink_plan = plans(large_grid, grid);
+
+		CHECK(enlarge_plan.matches(grid, large_grid));
+		CHECK(not enlarge_plan.matches(large_grid, grid));
+		CHECK(shrink_plan.matches(large_grid, grid));
+
+		// the plans are reused
+		CHECK(&plans(grid, large_grid) == &enlarge_plan);
+		CHECK(&plans(large_grid, grid) == &shrink_plan);
+		CHECK(plans.size() == 2);
+
+		// the processes in a different order need another plan
+		parallel::communicator reversed_comm{basis_comm.split(0, basis_comm.size() - basis_comm.rank())};
+		basis::real_space reversed_grid(cell, spacing, reversed_comm);
+		CHECK(enlarge_plan.matches(reversed_grid, reversed_grid.enlarge(2)) == (basis_comm.size() == 1));
+
+		// copies don't share the plans
+		auto plans_copy = plans;
+		CHECK(plans_copy.size() == 0);
+
+		// every point of the small grid goes somewhere and every point of it is received once
+		auto sent = enlarge_plan.send_size();
+		auto received = shrink_plan.recv_size();
+		basis_comm.all_reduce_in_place_n(&sent, 1, std::plus<>{});
+		basis_comm.all_reduce_in_place_n(&received, 1, std::plus<>{});
+		
+		CHECK(sent == grid.size());
+		CHECK(received == grid.size());
+		CHECK(shrink_plan.recv_size() == grid.local_size());
+	}
+	
 	SECTION("Mesh refinement -- field"){
 
 		basis::real_space grid(cell, spacing, self_comm);
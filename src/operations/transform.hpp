@@ -112,12 +112,287 @@ void to_fourier_array(basis::real_space const & real_basis, basis::fourier_space
 
 ///////////////////////////////////////////////////////////////
 
+template <class OutArray4D>
+void slab_forward_transpose(basis::real_space const & real_basis, basis::fourier_space const & fourier_basis, gpu::array<complex, 4> & tmp, OutArray4D && array_fs) {
+
+	// Takes the slab-distributed array tmp, already transformed along y and z, redistributes it
+	// along z with an alltoall and does the final transform along x. tmp is released.
+	
+	CALI_CXX_MARK_FUNCTION;
+
+	namespace multi = boost::multi;
+#ifdef ENABLE_GPU
+	namespace fft = multi::fft;
+#else
+	namespace fft = multi::fftw;
+#endif
+
+	auto & comm = real_basis.comm();
+		
+	int xblock = real_basis.cubic_part(0).max_local_size();
+	int zblock = fourier_basis.cubic_part(2).max_local_size();
+	auto last_dim = std::get<3>(sizes(tmp));
+	
+	assert(std::get<2>(sizes(tmp)) == zblock*comm.size());
+	
+	CALI_MARK_BEGIN("fft_forward_transpose");   
+	gpu::array<complex, 5> buffer({comm.size(), xblock, real_basis.local_sizes()[1], zblock, last_dim});
+
+	for(int i4 = 0; i4 < comm.size(); i4++){
+		gpu::run(last_dim, zblock, real_basis.local_sizes()[1], xblock, 
+						 [i4,
+							buf = begin(buffer),
+							rot = begin(tmp.unrotated().unrotated().partitioned(comm.size()).transposed().rotated().transposed().rotated())]
+						 GPU_LAMBDA (auto i0, auto i1, auto i2, auto i3){
+							 buf[i4][i3][i2][i1][i0] = rot[i4][i3][i2][i1][i0];
+						 });
+	}
+	CALI_MARK_END("fft_forward_transpose");
+
+	assert(std::get<4>(sizes(buffer)) == last_dim);
+		
+	tmp.clear();
+
+	{
+		CALI_CXX_MARK_SCOPE("fft_forward_alltoall");
+		parallel::alltoall(buffer, comm);
+	}
+
+	{
+		CALI_CXX_MARK_SCOPE("fft_forward_1d");
+			
+		auto const fourier_x = fourier_basis.local_sizes();
+		fft::dft_forward({true, false, false, false}, buffer.flatted()({0, fourier_x[0]}, {0, fourier_x[1]}, {0, fourier_x[2]}), array_fs);
+		gpu::sync();
+	}
+	
+}
+
+///////////////////////////////////////////////////////////////
+
+template <class InArray4D>
+gpu::array<complex, 4> slab_backward_transpose(basis::fourier_space const & fourier_basis, basis::real_space const & real_basis, InArray4D const & array_fs) {
+
+	// The inverse of slab_forward_transpose: transforms along x and y, redistributes along x and
+	// returns the array that still has to be transformed along z.
+	
+	CALI_CXX_MARK_FUNCTION;
+
+	namespace multi = boost::multi;
+#ifdef ENABLE_GPU
+	namespace fft = multi::fft;
+#else
+	namespace fft = multi::fftw;
+#endif
+
+	auto & comm = fourier_basis.comm();
+
+	int xblock = real_basis.cubic_part(0).max_local_size();
+	int zblock = fourier_basis.cubic_part(2).max_local_size();
+	auto last_dim = std::get<3>(sizes(array_fs));
+		
+	gpu::array<complex, 5> buffer({comm.size(), xblock, real_basis.local_sizes()[1], zblock, last_dim});
+	gpu::prefetch(buffer);
+		
+	{
+		CALI_CXX_MARK_SCOPE("fft_backward_2d");
+			
+		fft::dft_backward({true, true, false, false}, array_fs, buffer.flatted()({0, fourier_basis.local_sizes()[0]}, {0, fourier_basis.local_sizes()[1]}, {0, fourier_basis.local_sizes()[2]}));
+		gpu::sync();
+	}
+
+	{
+		CALI_CXX_MARK_SCOPE("fft_backward_alltoall");
+		parallel::alltoall(buffer, comm);
+	}
+		
+	gpu::array<complex, 4> tmp({real_basis.local_sizes()[0], real_basis.local_sizes()[1], zblock*comm.size(), last_dim});
+	gpu::prefetch(tmp);
+		
+	{
+		CALI_CXX_MARK_SCOPE("fft_backward_transpose");
+		for(int i4 = 0; i4 < comm.size(); i4++){
+			gpu::run(last_dim, zblock, real_basis.local_sizes()[1], real_basis.local_sizes()[0],
+							 [i4, 
+								buf = begin(buffer),
+								rot = begin(tmp.unrotated().unrotated().partitioned(comm.size()).transposed().rotated().transposed().rotated())]
+							 GPU_LAMBDA (auto i0, auto i1, auto i2, auto i3){
+								 rot[i4][i3][i2][i1][i0] = buf[i4][i3][i2][i1][i0];
+							 });
+		}
+	}
+
+	return tmp;
+}
+
+///////////////////////////////////////////////////////////////
+// The pencil decomposition (basis::grid::pencil()). In real space x
+// and y are distributed over the two axes of the process grid and z
+// is local, in Fourier space x is local and y and z are
+// distributed. The transform goes through an intermediate
+// distribution where x and z are distributed, so it needs two
+// transposes, each one inside one of the sub-communicators.
+///////////////////////////////////////////////////////////////
+
+template <class InArray4D, class OutArray4D>
+void pencil_redistribute(parallel::communicator & comm, int from_dim, parallel::partition const & from_part, int to_dim, parallel::partition const & to_part,
+												 InArray4D const & source, OutArray4D && destination) {
+
+	// Redistributes an array that is distributed along from_dim (and complete along to_dim) so that
+	// it becomes distributed along to_dim (and complete along from_dim). The third dimension is not
+	// touched. The blocks are padded to the maximum local size so a plain alltoall can be used.
+	
+	CALI_CXX_MARK_FUNCTION;
+
+	assert(from_dim != to_dim);
+	assert(from_part.comm_size() == comm.size());
+	assert(to_part.comm_size() == comm.size());
+
+	auto nst = std::get<3>(sizes(source));
+	assert(std::get<3>(sizes(destination)) == nst);
+
+	vector3<int> block{int(std::get<0>(sizes(source))), int(std::get<1>(sizes(source))), int(std::get<2>(sizes(source)))};
+	block[from_dim] = from_part.max_local_size();
+	block[to_dim] = to_part.max_local_size();
+
+	gpu::array<complex, 5> buffer({comm.size(), block[0], block[1], block[2], nst});
+
+	{
+		CALI_CXX_MARK_SCOPE("pencil_redistribute_pack");
+
+		for(int iproc = 0; iproc < comm.size(); iproc++){
+			gpu::run(nst, block[2], block[1], block[0],
+							 [iproc, buf = begin(buffer), sou = begin(source), from_dim, to_dim, from_size = from_part.local_size(),
+								to_size = to_part.local_size(iproc), to_start = to_part.start(iproc)] GPU_LAMBDA (auto ist, auto i2, auto i1, auto i0){
+								 vector3<int> ii{int(i0), int(i1), int(i2)};
+								 if(ii[from_dim] >= from_size or ii[to_dim] >= to_size) {
+									 buf[iproc][i0][i1][i2][ist] = complex(0.0, 0.0);
+									 return;
+								 }
+								 ii[to_dim] += to_start;
+								 buf[iproc][i0][i1][i2][ist] = sou[ii[0]][ii[1]][ii[2]][ist];
+							 });
+		}
+	}
+
+	{
+		CALI_CXX_MARK_SCOPE("pencil_redistribute_alltoall");
+		parallel::alltoall(buffer, comm);
+	}
+
+	{
+		CALI_CXX_MARK_SCOPE("pencil_redistribute_unpack");
+
+		for(int iproc = 0; iproc < comm.size(); iproc++){
+			gpu::run(nst, block[2], block[1], block[0],
+							 [iproc, buf = begin(buffer), des = begin(destination), from_dim, to_dim, from_size = from_part.local_size(iproc),
+								from_start = from_part.start(iproc), to_size = to_part.local_size()] GPU_LAMBDA (auto ist, auto i2, auto i1, auto i0){
+								 vector3<int> ii{int(i0), int(i1), int(i2)};
+								 if(ii[from_dim] >= from_size or ii[to_dim] >= to_size) return;
+								 ii[from_dim] += from_start;
+								 des[ii[0]][ii[1]][ii[2]][ist] = buf[iproc][i0][i1][i2][ist];
+							 });
+		}
+	}
+
+}
+
+///////////////////////////////////////////////////////////////
+
+template <class InArray4D, class OutArray4D>
+void pencil_forward_transpose(basis::real_space const & real_basis, basis::fourier_space const & fourier_basis, InArray4D const & array_z, OutArray4D && array_fs) {
+
+	// Takes an array with the real-space distribution that is already transformed along z (the z
+	// dimension has the Fourier size) and does the transposes and the transforms along y and x.
+	
+	CALI_CXX_MARK_FUNCTION;
+
+	namespace multi = boost::multi;
+#ifdef ENABLE_GPU
+	namespace fft = multi::fft;
+#else
+	namespace fft = multi::fftw;
+#endif
+
+	assert(real_basis.pencil());
+	assert(std::get<2>(sizes(array_z)) == fourier_basis.cubic_part(2).size());
+	
+	auto last_dim = std::get<3>(sizes(array_z));
+
+	gpu::array<complex, 4> inter({real_basis.local_sizes()[0], real_basis.sizes()[1], fourier_basis.local_sizes()[2], last_dim});
+	pencil_redistribute(real_basis.pencil_comm(1), /* from = */ 1, real_basis.cubic_part(1), /* to = */ 2, fourier_basis.cubic_part(2), array_z, inter);
+
+	{
+		CALI_CXX_MARK_SCOPE("fft_forward_1d_y");
+		fft::dft_forward({false, true, false, false}, inter, inter);
+		gpu::sync();
+	}
+
+	pencil_redistribute(real_basis.pencil_comm(0), /* from = */ 0, real_basis.cubic_part(0), /* to = */ 1, fourier_basis.cubic_part(1), inter, array_fs);
+	inter.clear();
+	
+	{
+		CALI_CXX_MARK_SCOPE("fft_forward_1d_x");
+		fft::dft_forward({true, false, false, false}, array_fs, array_fs);
+		gpu::sync();
+	}
+}
+
+///////////////////////////////////////////////////////////////
+
+template <class InArray4D>
+gpu::array<complex, 4> pencil_backward_transpose(basis::fourier_space const & fourier_basis, basis::real_space const & real_basis, InArray4D const & array_fs) {
+
+	// The inverse of pencil_forward_transpose: transforms along x and y and returns the array with
+	// the real-space distribution that still has to be transformed along z.
+	
+	CALI_CXX_MARK_FUNCTION;
+
+	namespace multi = boost::multi;
+#ifdef ENABLE_GPU
+	namespace fft = multi::fft;
+#else
+	namespace fft = multi::fftw;
+#endif
+
+	assert(real_basis.pencil());
+
+	auto last_dim = std::get<3>(sizes(array_fs));
+	auto const fourier_x = fourier_basis.local_sizes();
+	
+	gpu::array<complex, 4> tmp({fourier_x[0], fourier_x[1], fourier_x[2], last_dim});
+
+	{
+		CALI_CXX_MARK_SCOPE("fft_backward_1d_x");
+		fft::dft_backward({true, false, false, false}, array_fs, tmp);
+		gpu::sync();
+	}
+
+	gpu::array<complex, 4> inter({real_basis.local_sizes()[0], real_basis.sizes()[1], fourier_x[2], last_dim});
+	pencil_redistribute(real_basis.pencil_comm(0), /* from = */ 1, fourier_basis.cubic_part(1), /* to = */ 0, real_basis.cubic_part(0), tmp, inter);
+	tmp.clear();
+
+	{
+		CALI_CXX_MARK_SCOPE("fft_backward_1d_y");
+		fft::dft_backward({false, true, false, false}, inter, inter);
+		gpu::sync();
+	}
+
+	gpu::array<complex, 4> array_z({real_basis.local_sizes()[0], real_basis.local_sizes()[1], fourier_basis.cubic_part(2).size(), last_dim});
+	pencil_redistribute(real_basis.pencil_comm(1), /* from = */ 2, fourier_basis.cubic_part(2), /* to = */ 1, real_basis.cubic_part(1), inter, array_z);
+	
+	return array_z;
+}
+
+///////////////////////////////////////////////////////////////
+
 template <class InArray4D, class OutArray4D>
 void to_fourier_array(basis::real_space const & real_basis, basis::fourier_space const & fourier_basis, InArray4D const & array_rs, OutArray4D && array_fs) {
 
 	CALI_CXX_MARK_FUNCTION;
 
 	assert(std::get<3>(sizes(array_rs)) == std::get<3>(sizes(array_fs)));
+	assert(not fourier_basis.half_spectrum());
 	
 	namespace multi = boost::multi;
 #ifdef ENABLE_GPU
@@ -129,74 +404,451 @@ void to_fourier_array(basis::real_space const & real_basis, basis::fourier_space
 	if(not real_basis.part().parallel()) {
 		CALI_CXX_MARK_SCOPE("fft_forward_3d");
 
-		fft::dft_forward({true, true, true, false}, array_rs, array_fs);
+		fft::dft_forward({true, true, true, false}, array_rs, array_fs);
+		gpu::sync();
+
+	} else if(real_basis.pencil()) {
+
+		auto const real_x = real_basis.local_sizes();
+		gpu::array<complex, 4> tmp({real_x[0], real_x[1], real_x[2], std::get<3>(sizes(array_rs))});
+
+		{
+			CALI_CXX_MARK_SCOPE("fft_forward_1d_z");
+			fft::dft_forward({false, false, true, false}, array_rs, tmp);
+			gpu::sync();
+		}
+
+		pencil_forward_transpose(real_basis, fourier_basis, tmp, array_fs);
+		
+	} else {
+
+		int xblock = real_basis.cubic_part(0).max_local_size();
+		int zblock = fourier_basis.cubic_part(2).max_local_size();
+		assert(real_basis.local_sizes()[1] == fourier_basis.local_sizes()[1]);
+    auto last_dim = std::get<3>(sizes(array_rs));
+
+		gpu::array<complex, 4> tmp({xblock, real_basis.local_sizes()[1], zblock*real_basis.comm().size(), last_dim});
+		
+		gpu::prefetch(tmp);
+		
+		{
+			CALI_CXX_MARK_SCOPE("fft_forward_2d");
+
+			auto const real_x = real_basis.local_sizes();
+			fft::dft_forward({false, true, true, false}, array_rs, tmp({0, real_x[0]}, {0, real_x[1]}, {0, real_x[2]}));
+			gpu::sync();
+		}
+
+		slab_forward_transpose(real_basis, fourier_basis, tmp, array_fs);
+	}
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////
+
+#ifdef ENABLE_HEFFTE
+template <class InArray4D, class OutArray4D>
+void to_real_array(basis::fourier_space const & fourier_basis, basis::real_space const & real_basis, InArray4D const & array_fs, OutArray4D && array_rs, bool normalize) {
+
+	CALI_CXX_MARK_FUNCTION;
+
+	CALI_MARK_BEGIN("heffte_initialization");
+	
+	heffte::box3d<> const rs_box = {{int(real_basis.cubic_part(2).start()), int(real_basis.cubic_part(1).start()), int(real_basis.cubic_part(0).start())},
+																	{int(real_basis.cubic_part(2).end()) - 1, int(real_basis.cubic_part(1).end()) - 1, int(real_basis.cubic_part(0).end()) - 1}};
+	
+	heffte::box3d<> const fs_box = {{int(fourier_basis.cubic_part(2).start()), int(fourier_basis.cubic_part(1).start()), int(fourier_basis.cubic_part(0).start())},
+																	{int(fourier_basis.cubic_part(2).end()) - 1, int(fourier_basis.cubic_part(1).end()) - 1, int(fourier_basis.cubic_part(0).end()) - 1}};
+
+#ifdef ENABLE_CUDA
+	heffte::fft3d<heffte::backend::cufft>
+#else
+	heffte::fft3d<heffte::backend::fftw>
+#endif
+		fft(rs_box, fs_box, real_basis.comm().get());
+
+	CALI_MARK_END("heffte_initialization");
+
+	auto scaling = heffte::scale::none;
+	if(normalize) scaling = heffte::scale::full;
+
+	// we don't need a copy when there is just one field
+	if(size(array_rs[0][0][0]) == 1) {
+		CALI_CXX_MARK_SCOPE("heffte_backward_1");
+		fft.backward((const std::complex<double> *) raw_pointer_cast(array_fs.base()), (std::complex<double> *) raw_pointer_cast(array_rs.base()), scaling);
+		return;
+	}
+	
+	gpu::array<complex, 1> input(fft.size_inbox());
+	gpu::prefetch(input); 
+	gpu::array<complex, 1> output(fft.size_outbox()); 
+	gpu::prefetch(output);
+	
+	for(int ist = 0; ist < size(array_rs[0][0][0]); ist++){
+
+		input({0, fourier_basis.local_size()}) = array_fs.flatted().flatted().transposed()[ist];
+		
+		{
+			CALI_CXX_MARK_SCOPE("heffte_backward");
+			fft.backward((const std::complex<double> *) raw_pointer_cast(input.data_elements()), (std::complex<double> *) raw_pointer_cast(output.data_elements()), scaling);
+		}
+
+		array_rs.flatted().flatted().transposed()[ist] = output({0, real_basis.local_size()});
+		
+	}
+}
+	
+#else //NO HEFTTE
+
+///////////////////////////////////////////////////////////////
+
+template <class InArray4D, class OutArray4D>
+void to_real_array(basis::fourier_space const & fourier_basis, basis::real_space const & real_basis, InArray4D const & array_fs, OutArray4D && array_rs, bool normalize) {
+
+	CALI_CXX_MARK_FUNCTION;
+
+	assert(not fourier_basis.half_spectrum());
+	
+	namespace multi = boost::multi;
+#ifdef ENABLE_GPU
+	namespace fft = multi::fft;
+#else
+	namespace fft = multi::fftw;
+#endif
+
+	if(not real_basis.part().parallel()) {
+		CALI_CXX_MARK_SCOPE("fft_backward_3d");
+
+		fft::dft_backward({true, true, true, false}, array_fs, array_rs);
+		gpu::sync();
+
+	} else if(real_basis.pencil()) {
+
+		auto tmp = pencil_backward_transpose(fourier_basis, real_basis, array_fs);
+
+		CALI_CXX_MARK_SCOPE("fft_backward_1d_z");
+		fft::dft_backward({false, false, true, false}, tmp, array_rs);
+		gpu::sync();
+
+	} else {
+
+		auto tmp = slab_backward_transpose(fourier_basis, real_basis, array_fs);
+
+		{
+			CALI_CXX_MARK_SCOPE("fft_backward_1d");
+
+			auto tmpsub = tmp({0, real_basis.local_sizes()[0]}, {0, real_basis.local_sizes()[1]}, {0, real_basis.local_sizes()[2]});
+
+#ifdef ENABLE_GPU
+			//when using cuda, do a loop explicitly over the last dimension (n1), otherwise multi makes a loop over the 2 first ones (n0 and n1). And we know that n3 << n0*n1.
+			for(auto ii : extension(tmpsub.unrotated())) {
+				fft::dft_backward({false, false, true}, tmpsub.unrotated()[ii], array_rs.unrotated()[ii]);
+			}
+#else
+			fft::dft_backward({false, false, true, false}, tmpsub, array_rs);
+#endif
+			gpu::sync();
+
+		}
+	}
+
+	if(normalize){
+		CALI_CXX_MARK_SCOPE("fft_normalize");
+		gpu::run(size(array_rs[0][0][0])*real_basis.local_size(), 
+						 [ar = begin(array_rs.flatted().flatted().flatted()), factor = 1.0/real_basis.size()] GPU_LAMBDA (auto ip){
+							 ar[ip] = factor*ar[ip];
+						 });
+	}
+}
+#endif
+
+///////////////////////////////////////////////////////////////
+
+template <class FieldSetType, class OutFieldSetType, typename = typename OutFieldSetType::basis_type>
+void to_fourier(const FieldSetType & phi, OutFieldSetType & fphi){
+
+	CALI_CXX_MARK_SCOPE("to_fourier");
+
+	assert(phi.local_set_size() == fphi.local_set_size());	
+	
+	using type = typename FieldSetType::element_type;
+	
+	if constexpr (not is_vector3<type>::value){
+		static_assert(std::is_same<type, complex>::value, "Only implemented for complex");
+		
+		to_fourier_array(phi.basis(), fphi.basis(), phi.hypercubic(), fphi.hypercubic());
+
+	} else {
+
+		static_assert(std::is_same<typename type::element_type, complex>::value, "Only implemented for complex vector3");
+		
+		auto &&    fphi_as_scalar = fphi.hypercubic().template reinterpret_array_cast<complex      >(3).rotated().rotated().rotated().flatted().rotated();
+		auto const& phi_as_scalar = phi .hypercubic().template reinterpret_array_cast<complex const>(3).rotated().rotated().rotated().flatted().rotated();
+
+		to_fourier_array(phi.basis(), fphi.basis(), phi_as_scalar, fphi_as_scalar);
+	}
+
+	// this is disabled since it causes some issues I need to check, XA
+	//	zero_outside_sphere(fphi);
+}
+
+///////////////////////////////////////////////////////////////
+
+template <class FieldSetType>
+auto to_fourier(const FieldSetType & phi){
+	auto fphi = FieldSetType::reciprocal(phi.skeleton());
+	to_fourier(phi, fphi);
+	return fphi;
+}
+
+///////////////////////////////////////////////////////////////
+
+template <class FieldSetType, class OutFieldSetType, typename = typename OutFieldSetType::basis_type>
+void to_real(const FieldSetType & fphi, OutFieldSetType & phi, bool const normalize = true){
+
+	CALI_CXX_MARK_SCOPE("to_real");
+
+	assert(not fphi.basis().half_spectrum());
+	assert(phi.local_set_size() == fphi.local_set_size());	
+	
+	using type = typename FieldSetType::element_type;
+	
+	if constexpr (not is_vector3<type>::value){
+
+		static_assert(std::is_same<type, complex>::value, "Only valid for complex");
+		
+		to_real_array(fphi.basis(), phi.basis(), fphi.hypercubic(), phi.hypercubic(), normalize);
+
+	} else {
+
+		static_assert(std::is_same<typename type::element_type, complex>::value, "Only valid for complex vector3");
+		
+		auto const& fphi_as_scalar = fphi.hypercubic().template reinterpret_array_cast<complex const>(3).rotated().rotated().rotated().flatted().rotated();
+		auto &&     phi_as_scalar  = phi .hypercubic().template reinterpret_array_cast<complex      >(3).rotated().rotated().rotated().flatted().rotated();
+		
+		to_real_array(fphi.basis(), phi.basis(), fphi_as_scalar, phi_as_scalar, normalize);
+
+	}
+}
+
+///////////////////////////////////////////////////////////////
+
+template <class FieldSetType>
+auto to_real(const FieldSetType & fphi, bool const normalize = true){
+	auto phi = FieldSetType::reciprocal(fphi.skeleton());
+	to_real(fphi, phi, normalize);
+	return phi;
+}
+
+///////////////////////////////////////////////////////////////
+// Real-to-complex transforms. For real fields only half of the
+// spectrum along z (nz/2 + 1 planes) is independent, the rest is
+// given by the Hermitian symmetry F(-G) = conj(F(G)). These
+// functions work on a half_spectrum fourier_space.
+///////////////////////////////////////////////////////////////
+
+template <class InArray4D, class OutArray4D>
+void real_to_half_spectrum_z(InArray4D const & array_rs, OutArray4D && array_hs) {
+
+	CALI_CXX_MARK_FUNCTION;
+	
+	namespace multi = boost::multi;
+#ifdef ENABLE_GPU
+	namespace fft = multi::fft;
+#else
+	namespace fft = multi::fftw;
+#endif
+
+	long n0 = std::get<0>(sizes(array_rs));
+	long n1 = std::get<1>(sizes(array_rs));
+	long nz = std::get<2>(sizes(array_rs));
+	long last_dim = std::get<3>(sizes(array_rs));
+
+	assert(std::get<2>(sizes(array_hs)) == nz/2 + 1);
+	
+	if(nz%2 == 0) {
+
+		// pack the even and odd points as the real and imaginary parts of a complex array of half the size
+		auto mz = nz/2;
+		
+		gpu::array<complex, 4> packed({n0, n1, mz, last_dim});
+		gpu::run(last_dim, mz, n1, n0,
+						 [pk = begin(packed), ar = begin(array_rs)] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+							 pk[ix][iy][iz][ist] = complex(ar[ix][iy][2*iz][ist], ar[ix][iy][2*iz + 1][ist]);
+						 });
+		
+		gpu::array<complex, 4> packed_fs({n0, n1, mz, last_dim});
+		fft::dft_forward({false, false, true, false}, packed, packed_fs);
+		gpu::sync();
+
+		// and separate the transforms of the even and odd points again
+		gpu::run(last_dim, mz + 1, n1, n0,
+						 [pk = begin(packed_fs), hs = begin(array_hs), mz] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+							 auto aa = pk[ix][iy][iz%mz][ist];
+							 auto bb = conj(pk[ix][iy][(mz - iz)%mz][ist]);
+							 hs[ix][iy][iz][ist] = 0.5*(aa + bb) + polar(1.0, -M_PI*iz/mz)*complex(0.0, -0.5)*(aa - bb);
+						 });
+		
+	} else {
+
+		// for odd sizes we do a complex transform along z, we still save the transforms along x and y
+		gpu::array<complex, 4> full({n0, n1, nz, last_dim});
+		gpu::run(last_dim, nz, n1, n0,
+						 [fu = begin(full), ar = begin(array_rs)] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+							 fu[ix][iy][iz][ist] = complex(ar[ix][iy][iz][ist], 0.0);
+						 });
+
+		gpu::array<complex, 4> full_fs({n0, n1, nz, last_dim});
+		fft::dft_forward({false, false, true, false}, full, full_fs);
+		gpu::sync();
+
+		gpu::run(last_dim, nz/2 + 1, n1, n0,
+						 [fu = begin(full_fs), hs = begin(array_hs)] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+							 hs[ix][iy][iz][ist] = fu[ix][iy][iz][ist];
+						 });
+	}
+	
+}
+
+///////////////////////////////////////////////////////////////
+
+template <class InArray4D, class OutArray4D>
+void half_spectrum_to_real_z(InArray4D const & array_hs, OutArray4D && array_rs) {
+
+	CALI_CXX_MARK_FUNCTION;
+	
+	namespace multi = boost::multi;
+#ifdef ENABLE_GPU
+	namespace fft = multi::fft;
+#else
+	namespace fft = multi::fftw;
+#endif
+
+	long n0 = std::get<0>(sizes(array_rs));
+	long n1 = std::get<1>(sizes(array_rs));
+	long nz = std::get<2>(sizes(array_rs));
+	long last_dim = std::get<3>(sizes(array_rs));
+
+	assert(std::get<2>(sizes(array_hs)) == nz/2 + 1);
+
+	// The G = 0 and Nyquist planes must be real, their imaginary part
+	// corresponds to the imaginary part of the function and it is
+	// discarded, as if we were taking the real part of a complex
+	// transform.
+	
+	if(nz%2 == 0) {
+
+		auto mz = nz/2;
+
+		gpu::array<complex, 4> packed_fs({n0, n1, mz, last_dim});
+		gpu::run(last_dim, mz, n1, n0,
+						 [pk = begin(packed_fs), hs = begin(array_hs), mz] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+							 complex aa = hs[ix][iy][iz][ist];
+							 complex bb = hs[ix][iy][mz - iz][ist];
+							 if(iz == 0) {
+								 aa = real(aa);
+								 bb = real(bb);
+							 }
+							 pk[ix][iy][iz][ist] = (aa + conj(bb)) + complex(0.0, 1.0)*polar(1.0, M_PI*iz/mz)*(aa - conj(bb));
+						 });
+
+		gpu::array<complex, 4> packed({n0, n1, mz, last_dim});
+		fft::dft_backward({false, false, true, false}, packed_fs, packed);
+		gpu::sync();
+		
+		gpu::run(last_dim, mz, n1, n0,
+						 [pk = begin(packed), ar = begin(array_rs)] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+							 ar[ix][iy][2*iz][ist] = real(pk[ix][iy][iz][ist]);
+							 ar[ix][iy][2*iz + 1][ist] = imag(pk[ix][iy][iz][ist]);
+						 });
+		
+	} else {
+
+		gpu::array<complex, 4> full_fs({n0, n1, nz, last_dim});
+		gpu::run(last_dim, nz, n1, n0,
+						 [fu = begin(full_fs), hs = begin(array_hs), nz] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+							 if(iz == 0) {
+								 fu[ix][iy][iz][ist] = real(hs[ix][iy][iz][ist]);
+							 } else if(iz <= nz/2) {
+								 fu[ix][iy][iz][ist] = hs[ix][iy][iz][ist];
+							 } else {
+								 fu[ix][iy][iz][ist] = conj(hs[ix][iy][nz - iz][ist]);
+							 }
+						 });
+
+		gpu::array<complex, 4> full({n0, n1, nz, last_dim});
+		fft::dft_backward({false, false, true, false}, full_fs, full);
 		gpu::sync();
 
-	} else {
+		gpu::run(last_dim, nz, n1, n0,
+						 [fu = begin(full), ar = begin(array_rs)] GPU_LAMBDA (auto ist, auto iz, auto iy, auto ix){
+							 ar[ix][iy][iz][ist] = real(fu[ix][iy][iz][ist]);
+						 });
+	}
+	
+}
 
-		auto & comm = real_basis.comm();
-		
-		int xblock = real_basis.cubic_part(0).max_local_size();
-		int zblock = fourier_basis.cubic_part(2).max_local_size();
-		assert(real_basis.local_sizes()[1] == fourier_basis.local_sizes()[1]);
-    auto last_dim = std::get<3>(sizes(array_rs));
+///////////////////////////////////////////////////////////////
 
-		gpu::array<complex, 4> tmp({xblock, real_basis.local_sizes()[1], zblock*comm.size(), last_dim});
-		
-		gpu::prefetch(tmp);
-		
-		{
-			CALI_CXX_MARK_SCOPE("fft_forward_2d");
+#ifdef ENABLE_HEFFTE
+template <class InArray4D, class OutArray4D>
+void to_fourier_array_r2c(basis::real_space const & real_basis, basis::fourier_space const & fourier_basis, InArray4D const & array_rs, OutArray4D && array_fs) {
 
-			auto const real_x = real_basis.local_sizes();
-			fft::dft_forward({false, true, true, false}, array_rs, tmp({0, real_x[0]}, {0, real_x[1]}, {0, real_x[2]}));
-			gpu::sync();
-		}
-		
-		CALI_MARK_BEGIN("fft_forward_transpose");   
-		gpu::array<complex, 5> buffer({comm.size(), xblock, real_basis.local_sizes()[1], zblock, last_dim});
+	CALI_CXX_MARK_FUNCTION;
 
-		for(int i4 = 0; i4 < comm.size(); i4++){
-			gpu::run(last_dim, zblock, real_basis.local_sizes()[1], xblock, 
-							 [i4,
-								buf = begin(buffer),
-								rot = begin(tmp.unrotated().unrotated().partitioned(comm.size()).transposed().rotated().transposed().rotated())]
-							 GPU_LAMBDA (auto i0, auto i1, auto i2, auto i3){
-								 buf[i4][i3][i2][i1][i0] = rot[i4][i3][i2][i1][i0];
-							 });
-		}
-		CALI_MARK_END("fft_forward_transpose");
+	assert(fourier_basis.half_spectrum());
+	assert(std::get<3>(sizes(array_rs)) == std::get<3>(sizes(array_fs)));
+	
+	CALI_MARK_BEGIN("heffte_initialization");
+ 
+	heffte::box3d<> const rs_box = {{int(real_basis.cubic_part(2).start()), int(real_basis.cubic_part(1).start()), int(real_basis.cubic_part(0).start())},
+																	{int(real_basis.cubic_part(2).end()) - 1, int(real_basis.cubic_part(1).end()) - 1, int(real_basis.cubic_part(0).end()) - 1}};
+	
+	heffte::box3d<> const fs_box = {{int(fourier_basis.cubic_part(2).start()), int(fourier_basis.cubic_part(1).start()), int(fourier_basis.cubic_part(0).start())},
+																	{int(fourier_basis.cubic_part(2).end()) - 1, int(fourier_basis.cubic_part(1).end()) - 1, int(fourier_basis.cubic_part(0).end()) - 1}};
 
-		assert(std::get<4>(sizes(buffer)) == last_dim);
-		
-		tmp.clear();
+	// heffte uses the reverse order for the dimensions, so the z direction is 0
+#ifdef ENABLE_CUDA
+	heffte::fft3d_r2c<heffte::backend::cufft>
+#else
+	heffte::fft3d_r2c<heffte::backend::fftw>
+#endif
+		fft(rs_box, fs_box, /* r2c_direction = */ 0, real_basis.comm().get());
 
-		{
-			CALI_CXX_MARK_SCOPE("fft_forward_alltoall");
-			parallel::alltoall(buffer, comm);
-		}
+	CALI_MARK_END("heffte_initialization");
+
+	if(size(array_rs[0][0][0]) == 1) {
+		CALI_CXX_MARK_SCOPE("heffte_forward_r2c_1");
+		fft.forward((const double *) raw_pointer_cast(array_rs.base()), (std::complex<double> *) raw_pointer_cast(array_fs.base()));
+		return;
+	}
+	
+	gpu::array<double, 1> input(fft.size_inbox());
+	gpu::prefetch(input);
+	gpu::array<complex, 1> output(fft.size_outbox()); 
+	gpu::prefetch(output);
 
+	for(int ist = 0; ist < size(array_rs[0][0][0]); ist++){
+		input({0, real_basis.local_size()}) = array_rs.flatted().flatted().transposed()[ist];
 		{
-			CALI_CXX_MARK_SCOPE("fft_forward_1d");
-			
-			auto const fourier_x = fourier_basis.local_sizes();
-			fft::dft_forward({true, false, false, false}, buffer.flatted()({0, fourier_x[0]}, {0, fourier_x[1]}, {0, fourier_x[2]}), array_fs);
-			gpu::sync();
+			CALI_CXX_MARK_SCOPE("heffte_forward_r2c");
+			fft.forward((const double *) raw_pointer_cast(input.data_elements()), (std::complex<double> *) raw_pointer_cast(output.data_elements()));
 		}
-
+		array_fs.flatted().flatted().transposed()[ist] = output({0, fourier_basis.local_size()});
 	}
-}
 
-#endif
+}
 
 ///////////////////////////////////////////////////////////////
 
-#ifdef ENABLE_HEFFTE
 template <class InArray4D, class OutArray4D>
-void to_real_array(basis::fourier_space const & fourier_basis, basis::real_space const & real_basis, InArray4D const & array_fs, OutArray4D && array_rs, bool normalize) {
+void to_real_array_c2r(basis::fourier_space const & fourier_basis, basis::real_space const & real_basis, InArray4D const & array_fs, OutArray4D && array_rs, bool normalize) {
 
 	CALI_CXX_MARK_FUNCTION;
 
+	assert(fourier_basis.half_spectrum());
+	
 	CALI_MARK_BEGIN("heffte_initialization");
 	
 	heffte::box3d<> const rs_box = {{int(real_basis.cubic_part(2).start()), int(real_basis.cubic_part(1).start()), int(real_basis.cubic_part(0).start())},
@@ -206,52 +858,50 @@ void to_real_array(basis::fourier_space const & fourier_basis, basis::real_space
 																	{int(fourier_basis.cubic_part(2).end()) - 1, int(fourier_basis.cubic_part(1).end()) - 1, int(fourier_basis.cubic_part(0).end()) - 1}};
 
 #ifdef ENABLE_CUDA
-	heffte::fft3d<heffte::backend::cufft>
+	heffte::fft3d_r2c<heffte::backend::cufft>
 #else
-	heffte::fft3d<heffte::backend::fftw>
+	heffte::fft3d_r2c<heffte::backend::fftw>
 #endif
-		fft(rs_box, fs_box, real_basis.comm().get());
+		fft(rs_box, fs_box, /* r2c_direction = */ 0, real_basis.comm().get());
 
 	CALI_MARK_END("heffte_initialization");
 
 	auto scaling = heffte::scale::none;
 	if(normalize) scaling = heffte::scale::full;
 
-	// we don't need a copy when there is just one field
 	if(size(array_rs[0][0][0]) == 1) {
-		CALI_CXX_MARK_SCOPE("heffte_backward_1");
-		fft.backward((const std::complex<double> *) raw_pointer_cast(array_fs.base()), (std::complex<double> *) raw_pointer_cast(array_rs.base()), scaling);
+		CALI_CXX_MARK_SCOPE("heffte_backward_c2r_1");
+		fft.backward((const std::complex<double> *) raw_pointer_cast(array_fs.base()), (double *) raw_pointer_cast(array_rs.base()), scaling);
 		return;
 	}
 	
-	gpu::array<complex, 1> input(fft.size_inbox());
+	gpu::array<complex, 1> input(fft.size_outbox());
 	gpu::prefetch(input); 
-	gpu::array<complex, 1> output(fft.size_outbox()); 
+	gpu::array<double, 1> output(fft.size_inbox()); 
 	gpu::prefetch(output);
 	
 	for(int ist = 0; ist < size(array_rs[0][0][0]); ist++){
-
 		input({0, fourier_basis.local_size()}) = array_fs.flatted().flatted().transposed()[ist];
-		
 		{
-			CALI_CXX_MARK_SCOPE("heffte_backward");
-			fft.backward((const std::complex<double> *) raw_pointer_cast(input.data_elements()), (std::complex<double> *) raw_pointer_cast(output.data_elements()), scaling);
+			CALI_CXX_MARK_SCOPE("heffte_backward_c2r");
+			fft.backward((const std::complex<double> *) raw_pointer_cast(input.data_elements()), (double *) raw_pointer_cast(output.data_elements()), scaling);
 		}
-
 		array_rs.flatted().flatted().transposed()[ist] = output({0, real_basis.local_size()});
-		
 	}
 }
-	
-#else //NO HEFTTE
+
+#else // no HEFFTE
 
 ///////////////////////////////////////////////////////////////
 
 template <class InArray4D, class OutArray4D>
-void to_real_array(basis::fourier_space const & fourier_basis, basis::real_space const & real_basis, InArray4D const & array_fs, OutArray4D && array_rs, bool normalize) {
+void to_fourier_array_r2c(basis::real_space const & real_basis, basis::fourier_space const & fourier_basis, InArray4D const & array_rs, OutArray4D && array_fs) {
 
 	CALI_CXX_MARK_FUNCTION;
 
+	assert(fourier_basis.half_spectrum());
+	assert(std::get<3>(sizes(array_rs)) == std::get<3>(sizes(array_fs)));
+	
 	namespace multi = boost::multi;
 #ifdef ENABLE_GPU
 	namespace fft = multi::fft;
@@ -259,67 +909,93 @@ void to_real_array(basis::fourier_space const & fourier_basis, basis::real_space
 	namespace fft = multi::fftw;
 #endif
 
+	auto const real_x = real_basis.local_sizes();
+	auto const nzh = fourier_basis.cubic_part(2).size();
+	auto last_dim = std::get<3>(sizes(array_rs));
+
+	gpu::array<complex, 4> half({real_x[0], real_x[1], nzh, last_dim});
+
+	{
+		CALI_CXX_MARK_SCOPE("fft_forward_r2c_z");
+		real_to_half_spectrum_z(array_rs, half);
+	}
+	
 	if(not real_basis.part().parallel()) {
-		CALI_CXX_MARK_SCOPE("fft_backward_3d");
+		CALI_CXX_MARK_SCOPE("fft_forward_2d");
 
-		fft::dft_backward({true, true, true, false}, array_fs, array_rs);
+		fft::dft_forward({true, true, false, false}, half, array_fs);
 		gpu::sync();
 
-	} else {
+	} else if(real_basis.pencil()) {
 
-		auto & comm = fourier_basis.comm();
+		pencil_forward_transpose(real_basis, fourier_basis, half, array_fs);
+		
+	} else {
 
 		int xblock = real_basis.cubic_part(0).max_local_size();
 		int zblock = fourier_basis.cubic_part(2).max_local_size();
-		auto last_dim = std::get<3>(sizes(array_fs));
-		
-		gpu::array<complex, 5> buffer({comm.size(), xblock, real_basis.local_sizes()[1], zblock, last_dim});
-		gpu::prefetch(buffer);
-		
+
+		gpu::array<complex, 4> tmp({xblock, real_x[1], zblock*real_basis.comm().size(), last_dim});
+		gpu::prefetch(tmp);
+
 		{
-			CALI_CXX_MARK_SCOPE("fft_backward_2d");
+			CALI_CXX_MARK_SCOPE("fft_forward_1d_y");
 			
-			fft::dft_backward({true, true, false, false}, array_fs, buffer.flatted()({0, fourier_basis.local_sizes()[0]}, {0, fourier_basis.local_sizes()[1]}, {0, fourier_basis.local_sizes()[2]}));
+			fft::dft_forward({false, true, false, false}, half, tmp({0, real_x[0]}, {0, real_x[1]}, {0, nzh}));
 			gpu::sync();
 		}
 
-		{
-			CALI_CXX_MARK_SCOPE("fft_backward_alltoall");
-			parallel::alltoall(buffer, comm);
-		}
-		
-		gpu::array<complex, 4> tmp({real_basis.local_sizes()[0], real_basis.local_sizes()[1], zblock*comm.size(), last_dim});
-		gpu::prefetch(tmp);
+		half.clear();
 		
-		{
-			CALI_CXX_MARK_SCOPE("fft_backward_transpose");
-			for(int i4 = 0; i4 < comm.size(); i4++){
-				gpu::run(last_dim, zblock, real_basis.local_sizes()[1], real_basis.local_sizes()[0],
-								 [i4, 
-									buf = begin(buffer),
-									rot = begin(tmp.unrotated().unrotated().partitioned(comm.size()).transposed().rotated().transposed().rotated())]
-								 GPU_LAMBDA (auto i0, auto i1, auto i2, auto i3){
-									 rot[i4][i3][i2][i1][i0] = buf[i4][i3][i2][i1][i0];
-								 });
-			}
-		}
+		slab_forward_transpose(real_basis, fourier_basis, tmp, array_fs);
+	}
+}
 
-		{
-			CALI_CXX_MARK_SCOPE("fft_backward_1d");
+///////////////////////////////////////////////////////////////
 
-			auto tmpsub = tmp({0, real_basis.local_sizes()[0]}, {0, real_basis.local_sizes()[1]}, {0, real_basis.local_sizes()[2]});
+template <class InArray4D, class OutArray4D>
+void to_real_array_c2r(basis::fourier_space const & fourier_basis, basis::real_space const & real_basis, InArray4D const & array_fs, OutArray4D && array_rs, bool normalize) {
+
+	CALI_CXX_MARK_FUNCTION;
 
+	assert(fourier_basis.half_spectrum());
+	
+	namespace multi = boost::multi;
 #ifdef ENABLE_GPU
-			//when using cuda, do a loop explicitly over the last dimension (n1), otherwise multi makes a loop over the 2 first ones (n0 and n1). And we know that n3 << n0*n1.
-			for(auto ii : extension(tmpsub.unrotated())) {
-				fft::dft_backward({false, false, true}, tmpsub.unrotated()[ii], array_rs.unrotated()[ii]);
-			}
+	namespace fft = multi::fft;
 #else
-			fft::dft_backward({false, false, true, false}, tmpsub, array_rs);
+	namespace fft = multi::fftw;
 #endif
-			gpu::sync();
 
+	auto const real_x = real_basis.local_sizes();
+	auto const nzh = fourier_basis.cubic_part(2).size();
+	
+	if(not real_basis.part().parallel()) {
+
+		gpu::array<complex, 4> half({real_x[0], real_x[1], nzh, std::get<3>(sizes(array_fs))});
+		
+		{
+			CALI_CXX_MARK_SCOPE("fft_backward_2d");
+			fft::dft_backward({true, true, false, false}, array_fs, half);
+			gpu::sync();
 		}
+
+		CALI_CXX_MARK_SCOPE("fft_backward_c2r_z");
+		half_spectrum_to_real_z(half, array_rs);
+		
+	} else if(real_basis.pencil()) {
+
+		auto half = pencil_backward_transpose(fourier_basis, real_basis, array_fs);
+
+		CALI_CXX_MARK_SCOPE("fft_backward_c2r_z");
+		half_spectrum_to_real_z(half, array_rs);
+		
+	} else {
+
+		auto tmp = slab_backward_transpose(fourier_basis, real_basis, array_fs);
+
+		CALI_CXX_MARK_SCOPE("fft_backward_c2r_z");
+		half_spectrum_to_real_z(tmp({0, real_x[0]}, {0, real_x[1]}, {0, nzh}), array_rs);
 	}
 
 	if(normalize){
@@ -330,51 +1006,114 @@ void to_real_array(basis::fourier_space const & fourier_basis, basis::real_space
 						 });
 	}
 }
+
 #endif
 
 ///////////////////////////////////////////////////////////////
 
-template <class FieldSetType>
-auto to_fourier(const FieldSetType & phi){
+template <typename Type>
+struct complex_type {
+	using type = complex;
+};
 
-	CALI_CXX_MARK_SCOPE("to_fourier");
+template <typename Space>
+struct complex_type<vector3<double, Space>> {
+	using type = vector3<complex, Space>;
+};
 
-	auto fphi = FieldSetType::reciprocal(phi.skeleton());
+template <typename Type>
+struct real_type {
+	using type = double;
+};
+
+template <typename Space>
+struct real_type<vector3<complex, Space>> {
+	using type = vector3<double, Space>;
+};
+
+///////////////////////////////////////////////////////////////
+
+template <typename Type>
+auto half_spectrum_field(basis::field<basis::real_space, Type> const & phi){
+	using ctype = typename complex_type<Type>::type;
+	return basis::field<basis::fourier_space, ctype>(basis::fourier_space(phi.basis(), /* half_spectrum = */ true));
+}
+
+template <typename Type>
+auto half_spectrum_field(basis::field_set<basis::real_space, Type> const & phi){
+	using ctype = typename complex_type<Type>::type;
+	return basis::field_set<basis::fourier_space, ctype>(basis::fourier_space(phi.basis(), /* half_spectrum = */ true), phi.set_size(), phi.full_comm());
+}
+
+template <typename Type>
+auto half_spectrum_field(states::orbital_set<basis::real_space, Type> const & phi){
+	using ctype = typename complex_type<Type>::type;
+	return states::orbital_set<basis::fourier_space, ctype>(basis::fourier_space(phi.basis(), /* half_spectrum = */ true), phi.spinor_set_size(), phi.spinor_dim(), phi.kpoint(), phi.spin_index(), phi.full_comm());
+}
+
+template <typename Type>
+auto real_space_field(basis::field<basis::fourier_space, Type> const & fphi){
+	using rtype = typename real_type<Type>::type;
+	return basis::field<basis::real_space, rtype>(basis::real_space(fphi.basis()));
+}
+
+template <typename Type>
+auto real_space_field(basis::field_set<basis::fourier_space, Type> const & fphi){
+	using rtype = typename real_type<Type>::type;
+	return basis::field_set<basis::real_space, rtype>(basis::real_space(fphi.basis()), fphi.set_size(), fphi.full_comm());
+}
 
+template <typename Type>
+auto real_space_field(states::orbital_set<basis::fourier_space, Type> const & fphi){
+	using rtype = typename real_type<Type>::type;
+	return states::orbital_set<basis::real_space, rtype>(basis::real_space(fphi.basis()), fphi.spinor_set_size(), fphi.spinor_dim(), fphi.kpoint(), fphi.spin_index(), fphi.full_comm());
+}
+
+///////////////////////////////////////////////////////////////
+
+template <class FieldSetType, class OutFieldSetType, typename = typename OutFieldSetType::basis_type>
+void to_fourier_r2c(const FieldSetType & phi, OutFieldSetType & fphi){
+
+	CALI_CXX_MARK_SCOPE("to_fourier_r2c");
+
+	assert(fphi.basis().half_spectrum());
 	assert(phi.local_set_size() == fphi.local_set_size());	
 	
 	using type = typename FieldSetType::element_type;
 	
 	if constexpr (not is_vector3<type>::value){
-		static_assert(std::is_same<type, complex>::value, "Only implemented for complex");
+		static_assert(std::is_same<type, double>::value, "Only implemented for double");
 		
-		to_fourier_array(phi.basis(), fphi.basis(), phi.hypercubic(), fphi.hypercubic());
+		to_fourier_array_r2c(phi.basis(), fphi.basis(), phi.hypercubic(), fphi.hypercubic());
 
 	} else {
 
-		static_assert(std::is_same<typename type::element_type, complex>::value, "Only implemented for complex vector3");
+		static_assert(std::is_same<typename type::element_type, double>::value, "Only implemented for double vector3");
 		
 		auto &&    fphi_as_scalar = fphi.hypercubic().template reinterpret_array_cast<complex      >(3).rotated().rotated().rotated().flatted().rotated();
-		auto const& phi_as_scalar = phi .hypercubic().template reinterpret_array_cast<complex const>(3).rotated().rotated().rotated().flatted().rotated();
+		auto const& phi_as_scalar = phi .hypercubic().template reinterpret_array_cast<double const>(3).rotated().rotated().rotated().flatted().rotated();
 
-		to_fourier_array(phi.basis(), fphi.basis(), phi_as_scalar, fphi_as_scalar);
+		to_fourier_array_r2c(phi.basis(), fphi.basis(), phi_as_scalar, fphi_as_scalar);
 	}
-
-	// this is disabled since it causes some issues I need to check, XA
-	//	zero_outside_sphere(fphi);
-	
-	return fphi;
 }
 
 ///////////////////////////////////////////////////////////////
 
 template <class FieldSetType>
-auto to_real(const FieldSetType & fphi, bool const normalize = true){
+auto to_fourier_r2c(const FieldSetType & phi){
+	auto fphi = half_spectrum_field(phi);
+	to_fourier_r2c(phi, fphi);
+	return fphi;
+}
 
-	CALI_CXX_MARK_SCOPE("to_real");
+///////////////////////////////////////////////////////////////
 
-	auto phi = FieldSetType::reciprocal(fphi.skeleton());
+template <class FieldSetType, class OutFieldSetType, typename = typename OutFieldSetType::basis_type>
+void to_real_c2r(const FieldSetType & fphi, OutFieldSetType & phi, bool const normalize = true){
 
+	CALI_CXX_MARK_SCOPE("to_real_c2r");
+
+	assert(fphi.basis().half_spectrum());
 	assert(phi.local_set_size() == fphi.local_set_size());	
 	
 	using type = typename FieldSetType::element_type;
@@ -383,19 +1122,26 @@ auto to_real(const FieldSetType & fphi, bool const normalize = true){
 
 		static_assert(std::is_same<type, complex>::value, "Only valid for complex");
 		
-		to_real_array(fphi.basis(), phi.basis(), fphi.hypercubic(), phi.hypercubic(), normalize);
+		to_real_array_c2r(fphi.basis(), phi.basis(), fphi.hypercubic(), phi.hypercubic(), normalize);
 
 	} else {
 
 		static_assert(std::is_same<typename type::element_type, complex>::value, "Only valid for complex vector3");
 		
 		auto const& fphi_as_scalar = fphi.hypercubic().template reinterpret_array_cast<complex const>(3).rotated().rotated().rotated().flatted().rotated();
-		auto &&     phi_as_scalar  = phi .hypercubic().template reinterpret_array_cast<complex      >(3).rotated().rotated().rotated().flatted().rotated();
+		auto &&     phi_as_scalar  = phi .hypercubic().template reinterpret_array_cast<double       >(3).rotated().rotated().rotated().flatted().rotated();
 		
-		to_real_array(fphi.basis(), phi.basis(), fphi_as_scalar, phi_as_scalar, normalize);
+		to_real_array_c2r(fphi.basis(), phi.basis(), fphi_as_scalar, phi_as_scalar, normalize);
 
 	}
-	
+}
+
+///////////////////////////////////////////////////////////////
+
+template <class FieldSetType>
+auto to_real_c2r(const FieldSetType & fphi, bool const normalize = true){
+	auto phi = real_space_field(fphi);
+	to_real_c2r(fphi, phi, normalize);
 	return phi;
 }
 
@@ -543,7 +1289,159 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		CHECK(diff < 1e-15);
 		
 	}
+
+	SECTION("Real to complex"){
+
+		// the z dimension is even in the first basis and odd in the second one
+		for(auto rbasis : {rs, basis::real_space(systems::cell::orthorhombic(6.66_b, 6.66_b, 7.0_b), /*spacing =*/ 0.46320257, basis_comm)}) {
+			
+			basis::field_set<basis::real_space, double> rphi(rbasis, 3, cart_comm);
+			
+			for(int ix = 0; ix < rbasis.local_sizes()[0]; ix++){
+				for(int iy = 0; iy < rbasis.local_sizes()[1]; iy++){
+					for(int iz = 0; iz < rbasis.local_sizes()[2]; iz++){
+						auto rr = rbasis.point_op().rvector_cartesian(ix, iy, iz);
+						for(int ist = 0; ist < rphi.set_part().local_size(); ist++){
+							double sigma = 0.5*(ist + 1);
+							rphi.hypercubic()[ix][iy][iz][ist] = (1.0 + 0.3*rr[0] - 0.2*rr[2])*exp(-sigma*norm(rr - vector3<double>{0.1, -0.2, 0.3}));
+						}
+					}
+				}
+			}
+
+			auto hphi = operations::transform::to_fourier_r2c(rphi);
+			auto fphi = operations::transform::to_fourier(complex_field(rphi));
+
+			CHECK(hphi.basis().half_spectrum());
+			CHECK(hphi.basis().cubic_part(2).size() == rbasis.sizes()[2]/2 + 1);
+		
+			double diff = 0.0;
+			for(int ix = 0; ix < hphi.basis().local_sizes()[0]; ix++){
+				for(int iy = 0; iy < hphi.basis().local_sizes()[1]; iy++){
+					for(int iz = 0; iz < hphi.basis().local_sizes()[2]; iz++){
+						auto izg = hphi.basis().cubic_part(2).local_to_global(iz);
+						if(not fphi.basis().cubic_part(2).contains(izg)) continue;
+						auto izf = fphi.basis().cubic_part(2).global_to_local(izg);
+						for(int ist = 0; ist < rphi.set_part().local_size(); ist++){
+							diff += fabs(hphi.hypercubic()[ix][iy][iz][ist] - fphi.hypercubic()[ix][iy][izf][ist]);
+						}
+					}
+				}
+			}
+
+			cart_comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+			diff /= hphi.hypercubic().num_elements();
+			
+			CHECK(diff < 1e-12);
+
+			auto rphi2 = operations::transform::to_real_c2r(hphi);
+
+			static_assert(std::is_same_v<decltype(rphi2), basis::field_set<basis::real_space, double>>, "c2r should return a real field_set");
+			
+			diff = 0.0;
+			for(int ix = 0; ix < rbasis.local_sizes()[0]; ix++){
+				for(int iy = 0; iy < rbasis.local_sizes()[1]; iy++){
+					for(int iz = 0; iz < rbasis.local_sizes()[2]; iz++){
+						for(int ist = 0; ist < rphi.set_part().local_size(); ist++){
+							diff += fabs(rphi.hypercubic()[ix][iy][iz][ist] - rphi2.hypercubic()[ix][iy][iz][ist]);
+						}
+					}
+				}
+			}
+
+			cart_comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+			diff /= rphi2.hypercubic().num_elements();
+		
+			CHECK(diff < 1e-15);
+		}
+	}
+
+	SECTION("Pencil decomposition"){
+
+		auto pencil_nproc = (basis_comm.size()%2 == 0) ? 2 : basis_comm.size();
+		
+		basis::real_space prs(systems::cell::orthorhombic(6.66_b, 6.66_b, 7.0_b), /*spacing =*/ 0.46320257, basis_comm, pencil_nproc);
+
+		CHECK(prs.pencil() == (basis_comm.size() > 1));
+		
+		auto nr = prs.sizes();
+		
+		// a single plane wave goes to a single coefficient
+		int const kx = 2;
+		int const ky = 5;
+		int const kz = 3;
+
+		basis::field_set<basis::real_space, complex> pphi(prs, 3, cart_comm);
+		basis::field_set<basis::real_space, double> rphi(prs, 3, cart_comm);
+		
+		for(int ix = 0; ix < prs.local_sizes()[0]; ix++){
+			for(int iy = 0; iy < prs.local_sizes()[1]; iy++){
+				for(int iz = 0; iz < prs.local_sizes()[2]; iz++){
+					auto ixg = prs.cubic_part(0).local_to_global(ix).value();
+					auto iyg = prs.cubic_part(1).local_to_global(iy).value();
+					auto izg = prs.cubic_part(2).local_to_global(iz).value();
+					auto phase = 2.0*M_PI*(kx*ixg/double(nr[0]) + ky*iyg/double(nr[1]) + kz*izg/double(nr[2]));
+					for(int ist = 0; ist < pphi.set_part().local_size(); ist++) {
+						pphi.hypercubic()[ix][iy][iz][ist] = (1.0 + ist)*complex(cos(phase), sin(phase));
+						rphi.hypercubic()[ix][iy][iz][ist] = (1.0 + ist)*cos(phase);
+					}
+				}
+			}
+		}
+
+		auto fphi = operations::transform::to_fourier(pphi);
+		auto hphi = operations::transform::to_fourier_r2c(rphi);
+
+		CHECK(fphi.basis().pencil() == prs.pencil());
+		
+		double diff = 0.0;
+		for(int ix = 0; ix < fphi.basis().local_sizes()[0]; ix++){
+			for(int iy = 0; iy < fphi.basis().local_sizes()[1]; iy++){
+				for(int iz = 0; iz < fphi.basis().local_sizes()[2]; iz++){
+					auto ixg = fphi.basis().cubic_part(0).local_to_global(ix).value();
+					auto iyg = fphi.basis().cubic_part(1).local_to_global(iy).value();
+					auto izg = fphi.basis().cubic_part(2).local_to_global(iz).value();
+					auto expected = (ixg == kx and iyg == ky and izg == kz) ? double(prs.size()) : 0.0;
+					for(int ist = 0; ist < fphi.set_part().local_size(); ist++) diff += fabs(fphi.hypercubic()[ix][iy][iz][ist] - (1.0 + ist)*expected);
+				}
+			}
+		}
+
+		for(int ix = 0; ix < hphi.basis().local_sizes()[0]; ix++){
+			for(int iy = 0; iy < hphi.basis().local_sizes()[1]; iy++){
+				for(int iz = 0; iz < hphi.basis().local_sizes()[2]; iz++){
+					auto ixg = hphi.basis().cubic_part(0).local_to_global(ix).value();
+					auto iyg = hphi.basis().cubic_part(1).local_to_global(iy).value();
+					auto izg = hphi.basis().cubic_part(2).local_to_global(iz).value();
+					auto expected = (ixg == kx and iyg == ky and izg == kz) ? 0.5*prs.size() : 0.0;
+					for(int ist = 0; ist < hphi.set_part().local_size(); ist++) diff += fabs(hphi.hypercubic()[ix][iy][iz][ist] - (1.0 + ist)*expected);
+				}
+			}
+		}
+		
+		cart_comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+		CHECK(diff < 1e-8);
+
+		auto pphi2 = operations::transform::to_real(fphi);
+		auto rphi2 = operations::transform::to_real_c2r(hphi);
+
+		diff = 0.0;
+		for(int ix = 0; ix < prs.local_sizes()[0]; ix++){
+			for(int iy = 0; iy < prs.local_sizes()[1]; iy++){
+				for(int iz = 0; iz < prs.local_sizes()[2]; iz++){
+					for(int ist = 0; ist < pphi.set_part().local_size(); ist++) {
+						diff += fabs(pphi.hypercubic()[ix][iy][iz][ist] - pphi2.hypercubic()[ix][iy][iz][ist]);
+						diff += fabs(rphi.hypercubic()[ix][iy][iz][ist] - rphi2.hypercubic()[ix][iy][iz][ist]);
+					}
+				}
+			}
+		}
+		
+		cart_comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+		CHECK(diff < 1e-10);
+	}
 	
 }
 #endif
 
+
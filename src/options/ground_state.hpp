@@ -22,11 +22,13 @@ class ground_state {
 
 public:
 
-	enum class scf_eigensolver { STEEPEST_DESCENT };
+	enum class scf_eigensolver { STEEPEST_DESCENT, CHEBYSHEV_FILTER, RMM_DIIS };
 
 	template<class OStream>
 	friend OStream & operator<<(OStream & out, scf_eigensolver const & self){
 		if(self == scf_eigensolver::STEEPEST_DESCENT) out << "steepest_descent";
+		if(self == scf_eigensolver::CHEBYSHEV_FILTER) out << "chebyshev_filter";
+		if(self == scf_eigensolver::RMM_DIIS)         out << "rmm_diis";
 		return out;
 	}
 
@@ -36,18 +38,23 @@ public:
 		in >> readval;
 		if(readval == "steepest_descent"){
 			self = scf_eigensolver::STEEPEST_DESCENT;
+		} else if(readval == "chebyshev_filter"){
+			self = scf_eigensolver::CHEBYSHEV_FILTER;
+		} else if(readval == "rmm_diis"){
+			self = scf_eigensolver::RMM_DIIS;
 		} else {
 			throw std::runtime_error("INQ error: Invalid eigensolver");
 		}
 		return in;
 	}
 
-	enum class mixing_algo { LINEAR, BROYDEN };
+	enum class mixing_algo { LINEAR, BROYDEN, PULAY };
 
 	template<class OStream>
 	friend OStream & operator<<(OStream & out, mixing_algo const & self){
 		if(self == mixing_algo::LINEAR)     out << "linear";
 		if(self == mixing_algo::BROYDEN)    out << "broyden";
+		if(self == mixing_algo::PULAY)      out << "pulay";
 		return out;
 	}
 
@@ -58,7 +65,9 @@ public:
 		if(readval == "linear"){
 			self = mixing_algo::LINEAR;
 		} else if(readval == "broyden"){
-			self = mixing_algo::LINEAR;
+			self = mixing_algo::BROYDEN;
+		} else if(readval == "pulay"){
+			self = mixing_algo::PULAY;
 		} else {
 			throw std::runtime_error("INQ error: Invalid mixing algorithm");
 		}
@@ -75,6 +84,10 @@ private:
 	std::optional<bool> subspace_diag_;
 	std::optional<int> max_steps_;
 	std::optional<bool> calc_forces_;
+	std::optional<bool> real_orbitals_;
+	std::optional<double> kerker_;
+	std::optional<bool> band_locking_;
+	std::optional<bool> lcao_guess_;
 	
 public:
 
@@ -84,6 +97,18 @@ public:
 		return solver;
 	}
 
+	auto chebyshev_filter(){
+		ground_state solver = *this;;
+		solver.eigensolver_ = scf_eigensolver::CHEBYSHEV_FILTER;
+		return solver;
+	}
+
+	auto rmm_diis(){
+		ground_state solver = *this;;
+		solver.eigensolver_ = scf_eigensolver::RMM_DIIS;
+		return solver;
+	}
+
 	auto eigensolver() const {
 		return eigensolver_.value_or(scf_eigensolver::STEEPEST_DESCENT);
 	}
@@ -120,6 +145,25 @@ public:
 		return solver;
 	}
 		
+	auto pulay_mixing(){
+		ground_state solver = *this;;
+		solver.mixing_algo_ = mixing_algo::PULAY;
+		return solver;
+	}
+
+	// Precondition the density residual with the Kerker factor G^2/(G^2 + q0^2), the argument is q0 in atomic units
+	auto kerker_preconditioner(double screening_wavevector = 0.8){
+		assert(screening_wavevector > 0.0);
+		ground_state solver = *this;;
+		solver.kerker_ = screening_wavevector;
+		return solver;
+	}
+
+	// zero means that there is no preconditioner
+	auto kerker_screening() const {
+		return kerker_.value_or(0.0);
+	}
+	
 	auto mixing_algorithm() const {
 		return mixing_algo_.value_or(mixing_algo::BROYDEN);
 	}
@@ -164,6 +208,39 @@ public:
 		return calc_forces_.value_or(false);
 	}
 
+	// Use real orbitals in the eigensolver, only valid when the only k-point is Gamma
+	auto real_orbitals() {
+		ground_state solver = *this;;
+		solver.real_orbitals_ = true;
+		return solver;
+	}
+		
+	auto use_real_orbitals() const {
+		return real_orbitals_.value_or(false);
+	}
+
+	// Lock the bands that are converged to the accuracy of the current density in the steepest descent eigensolver
+	auto band_locking() {
+		ground_state solver = *this;;
+		solver.band_locking_ = true;
+		return solver;
+	}
+		
+	auto use_band_locking() const {
+		return band_locking_.value_or(false);
+	}
+
+	// Replace the orbitals by the lowest eigenvectors of the Hamiltonian in a basis of atomic orbitals before the first iteration
+	auto lcao_initial_guess() {
+		ground_state solver = *this;;
+		solver.lcao_guess_ = true;
+		return solver;
+	}
+		
+	auto use_lcao_initial_guess() const {
+		return lcao_guess_.value_or(false);
+	}
+
 	void save(parallel::communicator & comm, std::string const & dirname) const {
 		auto error_message = "INQ error: Cannot save the options::ground_state to directory '" + dirname + "'.";
 
@@ -176,6 +253,10 @@ public:
 		utils::save_optional(comm, dirname + "/subspace_diag",    subspace_diag_, error_message);
 		utils::save_optional(comm, dirname + "/max_steps",        max_steps_,     error_message);
 		utils::save_optional(comm, dirname + "/calc_forces",      calc_forces_,   error_message);
+		utils::save_optional(comm, dirname + "/real_orbitals",    real_orbitals_, error_message);
+		utils::save_optional(comm, dirname + "/kerker",           kerker_,        error_message);
+		utils::save_optional(comm, dirname + "/band_locking",     band_locking_,  error_message);
+		utils::save_optional(comm, dirname + "/lcao_guess",       lcao_guess_,    error_message);
 	}
 	
 	static auto load(std::string const & dirname) {
@@ -189,6 +270,10 @@ public:
 		utils::load_optional(dirname + "/subspace_diag",    opts.subspace_diag_);
 		utils::load_optional(dirname + "/max_steps",        opts.max_steps_);
 		utils::load_optional(dirname + "/calc_forces",      opts.calc_forces_);
+		utils::load_optional(dirname + "/real_orbitals",    opts.real_orbitals_);
+		utils::load_optional(dirname + "/kerker",           opts.kerker_);
+		utils::load_optional(dirname + "/band_locking",     opts.band_locking_);
+		utils::load_optional(dirname + "/lcao_guess",       opts.lcao_guess_);
 		
 		return opts;
 	}
@@ -225,6 +310,8 @@ public:
 #ifdef INQ_OPTIONS_GROUND_STATE_UNIT_TEST
 #undef INQ_OPTIONS_GROUND_STATE_UNIT_TEST
 
+#include <sstream>
+
 #include <catch2/catch_all.hpp>
 
 TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
@@ -240,14 +327,21 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 
     CHECK(solver.eigensolver() == options::ground_state::scf_eigensolver::STEEPEST_DESCENT);
     CHECK(solver.mixing() == 0.3_a);
+		CHECK(not solver.use_real_orbitals());
+		CHECK(solver.kerker_screening() == 0.0);
+		CHECK(not solver.use_band_locking());
+		CHECK(not solver.use_lcao_initial_guess());
 
   }
 
   SECTION("Composition"){
 
-    auto solver = options::ground_state{}.calculate_forces().mixing(0.05).steepest_descent().linear_mixing();
+    auto solver = options::ground_state{}.calculate_forces().mixing(0.05).steepest_descent().linear_mixing().real_orbitals().band_locking().lcao_initial_guess();
 
 		CHECK(solver.calc_forces());
+		CHECK(solver.use_real_orbitals());
+		CHECK(solver.use_band_locking());
+		CHECK(solver.use_lcao_initial_guess());
     CHECK(solver.mixing() == 0.05_a);
     CHECK(solver.eigensolver() == options::ground_state::scf_eigensolver::STEEPEST_DESCENT);
     CHECK(solver.mixing_algorithm() == options::ground_state::mixing_algo::LINEAR);
@@ -256,6 +350,28 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		auto read_solver = options::ground_state::load("save_options_ground_state");
 
 		CHECK(read_solver.calc_forces());
+		CHECK(read_solver.use_real_orbitals());
+		CHECK(read_solver.use_band_locking());
+		CHECK(read_solver.use_lcao_initial_guess());
+
+		auto cheby = options::ground_state{}.chebyshev_filter();
+		CHECK(cheby.eigensolver() == options::ground_state::scf_eigensolver::CHEBYSHEV_FILTER);
+		cheby.save(comm, "save_options_ground_state_cheby");
+		CHECK(options::ground_state::load("save_options_ground_state_cheby").eigensolver() == options::ground_state::scf_eigensolver::CHEBYSHEV_FILTER);
+
+		CHECK(options::ground_state{}.rmm_diis().eigensolver() == options::ground_state::scf_eigensolver::RMM_DIIS);
+
+		auto kerker = options::ground_state{}.pulay_mixing().kerker_preconditioner(1.2);
+		CHECK(kerker.mixing_algorithm() == options::ground_state::mixing_algo::PULAY);
+		CHECK(kerker.kerker_screening() == 1.2_a);
+		kerker.save(comm, "save_options_ground_state_kerker");
+		auto read_kerker = options::ground_state::load("save_options_ground_state_kerker");
+		CHECK(read_kerker.mixing_algorithm() == options::ground_state::mixing_algo::PULAY);
+		CHECK(read_kerker.kerker_screening() == 1.2_a);
+
+		options::ground_state::mixing_algo algo;
+		std::istringstream("broyden") >> algo;
+		CHECK(algo == options::ground_state::mixing_algo::BROYDEN);
     CHECK(read_solver.mixing() == 0.05_a);
     CHECK(read_solver.eigensolver() == options::ground_state::scf_eigensolver::STEEPEST_DESCENT);
     CHECK(read_solver.mixing_algorithm() == options::ground_state::mixing_algo::LINEAR);
@@ -13,6 +13,7 @@
 #include <utils/merge_optional.hpp>
 
 #include <optional>
+#include <string>
 #include <cassert>
 
 
@@ -122,6 +123,12 @@ private:
 	std::optional<electron_propagator> prop_;
 	std::optional<ion_dynamics> ion_dynamics_;
 	observables_type obs_;
+	std::optional<int> extrapolation_steps_;
+	std::optional<double> ace_tolerance_;
+	std::optional<int> ace_steps_;
+	std::optional<double> ace_max_error_;
+	std::optional<std::string> etrs_spill_;
+	std::optional<int> sampling_interval_;
 	
 public:
 	
@@ -183,6 +190,73 @@ public:
 		return ion_dynamics_.value_or(ion_dynamics::STATIC);
 	}
 
+	// The number of previous steps used to predict the orbitals in Born-Oppenheimer dynamics, 1 means no extrapolation
+	auto extrapolation_steps(int steps) {
+		assert(steps >= 1);
+		real_time solver = *this;;
+		solver.extrapolation_steps_ = steps;
+		return solver;
+	}
+
+	auto extrapolation_steps_value() const {
+		return extrapolation_steps_.value_or(4);
+	}
+
+	// The adaptively compressed exchange (ACE) operator is only rebuilt when the orbitals have drifted more than the tolerance
+	// from the ones used to build it, or after the given number of steps. A zero tolerance rebuilds it every time.
+	// If a rebuild finds that the previous operator had a relative error larger than max_error, it is rebuilt again in the next step.
+	auto ace_refresh(double tolerance, int steps = 10, double max_error = 1e-3) {
+		assert(tolerance >= 0.0);
+		assert(steps >= 1);
+		assert(max_error > 0.0);
+		real_time solver = *this;;
+		solver.ace_tolerance_ = tolerance;
+		solver.ace_steps_ = steps;
+		solver.ace_max_error_ = max_error;
+		return solver;
+	}
+
+	auto ace_refresh_tolerance_value() const {
+		return ace_tolerance_.value_or(0.0);
+	}
+
+	auto ace_refresh_steps_value() const {
+		return ace_steps_.value_or(10);
+	}
+
+	auto ace_refresh_max_error_value() const {
+		return ace_max_error_.value_or(1e-3);
+	}
+
+	// Stores the ETRS half-step orbitals in files in this directory instead of in memory, it should be node-local storage
+	auto etrs_spill(std::string const & directory) {
+		real_time solver = *this;;
+		solver.etrs_spill_ = directory;
+		return solver;
+	}
+
+	auto etrs_spill_value() const {
+		return etrs_spill_.value_or(std::string{});
+	}
+
+	// The energy is calculated and the observer function is called every this number of steps (and in the last one)
+	// The steps are counted like viewables::iter(), so an observer that uses every() with a multiple of the interval sees all its steps
+	auto sampling_interval(int steps) {
+		assert(steps >= 1);
+		real_time solver = *this;;
+		solver.sampling_interval_ = steps;
+		return solver;
+	}
+
+	auto sampling_interval_value() const {
+		return sampling_interval_.value_or(1);
+	}
+
+	// whether the step with index 'iter' (as given by viewables::iter()) is sampled
+	auto sampled(int iter) const {
+		return iter%sampling_interval_value() == 0 or iter == num_steps() - 1;
+	}
+	
 	auto observables_dipole() {
 		real_time solver = *this;;
 		solver.obs_.insert(observables::dipole);
@@ -214,6 +288,12 @@ public:
 		utils::save_optional (comm, dirname + "/propagator",     prop_,          error_message);
 		utils::save_optional (comm, dirname + "/ion_dynamics",   ion_dynamics_,  error_message);
 		utils::save_container(comm, dirname + "/observables",    obs_,           error_message);
+		utils::save_optional (comm, dirname + "/extrapolation_steps", extrapolation_steps_, error_message);
+		utils::save_optional (comm, dirname + "/ace_tolerance",  ace_tolerance_, error_message);
+		utils::save_optional (comm, dirname + "/ace_steps",      ace_steps_,     error_message);
+		utils::save_optional (comm, dirname + "/ace_max_error",  ace_max_error_, error_message);
+		utils::save_optional (comm, dirname + "/etrs_spill",     etrs_spill_,    error_message);
+		utils::save_optional (comm, dirname + "/sampling_interval", sampling_interval_, error_message);
 		
 	}
 
@@ -225,6 +305,12 @@ public:
 		utils::load_optional(dirname + "/propagator",     opts.prop_);
 		utils::load_optional(dirname + "/ion_dynamics",   opts.ion_dynamics_);
 		utils::load_container(dirname + "/observables",   opts.obs_);
+		utils::load_optional(dirname + "/extrapolation_steps", opts.extrapolation_steps_);
+		utils::load_optional(dirname + "/ace_tolerance",  opts.ace_tolerance_);
+		utils::load_optional(dirname + "/ace_steps",      opts.ace_steps_);
+		utils::load_optional(dirname + "/ace_max_error",  opts.ace_max_error_);
+		utils::load_optional(dirname + "/etrs_spill",     opts.etrs_spill_);
+		utils::load_optional(dirname + "/sampling_interval", opts.sampling_interval_);
 		
 		return opts;
 	}
@@ -249,6 +335,22 @@ public:
 		if(not self.ion_dynamics_.has_value()) out << " *";
 		out << "\n";
 
+		out << "  extrapolation      = " << self.extrapolation_steps_value();
+		if(not self.extrapolation_steps_.has_value()) out << " *";
+		out << "\n";
+
+		out << "  ace-refresh        = " << self.ace_refresh_tolerance_value() << " | " << self.ace_refresh_steps_value() << " steps | " << self.ace_refresh_max_error_value() << " max error";
+		if(not self.ace_tolerance_.has_value()) out << " *";
+		out << "\n";
+
+		out << "  etrs-spill         = " << (self.etrs_spill_value().empty() ? std::string("memory") : self.etrs_spill_value());
+		if(not self.etrs_spill_.has_value()) out << " *";
+		out << "\n";
+
+		out << "  sampling-interval  = " << self.sampling_interval_value() << " steps";
+		if(not self.sampling_interval_.has_value()) out << " *";
+		out << "\n";
+
 		out << "  observables        = total-energy";
 		for(auto & ob : self.obs_)  out << ' ' << ob;
 		if(self.obs_.empty()) out << " *";
@@ -294,12 +396,18 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
     CHECK(read_rt.num_steps() == 100);
     CHECK(read_rt.propagator() == options::real_time::electron_propagator::ETRS);		
 		CHECK(read_rt.ion_dynamics_value() == options::real_time::ion_dynamics::STATIC);		
+		CHECK(read_rt.extrapolation_steps_value() == 4);
+		CHECK(read_rt.ace_refresh_tolerance_value() == 0.0);
+		CHECK(read_rt.ace_refresh_steps_value() == 10);
+		CHECK(read_rt.ace_refresh_max_error_value() == 1e-3);
+		CHECK(read_rt.etrs_spill_value().empty());
+		CHECK(read_rt.sampling_interval_value() == 1);
 	
   }
 
   SECTION("Composition"){
 
-    auto rt = options::real_time{}.num_steps(1000).dt(0.05_atomictime).crank_nicolson().impulsive().observables_dipole().observables_current();
+    auto rt = options::real_time{}.num_steps(1000).dt(0.05_atomictime).crank_nicolson().impulsive().observables_dipole().observables_current().extrapolation_steps(2).ace_refresh(1e-4, 20, 1e-2).etrs_spill("/tmp/inq_scratch").sampling_interval(10);
     
     CHECK(rt.num_steps() == 1000);
     CHECK(rt.dt() == 0.05_a);
@@ -316,6 +424,12 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		CHECK(read_rt.propagator() == options::real_time::electron_propagator::CRANK_NICOLSON);
 		CHECK(read_rt.ion_dynamics_value() == options::real_time::ion_dynamics::IMPULSIVE);
 		CHECK(read_rt.observables_container() == rt.observables_container());
+		CHECK(read_rt.extrapolation_steps_value() == 2);
+		CHECK(read_rt.ace_refresh_tolerance_value() == 1e-4_a);
+		CHECK(read_rt.ace_refresh_steps_value() == 20);
+		CHECK(read_rt.ace_refresh_max_error_value() == 1e-2_a);
+		CHECK(read_rt.etrs_spill_value() == "/tmp/inq_scratch");
+		CHECK(read_rt.sampling_interval_value() == 10);
 		
 		std::cout << read_rt;
   }
@@ -22,10 +22,38 @@ namespace options {
 
 class theory {
 
+public:
+
+	enum class poisson_solver { CUTOFF, MARTYNA_TUCKERMAN };
+
+	template<class OStream>
+	friend OStream & operator<<(OStream & out, poisson_solver const & self){
+		if(self == poisson_solver::CUTOFF)            out << "cutoff";
+		if(self == poisson_solver::MARTYNA_TUCKERMAN) out << "martyna_tuckerman";
+		return out;
+	}
+
+	template<class IStream>
+	friend IStream & operator>>(IStream & in, poisson_solver & self){
+		std::string readval;
+		in >> readval;
+		if(readval == "cutoff"){
+			self = poisson_solver::CUTOFF;
+		} else if(readval == "martyna_tuckerman"){
+			self = poisson_solver::MARTYNA_TUCKERMAN;
+		} else {
+			throw std::runtime_error("INQ error: Invalid Poisson solver");
+		}
+		return in;
+	}
+
+private:
+	
 	std::optional<bool> hartree_potential_;
 	std::optional<int> exchange_;
 	std::optional<int> correlation_;
 	std::optional<double> alpha_;
+	std::optional<poisson_solver> poisson_solver_;
 
 public:
 	
@@ -138,6 +166,26 @@ public:
 		return alpha_.value();
 	}
 	
+	// The solver used for the Hartree and exchange terms in finite (0D) systems. The
+	// cutoff kernel works on a box doubled in each direction, the Martyna-Tuckerman
+	// kernel works on the original grid but requires the density to be contained in
+	// the central half of the cell.
+	auto cutoff_poisson() const {
+		theory inter = *this;
+		inter.poisson_solver_ = poisson_solver::CUTOFF;
+		return inter;
+	}
+
+	auto martyna_tuckerman_poisson() const {
+		theory inter = *this;
+		inter.poisson_solver_ = poisson_solver::MARTYNA_TUCKERMAN;
+		return inter;
+	}
+
+	auto isolated_poisson_solver() const {
+		return poisson_solver_.value_or(poisson_solver::CUTOFF);
+	}
+	
 	void save(parallel::communicator & comm, std::string const & dirname) const {
 		auto error_message = "INQ error: Cannot save theory to directory '" + dirname + "'.";
 
@@ -146,6 +194,7 @@ public:
 		utils::save_optional(comm, dirname + "/exchange", exchange_, error_message);
 		utils::save_optional(comm, dirname + "/correlation", correlation_, error_message);
 		utils::save_optional(comm, dirname + "/alpha", alpha_, error_message);
+		utils::save_optional_enum(comm, dirname + "/poisson_solver", poisson_solver_, error_message);
 	}
 		
 	static auto load(std::string const & dirname) {
@@ -155,6 +204,7 @@ public:
 		utils::load_optional(dirname + "/exchange", opts.exchange_);
 		utils::load_optional(dirname + "/correlation", opts.correlation_);
 		utils::load_optional(dirname + "/alpha", opts.alpha_);
+		utils::load_optional_enum(dirname + "/poisson_solver", opts.poisson_solver_);
 		
 		return opts;
 	}
@@ -286,5 +336,19 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		CHECK(read_inter.alpha_value() == 0.2);
 	}
 
+	SECTION("Poisson solver"){
+		CHECK(options::theory{}.isolated_poisson_solver() == options::theory::poisson_solver::CUTOFF);
+		
+		auto inter = options::theory{}.hartree_fock().martyna_tuckerman_poisson();
+		CHECK(inter.isolated_poisson_solver() == options::theory::poisson_solver::MARTYNA_TUCKERMAN);
+		CHECK(inter.exchange_coefficient() == 1.0);
+		
+		inter.save(comm, "theory_save_martyna_tuckerman");
+		auto read_inter = options::theory::load("theory_save_martyna_tuckerman");
+
+		CHECK(read_inter.isolated_poisson_solver() == options::theory::poisson_solver::MARTYNA_TUCKERMAN);
+		CHECK(read_inter.cutoff_poisson().isolated_poisson_solver() == options::theory::poisson_solver::CUTOFF);
+	}
+
 }
 #endif
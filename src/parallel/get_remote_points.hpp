@@ -17,6 +17,7 @@
 #include <utils/raw_pointer_cast.hpp>
 
 #include <cstdlib> //drand48
+#include <stdexcept>
 
 namespace inq {
 
@@ -51,6 +52,9 @@ struct remote_points_table {
 
 		auto const num_proc = basis.comm().size();
 
+		// the linear index of the points is only distributed in contiguous blocks with the slab decomposition
+		if(basis.pencil()) throw std::runtime_error("inq error: the redistribution of grid points is not implemented for the pencil decomposition");
+
 		// create a list per processor of the points we need
 		points_needed.resize(num_proc);
 		
@@ -243,6 +247,8 @@ gpu::array<typename FieldSetType::element_type, 2> get_remote_points(FieldSetTyp
 
 	} else {
 
+		if(source.basis().pencil()) throw std::runtime_error("inq error: the redistribution of grid points is not implemented for the pencil decomposition");
+		
 		for(parallel::array_iterator_2d pai(source.basis().part(), source.set_part(), source.full_comm(), source.matrix()); pai != pai.end(); ++pai){
 
 			for(long ip = 0; ip < point_list.size(); ip++){
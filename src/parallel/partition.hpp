@@ -55,7 +55,23 @@ public:
 	partition(const long size)
 		:partition(size, 1, 0){
 	}
-	
+
+	// A partition where the local range is given explicitly. This is
+	// used for distributions that are not a single block of the linear
+	// index (like the pencil decomposition of a grid), so start and
+	// end only give the position in the order of the processes.
+	partition(const long size, int comm_size, long start, long end, long bsize)
+		:comm_size_(comm_size),
+		 size_(size),
+		 start_(start),
+		 end_(end),
+		 bsize_(bsize)
+	{
+		assert(end_ >= start_);
+		assert(end_ <= size_);
+		assert(local_size() <= bsize_);
+	}
+
 	auto operator*=(const long factor) {
 		size_ *= factor;
 		start_ *= factor;
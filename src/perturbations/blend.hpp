@@ -9,19 +9,34 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
+#include <basis/field.hpp>
+#include <basis/field_set.hpp>
+#include <basis/real_space.hpp>
 #include <perturbations/absorbing.hpp>
+#include <perturbations/ixs.hpp>
 #include <perturbations/kick.hpp>
 #include <perturbations/laser.hpp>
 #include <perturbations/none.hpp>
+#include <utils/profiling.hpp>
+
+#include <optional>
 
 namespace inq {
 namespace perturbations {
 
 class blend {
 
-	enum class pert_id { KICK = 0, LASER = 1 };
-  using any = std::variant<kick, laser>;
+	enum class pert_id { KICK = 0, LASER = 1, IXS = 2 };
+  using any = std::variant<kick, laser, ixs>;
   std::vector<any> perts_;
+
+	// The scalar potential of the perturbations is a sum of terms
+	// envelope(t)*profile(r): -E(t).r for the uniform electric field (one
+	// profile per cartesian direction) and one term for each
+	// perturbation with a potential. The profiles are calculated once
+	// for each basis, so each time step only needs a single pass over
+	// the grid.
+	mutable std::optional<basis::field_set<basis::real_space, double>> profiles_;
 	
 	template<class OStream>
 	friend OStream & operator<<(OStream & out, pert_id const & self) {
@@ -30,6 +45,8 @@ class blend {
 			out << "kick";
 		} else if(self == pert_id::LASER){
 			out << "laser";
+		} else if(self == pert_id::IXS){
+			out << "ixs";
 		}
 		
 		return out;
@@ -45,6 +62,8 @@ class blend {
 			self = pert_id::KICK;
 		} else if(readval == "laser"){
 			self = pert_id::LASER;
+		} else if(readval == "ixs"){
+			self = pert_id::IXS;
 		} else {
 			throw std::runtime_error("INQ error: Invalid perturbation id");
 		}
@@ -58,16 +77,19 @@ public:
 
   void clear() {
     perts_.clear();
+		profiles_.reset();
   }
 
   template <class PertType>
   void add(PertType && pert){
     perts_.emplace_back(std::forward<PertType>(pert));
+		profiles_.reset();
   }
 
   template <class PertType>
   void add(PertType const & pert){
     perts_.emplace_back(pert);
+		profiles_.reset();
   }
 	
 	auto size() const {
@@ -117,11 +139,81 @@ public:
     return total;
 	}
 
+	auto num_potential_profiles() const {
+		long num = has_uniform_electric_field() ? 3 : 0;
+		for(auto & pert : perts_){
+			if(std::visit([&](auto per) { return per.has_potential(); }, pert)) num++;
+		}
+		return num;
+	}
+
+	auto & potential_profiles(basis::real_space const & bas) const {
+
+		auto same_basis = profiles_.has_value() and profiles_->basis() == bas and profiles_->basis().cell() == bas.cell();
+		for(int idir = 0; idir < 3 and same_basis; idir++){
+			same_basis = profiles_->basis().cubic_part(idir).start() == bas.cubic_part(idir).start()
+				and profiles_->basis().cubic_part(idir).local_size() == bas.cubic_part(idir).local_size();
+		}
+		if(same_basis) return *profiles_;
+
+		CALI_CXX_MARK_FUNCTION;
+
+		profiles_.emplace(bas, num_potential_profiles());
+
+		int iprofile = 0;
+		if(has_uniform_electric_field()){
+			gpu::run(bas.local_sizes()[2], bas.local_sizes()[1], bas.local_sizes()[0],
+							 [point_op = bas.point_op(), pr = begin(profiles_->hypercubic())] GPU_LAMBDA (auto iz, auto iy, auto ix){
+								 auto rr = point_op.rvector_cartesian(ix, iy, iz);
+								 for(int idir = 0; idir < 3; idir++) pr[ix][iy][iz][idir] = rr[idir];
+							 });
+			iprofile = 3;
+		}
+
+		for(auto & pert : perts_){
+			std::visit([&](auto per) {
+				if(not per.has_potential()) return;
+				
+				auto profile = basis::field<basis::real_space, double>(bas);
+				per.potential_profile(profile);
+				gpu::run(bas.local_size(), [pr = begin(profiles_->matrix()), po = begin(profile.linear()), iprofile] GPU_LAMBDA (auto ip){
+					pr[ip][iprofile] = po[ip];
+				});
+				iprofile++;
+			}, pert);
+		}
+
+		assert(iprofile == profiles_->set_size());
+		
+		return *profiles_;
+	}
+	
 	template<typename PotentialType>
 	void potential(double const time, PotentialType & potential) const {
+
+		auto nprofiles = num_potential_profiles();
+		if(nprofiles == 0) return;
+
+		CALI_CXX_MARK_FUNCTION;
+
+		auto & profiles = potential_profiles(potential.basis());
+
+		gpu::array<double, 1> envelopes(nprofiles);
+
+		int iprofile = 0;
+		if(has_uniform_electric_field()){
+			auto efield = uniform_electric_field(time);
+			for(int idir = 0; idir < 3; idir++) envelopes[iprofile++] = -efield[idir];
+		}
+
 		for(auto & pert : perts_){
-			std::visit([&](auto per) { per.potential(time, potential); }, pert);
+			std::visit([&](auto per) { if(per.has_potential()) envelopes[iprofile++] = per.potential_envelope(time); }, pert);
 		}
+
+		gpu::run(potential.basis().local_size(),
+						 [vk = begin(potential.linear()), pr = begin(profiles.matrix()), env = begin(envelopes), nprofiles] GPU_LAMBDA (auto ip){
+							 for(int iprofile = 0; iprofile < nprofiles; iprofile++) vk[ip] += env[iprofile]*pr[ip][iprofile];
+						 });
 	}
 
 	void save(parallel::communicator & comm, std::string const & dirname) const {
@@ -162,6 +254,9 @@ public:
 			case pert_id::LASER:
 				bl.add(perturbations::laser::load(subdir + "/save"));				
 				break;
+			case pert_id::IXS:
+				bl.add(perturbations::ixs::load(subdir + "/save"));
+				break;
 			}
 		}
 			
@@ -272,6 +367,43 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		CHECK(read_ps.uniform_vector_potential(1.0)[2] == -0.6);
 	}
 
+	SECTION("potential"){
+
+		basis::real_space bas(systems::cell::orthorhombic(4.2_b, 3.5_b, 6.4_b).finite(), /*spacing =*/ 0.39770182, comm);
+
+		auto las = perturbations::laser({0.1, -0.2, 0.3}, 1.0_Ha, perturbations::gauge::length);
+		auto ixs = perturbations::ixs(1.0_Ha, {0, 0, 1}, 0.3_fs, 0.1_fs, "cos");
+		
+		auto ps = perturbations::blend{};
+		ps.add(kick);
+		ps.add(las);
+		ps.add(ixs);
+
+		CHECK(ps.num_potential_profiles() == 4);
+
+		for(auto time : {0.3, 1.7, 12.0}){
+			basis::field<basis::real_space, double> pot(bas);
+			basis::field<basis::real_space, double> ref(bas);
+			pot.fill(1.0);
+			ref.fill(1.0);
+
+			ps.potential(time, pot);
+			las.potential(time, ref);
+			ixs.potential(time, ref);
+
+			auto diff = 0.0;
+			for(long ip = 0; ip < bas.local_size(); ip++) diff += fabs(pot.linear()[ip] - ref.linear()[ip]);
+			comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+			CHECK(diff < 1e-10);
+		}
+
+		ps.save(comm, "save_blend_potential");
+		auto read_ps = perturbations::blend::load("save_blend_potential");
+
+		CHECK(read_ps.size() == 3);
+		CHECK(read_ps.num_potential_profiles() == 4);
+	}
+	
 	SECTION("zero step"){
 		
 		const int nvec = 12;
@@ -13,7 +13,9 @@
 
 #include <math/vector3.hpp>
 #include <magnitude/energy.hpp>
+#include <magnitude/time.hpp>
 #include <perturbations/none.hpp>
+#include <utils/load_save.hpp>
 
 namespace inq {
 namespace perturbations {
@@ -37,6 +39,24 @@ public:
         return amplitude_/sqrt(2.0*M_PI) * exp( -0.5*pow((time-tdelay_)/(twidth_),2) );
     }
 	
+	auto potential_envelope(const double time) const {
+		return envelope(time);
+	}
+
+	template<typename ProfileType>
+	void potential_profile(ProfileType & profile) const {
+
+		if(envtype_ != "cos" and envtype_ != "sin") throw std::runtime_error("INQ error: Invalid IXS envelope type");
+
+		vector3<double, covariant> qcov = profile.basis().reciprocal().point_op().gvector(q_[0], q_[1], q_[2]);
+
+		gpu::run(profile.basis().local_sizes()[2], profile.basis().local_sizes()[1], profile.basis().local_sizes()[0],
+						 [point_op = profile.basis().point_op(), pr = begin(profile.cubic()), q = qcov, use_cos = (envtype_ == "cos")] GPU_LAMBDA (auto iz, auto iy, auto ix) {
+							 auto qr = dot(q, point_op.rvector(ix, iy, iz));
+							 pr[ix][iy][iz] = use_cos ? cos(qr) : sin(qr);
+						 });
+	}
+	
 	template<typename PotentialType>
 	void potential(const double time, PotentialType & potential) const {
 
@@ -82,6 +102,46 @@ public:
 
 	}
 
+	void save(parallel::communicator & comm, std::string const & dirname) const {
+		auto error_message = "INQ error: Cannot save the perturbations::ixs to directory '" + dirname + "'.";
+
+		utils::create_directory(comm, dirname);
+		utils::save_value(comm, dirname + "/amplitude",  amplitude_,  error_message);
+		utils::save_value(comm, dirname + "/q",          q_,          error_message);
+		utils::save_value(comm, dirname + "/tdelay",     tdelay_,     error_message);
+		utils::save_value(comm, dirname + "/twidth",     twidth_,     error_message);
+		utils::save_value(comm, dirname + "/envtype",    envtype_,    error_message);
+	}
+
+	static auto load(std::string const & dirname) {
+		using namespace magnitude;
+
+		auto error_message = "INQ error: Cannot load perturbations::ixs from directory '" + dirname + "'.";
+
+		double amp, tdel, twid;
+		vector3<int> qq;
+		std::string env;
+
+		utils::load_value(dirname + "/amplitude",  amp,   error_message);
+		utils::load_value(dirname + "/q",          qq,    error_message);
+		utils::load_value(dirname + "/tdelay",     tdel,  error_message);
+		utils::load_value(dirname + "/twidth",     twid,  error_message);
+		utils::load_value(dirname + "/envtype",    env,   error_message);
+
+		return ixs(amp*1.0_Ha, qq, quantity<magnitude::time>::from_atomic_units(tdel), quantity<magnitude::time>::from_atomic_units(twid), env);
+	}
+
+	template<class OStream>
+	friend OStream & operator<<(OStream & out, ixs const & self){
+		out << "IXS:\n";
+		out << "  amplitude [a.u.] = " << self.amplitude_ << "\n";
+		out << "  q indices        = " << self.q_ << "\n";
+		out << "  delay [a.u.]     = " << self.tdelay_ << "\n";
+		out << "  width [a.u.]     = " << self.twidth_ << "\n";
+		out << "  envelope         = " << self.envtype_ << "\n";
+		return out;
+	}
+
 private:
 	double amplitude_;
 	double tdelay_;
@@ -42,6 +42,11 @@ public:
 	auto uniform_electric_field(double time) const {
 		return polarization_*sin(time*frequency_);
 	}
+
+	template<typename PotentialType>
+	void potential(const double time, PotentialType & potential) const {
+		if(has_uniform_electric_field()) add_uniform_electric_field_potential(uniform_electric_field(time), potential);
+	}
 	
 	auto has_uniform_vector_potential() const {
 		return gauge_ == gauge::velocity;
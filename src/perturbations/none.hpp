@@ -11,6 +11,7 @@
 
 #include <inq_config.h>
 
+#include <gpu/run.hpp>
 #include <math/vector3.hpp>
 #include <magnitude/energy.hpp>
 
@@ -47,6 +48,34 @@ public:
 	void potential(const double time, PotentialType & potential) const {
 	}
 
+	// A perturbation with a scalar potential of the form envelope(t)*profile(r).
+	// The profile only depends on the basis, so it can be calculated once.
+	auto has_potential() const {
+		return false;
+	}
+
+	template<typename ProfileType>
+	void potential_profile(ProfileType & profile) const {
+	}
+
+	auto potential_envelope(double /*time*/) const {
+		return 0.0;
+	}
+
+protected:
+
+	// adds -E.r to the potential
+	template<typename PotentialType>
+	static void add_uniform_electric_field_potential(vector3<double> const & efield, PotentialType & potential) {
+		gpu::run(potential.basis().local_sizes()[2], potential.basis().local_sizes()[1], potential.basis().local_sizes()[0],
+						 [point_op = potential.basis().point_op(), efield, vk = begin(potential.cubic())] GPU_LAMBDA (auto iz, auto iy, auto ix){
+							 auto rr = point_op.rvector_cartesian(ix, iy, iz);
+							 vk[ix][iy][iz] += -dot(efield, rr);
+						 });
+	}
+
+public:
+
 	template<class OStream>
 	friend OStream & operator<<(OStream & out, none const & self){
 		return out;
@@ -46,6 +46,11 @@ public:
 		double coshfactor = cosh(rampwidth_*(time-rampstart_));
 		return polarization_*sin(time*frequency_) *0.5*(tanh((time-rampstart_)/rampwidth_)+1.0) - polarization_/frequency_*(cos(time*frequency_) - 1.0) * 0.5/rampwidth_/coshfactor/coshfactor;
 	}
+
+	template<typename PotentialType>
+	void potential(const double time, PotentialType & potential) const {
+		if(has_uniform_electric_field()) add_uniform_electric_field_potential(uniform_electric_field(time), potential);
+	}
 	
 	auto has_uniform_vector_potential() const {
 		return gauge_ == gauge::velocity;
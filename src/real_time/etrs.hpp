@@ -12,36 +12,53 @@
 #include <observables/density.hpp>
 #include <observables/current.hpp>
 #include <operations/exponential.hpp>
+#include <real_time/etrs_storage.hpp>
 #include <systems/electrons.hpp>
 #include <systems/ions.hpp>
 #include <utils/profiling.hpp>
+#include <utils/workspace.hpp>
 
 namespace inq {
 namespace real_time {
 
 template <class IonSubPropagator, class ForcesType, class CurrentType, class HamiltonianType, class SelfConsistencyType, class EnergyType>
 void etrs(double const time, double const dt, systems::ions & ions, systems::electrons & electrons, IonSubPropagator const & ion_propagator, ForcesType const & forces, CurrentType const & current,
-					HamiltonianType & ham, SelfConsistencyType & sc, EnergyType & energy){
+					HamiltonianType & ham, SelfConsistencyType & sc, EnergyType & energy, utils::workspace & work, double const ace_tolerance = 0.0,
+					std::string const & spill_directory = {}){
 	CALI_CXX_MARK_FUNCTION;
 
 	int const nscf = 5;
 	double const scf_threshold = 5e-5;
 
-	systems::electrons::kpin_type save;
+	// the half-step orbitals are needed again in each self-consistency iteration
+	etrs_storage save(work, spill_directory);
 
+	// without exact exchange the full-step orbitals are only used for the density, so the half step takes their place as soon as
+	// they are added to it; otherwise they are kept until the exchange operator is updated
+	auto const keep_full_step = ham.exchange().enabled();
+	
+	basis::field_set<basis::real_space, double> density(electrons.density_basis(), electrons.states().num_density_components());
+	density.fill(0.0);
+	
 	int iphi = 0;
 	for(auto & phi : electrons.kpin()){
 		
 		//propagate half step and full step with H(t)
-		auto halfstep_phi = operations::exponential_2_for_1(ham, complex(0.0, dt/2.0), complex(0.0, dt), phi);
-		{ CALI_CXX_MARK_SCOPE("etrs:save");
-		  save.emplace_back(std::move(halfstep_phi));
+		auto & halfstep_phi = operations::exponential_2_for_1(ham, complex(0.0, dt/2.0), complex(0.0, dt), phi, work);
+		observables::density::calculate_add(electrons.occupations()[iphi], phi, density);
+
+		if(keep_full_step) {
+			save.store(halfstep_phi);
+		} else {
+			phi.matrix() = halfstep_phi.matrix();
+			save.store(phi);
 		}
 									 		
 		iphi++;
 	}
 
-	electrons.spin_density() = observables::density::calculate(electrons);
+	observables::density::calculate_reduce(electrons, density);
+	electrons.spin_density() = std::move(density);
 	
 	//propagate the Hamiltonian to t + dt
 	ion_propagator.propagate_positions(dt, ions, forces);	
@@ -52,10 +69,11 @@ void etrs(double const time, double const dt, systems::ions & ions, systems::ele
 	}
 	sc.propagate_induced_vector_potential(dt, current);
 	sc.update_hamiltonian(ham, energy, electrons.spin_density(), time + dt);
-	ham.exchange().update(electrons);
+	ham.exchange().refresh(electrons, ace_tolerance);
 
-	{ CALI_CXX_MARK_SCOPE("etrs:restore");
-		electrons.kpin() = save;
+	if(keep_full_step) {
+		CALI_CXX_MARK_SCOPE("etrs:restore");
+		for(int iphi = 0; iphi < long(electrons.kpin().size()); iphi++) save.restore(iphi, electrons.kpin()[iphi]);
 	}
 
 	//propagate the other half step with H(t + dt) self-consistently
@@ -63,8 +81,8 @@ void etrs(double const time, double const dt, systems::ions & ions, systems::ele
 
 		int iphi = 0;
 		for(auto & phi : electrons.kpin()) {
-			if(iscf != 0) phi = save[iphi];
-			operations::exponential_in_place(ham, complex(0.0, dt/2.0), phi);
+			if(iscf != 0) save.restore(iphi, phi);
+			operations::exponential_in_place(ham, complex(0.0, dt/2.0), phi, work);
 			iphi++;
 		}
 		
@@ -75,7 +93,7 @@ void etrs(double const time, double const dt, systems::ions & ions, systems::ele
 		auto done = (delta < scf_threshold) or (iscf == nscf - 1);
 		
 		sc.update_hamiltonian(ham, energy, electrons.spin_density(), time + dt);
-		ham.exchange().update(electrons);
+		ham.exchange().refresh(electrons, ace_tolerance);
 		if(done) break;
 	}
 	
@@ -0,0 +1,179 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef INQ__REAL_TIME__ETRS_STORAGE
+#define INQ__REAL_TIME__ETRS_STORAGE
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <gpu/run.hpp>
+#include <states/orbital_set.hpp>
+#include <utils/load_save.hpp>
+#include <utils/num_str.hpp>
+#include <utils/profiling.hpp>
+#include <utils/raw_pointer_cast.hpp>
+#include <utils/workspace.hpp>
+
+#include <mpi3/environment.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include <unistd.h>
+
+namespace inq {
+namespace real_time {
+
+// Keeps a copy of the half-step orbitals of ETRS, that are needed
+// again in every self-consistency iteration. They can be stored in
+// memory or in files (one for each process and orbital block, tagged
+// with the process id) in a directory that should be in fast
+// node-local storage. In the last case ETRS needs no memory beyond
+// the orbitals themselves and the temporaries of the exponential.
+
+class etrs_storage {
+
+	utils::workspace & work_;
+	std::string directory_;
+	std::vector<states::orbital_set<basis::real_space, complex> *> orbitals_;
+	std::vector<std::string> files_;
+
+	// the process id makes the names unique when several runs share the directory
+	auto filename(int iphi) const {
+		auto rank = boost::mpi3::environment::get_world_instance().rank();
+		return directory_ + "/etrs_half_step_" + utils::num_to_str(long(getpid())) + "_" + utils::num_to_str(rank) + "_" + utils::num_to_str(iphi);
+	}
+
+public:
+
+	etrs_storage(utils::workspace & work, std::string const & directory = {}):
+		work_(work),
+		directory_(directory){
+	}
+
+	etrs_storage(etrs_storage const &) = delete;
+	etrs_storage & operator=(etrs_storage const &) = delete;
+
+	~etrs_storage(){
+		for(auto const & file : files_) std::remove(file.c_str());
+	}
+
+	auto spills() const {
+		return not directory_.empty();
+	}
+
+	auto size() const {
+		if(spills()) return long(files_.size());
+		return long(orbitals_.size());
+	}
+
+	// the blocks have to be stored in order, the first one is 0
+	template <typename OrbitalSetType>
+	void store(OrbitalSetType const & phi) {
+
+		CALI_CXX_MARK_SCOPE("etrs_storage::store");
+
+		if(not spills()){
+			auto & copy = work_.orbitals("etrs_storage::half_step_" + utils::num_to_str(size()), phi);
+			copy.matrix() = phi.matrix();
+			orbitals_.push_back(&copy);
+			return;
+		}
+
+		auto file = filename(size());
+
+		gpu::sync();
+		std::ofstream out(file, std::ios::binary);
+		out.write(reinterpret_cast<char const *>(raw_pointer_cast(phi.matrix().data_elements())), phi.matrix().num_elements()*sizeof(complex));
+		if(not out) throw std::runtime_error("INQ error: Cannot write the ETRS half-step orbitals to '" + file + "'.");
+		files_.push_back(file);
+	}
+
+	template <typename OrbitalSetType>
+	void restore(int const iphi, OrbitalSetType & phi) const {
+
+		CALI_CXX_MARK_SCOPE("etrs_storage::restore");
+
+		assert(iphi < size());
+
+		if(not spills()){
+			phi.matrix() = orbitals_[iphi]->matrix();
+			return;
+		}
+
+		std::ifstream in(files_[iphi], std::ios::binary);
+		gpu::sync();
+		in.read(reinterpret_cast<char *>(raw_pointer_cast(phi.matrix().data_elements())), phi.matrix().num_elements()*sizeof(complex));
+		if(not in) throw std::runtime_error("INQ error: Cannot read the ETRS half-step orbitals from '" + files_[iphi] + "'.");
+	}
+
+};
+
+}
+}
+#endif
+
+#ifdef INQ_REAL_TIME_ETRS_STORAGE_UNIT_TEST
+#undef INQ_REAL_TIME_ETRS_STORAGE_UNIT_TEST
+
+#include <catch2/catch_all.hpp>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+	using namespace inq;
+	using namespace inq::magnitude;
+	using namespace Catch::literals;
+	using Catch::Approx;
+
+	parallel::communicator comm{boost::mpi3::environment::get_world_instance()};
+	parallel::cartesian_communicator<2> cart_comm(comm, {});
+
+	auto basis_comm = basis::basis_subcomm(cart_comm);
+
+	basis::real_space rs(systems::cell::cubic(4.0_b), /*spacing = */ 0.5, basis_comm);
+
+	auto phi = states::orbital_set<basis::real_space, complex>(rs, 3, 1, vector3<double, covariant>{0.0, 0.0, 0.0}, 0, cart_comm);
+
+	for(int ip = 0; ip < rs.local_size(); ip++){
+		for(int ist = 0; ist < phi.local_set_size(); ist++) phi.matrix()[ip][ist] = complex(0.25*(ip%7) + ist, -0.5*(ip%3));
+	}
+
+	utils::create_directory(comm, "etrs_storage_test");
+
+	utils::workspace work;
+	
+	for(auto directory : {std::string{}, std::string{"etrs_storage_test"}}){
+		auto storage = real_time::etrs_storage(work, directory);
+
+		CHECK(storage.spills() == not directory.empty());
+
+		storage.store(phi);
+		storage.store(phi);
+		CHECK(storage.size() == 2);
+
+		auto restored = states::orbital_set<basis::real_space, complex>(phi.skeleton());
+		restored.fill(0.0);
+		storage.restore(1, restored);
+
+		auto diff = 0.0;
+		for(long ip = 0; ip < rs.local_size(); ip++){
+			for(long ist = 0; ist < phi.local_set_size(); ist++) diff = std::max(diff, fabs(restored.matrix()[ip][ist] - phi.matrix()[ip][ist]));
+		}
+
+		CHECK(diff == 0.0);
+	}
+
+	SECTION("Buffers are reused"){
+		auto num_allocations = work.num_allocations();
+		
+		auto storage = real_time::etrs_storage(work);
+		storage.store(phi);
+		storage.store(phi);
+
+		CHECK(work.num_allocations() == num_allocations);
+	}
+}
+#endif
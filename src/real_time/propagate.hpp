@@ -23,6 +23,7 @@
 #include <utils/profiling.hpp>
 
 #include <chrono>
+#include <optional>
 
 namespace inq {
 namespace real_time {
@@ -33,6 +34,11 @@ void propagate(systems::ions & ions, systems::electrons & electrons, ProcessFunc
 		
 		auto console = electrons.logger();
 
+		// the perturbations and the ionic motion break the symmetries, so all the k-points are needed
+		if(electrons.brillouin_zone().symmetries().size() > 1) {
+			throw std::runtime_error("INQ error: Real-time propagation requires the full Brillouin zone, the k-point grid cannot be reduced with symmetries.");
+		}
+		
 		ionic::propagator::runtime ion_propagator{opts.ion_dynamics_value()};
 	
 		const double dt = opts.dt();
@@ -52,7 +58,7 @@ void propagate(systems::ions & ions, systems::electrons & electrons, ProcessFunc
 
 		hamiltonian::self_consistency sc(inter, electrons.states_basis(), electrons.density_basis(), electrons.states().num_density_components(), pert);
 		hamiltonian::ks_hamiltonian<complex> ham(electrons.states_basis(), electrons.brillouin_zone(), electrons.states(), electrons.atomic_pot(),
-																						 ions, sc.exx_coefficient(), /* use_ace = */ opts.propagator() == options::real_time::electron_propagator::CRANK_NICOLSON);
+																						 ions, sc.exx_coefficient(), /* use_ace = */ true, sc.isolated_poisson_solver());
 		hamiltonian::energy energy;
 
 		sc.update_ionic_fields(electrons.states_comm(), ions, electrons.atomic_pot());
@@ -74,37 +80,59 @@ void propagate(systems::ions & ions, systems::electrons & electrons, ProcessFunc
 		if(console) console->trace("starting real-time propagation");
 		if(console) console->info("step {:9d} :  t =  {:9.3f}  e = {:.12f}", 0, 0.0, energy.total());
 
+		utils::workspace work;
+		
 		auto iter_start_time = std::chrono::high_resolution_clock::now();
+		auto force_ace_rebuild = false;
 		for(int istep = 0; istep < numsteps; istep++){
 			CALI_CXX_MARK_SCOPE("time_step");
 
 			switch(opts.propagator()){
 			case options::real_time::electron_propagator::ETRS :
-				etrs(istep*dt, dt, ions, electrons, ion_propagator, forces, current, ham, sc, energy);
+				{
+					// the ACE operator is rebuilt unconditionally every few steps, or in the step after a rebuild found it inaccurate
+					auto ace_tolerance = (istep%opts.ace_refresh_steps_value() == 0 or force_ace_rebuild) ? 0.0 : opts.ace_refresh_tolerance_value();
+					etrs(istep*dt, dt, ions, electrons, ion_propagator, forces, current, ham, sc, energy, work, ace_tolerance, opts.etrs_spill_value());
+
+					force_ace_rebuild = ham.exchange().enabled() and ham.exchange().ace_error() > opts.ace_refresh_max_error_value();
+					if(ham.exchange().enabled() and console) console->trace("step {:9d} :  ACE error = {:.2e}", istep + 1, ham.exchange().ace_error());
+					if(force_ace_rebuild and console) console->trace("ACE error above {:.2e}, the operator will be rebuilt in the next step", opts.ace_refresh_max_error_value());
+				}
 				break;
 			case options::real_time::electron_propagator::CRANK_NICOLSON :
 				crank_nicolson(istep*dt, dt, ions, electrons, ion_propagator, forces, ham, sc, energy);
 				break;
 			}
 
-			energy.calculate(ham, electrons);
+			// the energy needs an extra application of the Hamiltonian, so it is only calculated for the steps that are sampled
+			auto sample = opts.sampled(istep);
+
+			if(sample) energy.calculate(ham, electrons);
 			
 			if(ion_propagator.needs_force()) forces = hamiltonian::calculate_forces(ions, electrons, ham);
 
 			//propagate ionic velocities to t + dt
 			ion_propagator.propagate_velocities(dt, ions, forces);
 
+			auto step_current = std::optional<vector3<double, covariant>>{};
 			if(sc.has_induced_vector_potential()) {
 				current = observables::current(ions, electrons, ham);
 				sc.propagate_induced_vector_potential_derivative(dt, current);
+				step_current = current;
 			}
 			
-			func(real_time::viewables{istep == numsteps - 1, istep, (istep + 1.0)*dt, ions, electrons, energy, forces, ham, pert});			
+			if(sample) func(real_time::viewables{istep == numsteps - 1, istep, (istep + 1.0)*dt, ions, electrons, energy, forces, ham, pert, step_current});
 			
 			auto new_time = std::chrono::high_resolution_clock::now();
 			std::chrono::duration<double> elapsed_seconds = new_time - iter_start_time;
 			
-			if(console) console->info("step {:9d} :  t =  {:9.3f}  e = {:.12f}  wtime = {:9.3f}", istep + 1, (istep + 1)*dt, energy.total(), elapsed_seconds.count());
+			if(console) {
+				if(sample) {
+					console->info("step {:9d} :  t =  {:9.3f}  e = {:.12f}  wtime = {:9.3f}", istep + 1, (istep + 1)*dt, energy.total(), elapsed_seconds.count());
+				} else {
+					console->info("step {:9d} :  t =  {:9.3f}  wtime = {:9.3f}", istep + 1, (istep + 1)*dt, elapsed_seconds.count());
+				}
+			}
 
 			iter_start_time = new_time;
 		}
@@ -124,5 +152,31 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 	using namespace inq;
 	using namespace Catch::literals;
 	using Catch::Approx;
+
+	using viewables_type = real_time::viewables<gpu::array<vector3<double>, 1>, hamiltonian::ks_hamiltonian<complex>, perturbations::none>;
+	
+	SECTION("Sampling interval and every"){
+		auto numsteps = 103;
+		auto opts = options::real_time{}.num_steps(numsteps).sampling_interval(5);
+		
+		auto num_samples = 0;
+		for(int istep = 0; istep < numsteps; istep++){
+			auto last = (istep == numsteps - 1);
+			if(opts.sampled(istep)) num_samples++;
+
+			// an observer that works every 10 or 20 steps is called in all the steps it uses
+			if(viewables_type::every(istep, last, 10)) CHECK(opts.sampled(istep));
+			if(viewables_type::every(istep, last, 20)) CHECK(opts.sampled(istep));
+		}
+
+		CHECK(num_samples == 22);
+		CHECK(opts.sampled(0));
+		CHECK(opts.sampled(100));
+		CHECK(not opts.sampled(101));
+		CHECK(opts.sampled(102));
+		
+		// without an interval all the steps are sampled
+		for(int istep = 0; istep < numsteps; istep++) CHECK(options::real_time{}.num_steps(numsteps).sampled(istep));
+	}
 }
 #endif
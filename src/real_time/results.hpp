@@ -72,17 +72,18 @@ public:
     utils::load_value(dirname + "/total_steps",     res.total_steps,     error_message);
     utils::load_value(dirname + "/total_time",      res.total_time,      error_message);
 		
-		res.time.resize(res.total_steps + 1);
-		utils::load_array(dirname + "/time",            res.time,            error_message);
+		// with a sampling interval there are fewer samples than steps
+		utils::load_vector(dirname + "/time",            res.time);
+		if(res.time.size() == 0) throw std::runtime_error(error_message);
 
-		res.total_energy.resize(res.total_steps + 1);
-		utils::load_array(dirname + "/total_energy",    res.total_energy,    error_message);
+		utils::load_vector(dirname + "/total_energy",    res.total_energy);
+		assert(res.total_energy.size() == res.time.size());
 
 		utils::load_vector(dirname + "/dipole",         res.dipole);
-		assert((long) res.dipole.size() == res.total_steps + 1 or res.dipole.size() == 0ul);
+		assert(res.dipole.size() == res.time.size() or res.dipole.size() == 0ul);
 
 		utils::load_vector(dirname + "/current",        res.current);
-		assert((long) res.current.size() == res.total_steps + 1 or res.current.size() == 0ul);
+		assert(res.current.size() == res.time.size() or res.current.size() == 0ul);
 
     return res;
 	}
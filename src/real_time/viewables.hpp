@@ -21,6 +21,7 @@
 #include <utils/profiling.hpp>
 
 #include <chrono>
+#include <optional>
 
 namespace inq {
 namespace real_time {
@@ -36,11 +37,14 @@ class viewables {
 	ForcesType forces_;
   HamiltonianType const & ham_;
 	Perturbation const & pert_;
+	std::optional<vector3<double, covariant>> current_;
 	
 public:
 
-	viewables(bool last_iter, int iter, double time, systems::ions const & ions, systems::electrons const & electrons, hamiltonian::energy const & energy, ForcesType const & forces, HamiltonianType const & ham, Perturbation const & pert)
-		:last_iter_(last_iter), iter_(iter), time_(time), ions_(ions), electrons_(electrons), energy_(energy), forces_(forces), ham_(ham), pert_(pert){
+	// the current can be given if it was already calculated for this step
+	viewables(bool last_iter, int iter, double time, systems::ions const & ions, systems::electrons const & electrons, hamiltonian::energy const & energy, ForcesType const & forces, HamiltonianType const & ham, Perturbation const & pert,
+						std::optional<vector3<double, covariant>> const & current = {})
+		:last_iter_(last_iter), iter_(iter), time_(time), ions_(ions), electrons_(electrons), energy_(energy), forces_(forces), ham_(ham), pert_(pert), current_(current){
 	}
 
 	auto iter() const {
@@ -51,9 +55,13 @@ public:
 		return last_iter_;
 	}
 
+	static auto every(int iter, bool last_iter, int every_iter) {
+		if(iter == 0) return false;
+		return (iter%every_iter == 0) or last_iter; 
+	}
+	
 	auto every(int every_iter) const {
-		if(iter() == 0) return false;
-		return (iter()%every_iter == 0) or last_iter(); 
+		return every(iter(), last_iter(), every_iter);
 	}
 
 	auto root() const {
@@ -109,6 +117,7 @@ public:
 
 
   auto current() const {
+		if(current_.has_value()) return ions_.cell().metric().to_cartesian(*current_);
     return ions_.cell().metric().to_cartesian(observables::current(ions_, electrons_, ham_));
   }
 
@@ -16,16 +16,51 @@
 #include <basis/fourier_space.hpp>
 #include <operations/transform.hpp>
 #include <operations/transfer.hpp>
+#include <options/theory.hpp>
 
 #include <utils/profiling.hpp>
 
+#include <list>
+
 namespace inq {
 namespace solvers {
 
 class poisson {
 
+	struct kernel_cache_entry {
+		vector3<double> gshift;
+		int periodicity;
+		double zeroterm;
+		basis::field<basis::fourier_space, double> kernel;
+	};
+
+	options::theory::poisson_solver isolated_method_;
+	long kernel_cache_capacity_;
+	mutable std::list<kernel_cache_entry> kernel_cache_;
+	mutable operations::transfer::plan_cache transfer_plans_;
+	
 public:
 
+	poisson(options::theory::poisson_solver isolated_method = options::theory::poisson_solver::CUTOFF, long kernel_cache_capacity = 16):
+		isolated_method_(isolated_method),
+		kernel_cache_capacity_(kernel_cache_capacity){
+		assert(kernel_cache_capacity_ > 0);
+	}
+
+	auto isolated_method() const {
+		return isolated_method_;
+	}
+
+	auto kernel_cache_size() const {
+		return long(kernel_cache_.size());
+	}
+
+	void clear_kernel_cache() const {
+		kernel_cache_.clear();
+	}
+	
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+
 	struct poisson_kernel_3d {
 		GPU_FUNCTION auto operator()(vector3<double, cartesian> gg, double const zeroterm) const {
 			auto g2 = norm(gg);
@@ -66,25 +101,143 @@ public:
 	
 	///////////////////////////////////////////////////////////////////////////////////////////////////
 	
+	// The kernel for a given (basis, gshift, zeroterm) is stored already scaled, so applying it
+	// is a single multiplication. The cache keeps the most recently used kernels, up to
+	// kernel_cache_capacity_ of them; the exchange operator only needs one per (k - q) shift.
+
+	static bool same_basis(basis::fourier_space const & bas1, basis::fourier_space const & bas2) {
+		if(not (bas1 == bas2) or not (bas1.cell() == bas2.cell())) return false;
+		for(int idir = 0; idir < 3; idir++){
+			if(bas1.cubic_part(idir).start() != bas2.cubic_part(idir).start()) return false;
+			if(bas1.cubic_part(idir).local_size() != bas2.cubic_part(idir).local_size()) return false;
+		}
+		return true;
+	}
+	
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+
+	template <typename BuildType>
+	basis::field<basis::fourier_space, double> const & cached_kernel(basis::fourier_space const & fourier_basis, vector3<double> const & gshift, double const zeroterm, BuildType && build) const {
+
+		auto periodicity = fourier_basis.cell().periodicity();
+		
+		for(auto it = kernel_cache_.begin(); it != kernel_cache_.end(); ++it){
+			if(it->periodicity != periodicity or it->zeroterm != zeroterm) continue;
+			if(it->gshift[0] != gshift[0] or it->gshift[1] != gshift[1] or it->gshift[2] != gshift[2]) continue;
+			if(not same_basis(it->kernel.basis(), fourier_basis)) continue;
+			
+			// move it to the front, so the least recently used is at the back
+			kernel_cache_.splice(kernel_cache_.begin(), kernel_cache_, it);
+			return kernel_cache_.front().kernel;
+		}
+
+		CALI_CXX_MARK_SCOPE("poisson::kernel_cache_miss");
+		
+		while(not kernel_cache_.empty() and long(kernel_cache_.size()) >= kernel_cache_capacity_) kernel_cache_.pop_back();
+		kernel_cache_.emplace_front(kernel_cache_entry{gshift, periodicity, zeroterm, build()});
+		return kernel_cache_.front().kernel;
+	}
+	
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+
+	template <typename KernelType>
+	basis::field<basis::fourier_space, double> calculate_kernel(KernelType const kernel, basis::fourier_space const & fourier_basis, vector3<double> const & gshift, double const zeroterm) const {
+
+		CALI_CXX_MARK_FUNCTION;
+		
+		basis::field<basis::fourier_space, double> kernel_field(fourier_basis);
+		
+		gpu::run(fourier_basis.local_sizes()[2], fourier_basis.local_sizes()[1], fourier_basis.local_sizes()[0],
+						 [point_op = fourier_basis.point_op(), ker = begin(kernel_field.cubic()), scal = (-4.0*M_PI)/fourier_basis.size(), kernel, gshift, zeroterm] GPU_LAMBDA (auto iz, auto iy, auto ix){
+							 ker[ix][iy][iz] = scal*kernel(point_op.gvector_cartesian(ix, iy, iz) + gshift, zeroterm/(-4*M_PI));
+						 });
+
+		return kernel_field;
+	}
+	
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+
+	template <typename FieldSetType>
+	void poisson_multiply_kernel(basis::field<basis::fourier_space, double> const & kernel, FieldSetType & density) const {
+
+		static_assert(std::is_same_v<typename FieldSetType::basis_type, basis::fourier_space>, "Only makes sense in fourier_space");
+		assert(kernel.basis() == density.basis());
+		
+		CALI_CXX_MARK_FUNCTION;
+
+		gpu::run(density.basis().local_sizes()[2], density.basis().local_sizes()[1], density.basis().local_sizes()[0],
+						 [ker = begin(kernel.cubic()), dens = begin(density.hypercubic()), nst = density.local_set_size()] GPU_LAMBDA (auto iz, auto iy, auto ix){
+							 for(int ist = 0; ist < nst; ist++) dens[ix][iy][iz][ist] *= ker[ix][iy][iz];
+						 });
+	}
+	
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+	
 	template <typename KernelType, typename FieldSetType>
 	void poisson_apply_kernel(KernelType const kernel, FieldSetType & density, vector3<double> const & gshift = {0.0, 0.0, 0.0}, double const zeroterm = 0.0) const {
 
 		static_assert(std::is_same_v<typename FieldSetType::basis_type, basis::fourier_space>, "Only makes sense in fourier_space");
 
 		CALI_CXX_MARK_FUNCTION;
+
+		auto & kernel_field = cached_kernel(density.basis(), gshift, zeroterm, [&] { return calculate_kernel(kernel, density.basis(), gshift, zeroterm); });
+		poisson_multiply_kernel(kernel_field, density);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+
+	// The Martyna-Tuckerman kernel for isolated systems, G. J. Martyna and M. E. Tuckerman, J. Chem. Phys. 110, 2810 (1999).
+	//
+	// The Coulomb interaction is split as 1/r = erfc(alpha r)/r + erf(alpha r)/r. The first
+	// part is short range and its transform is analytic, the second one is smooth and it is
+	// transformed numerically over the cell using the minimum image convention. The result
+	// is exact as long as the density is contained in the central half of the cell, so no
+	// enlarged box is needed.
+	
+	basis::field<basis::fourier_space, double> calculate_martyna_tuckerman_kernel(basis::real_space const & real_basis, basis::fourier_space const & fourier_basis) const {
+
+		CALI_CXX_MARK_FUNCTION;
+
+		// erfc(alpha*L/2) ~ 1e-8, and the erf term is still smooth on any reasonable grid
+		auto alpha = 8.0/real_basis.min_rlength();
 		
-		const double scal = (-4.0*M_PI)/density.basis().size();
+		basis::field<basis::real_space, double> long_range(real_basis);
+
+		gpu::run(real_basis.local_sizes()[2], real_basis.local_sizes()[1], real_basis.local_sizes()[0],
+						 [point_op = real_basis.point_op(), lr = begin(long_range.cubic()), alpha] GPU_LAMBDA (auto iz, auto iy, auto ix){
+							 auto rr = point_op.rlength(ix, iy, iz);
+							 if(rr < 1e-12) {
+								 lr[ix][iy][iz] = 2.0*alpha/sqrt(M_PI);
+							 } else {
+								 lr[ix][iy][iz] = erf(alpha*rr)/rr;
+							 }
+						 });
+
+		auto long_range_fs = fourier_basis.half_spectrum() ? operations::transform::to_fourier_r2c(long_range) : operations::transform::to_fourier(complex_field(long_range));
+		assert(long_range_fs.basis() == fourier_basis);
 		
-		gpu::run(density.basis().local_sizes()[2], density.basis().local_sizes()[1], density.basis().local_sizes()[0],
-						 [point_op = density.basis().point_op(), dens = begin(density.hypercubic()), scal, nst = density.local_set_size(), kernel, gshift, zeroterm] GPU_LAMBDA (auto iz, auto iy, auto ix){
-							 
-							 auto kerg = kernel(point_op.gvector_cartesian(ix, iy, iz) + gshift, zeroterm/(-4*M_PI));
-							 for(int ist = 0; ist < nst; ist++) dens[ix][iy][iz][ist] *= scal*kerg;
+		basis::field<basis::fourier_space, double> kernel(fourier_basis);
+		
+		gpu::run(fourier_basis.local_sizes()[2], fourier_basis.local_sizes()[1], fourier_basis.local_sizes()[0],
+						 [point_op = fourier_basis.point_op(), ker = begin(kernel.cubic()), lr = begin(long_range_fs.cubic()), alpha,
+							vol_element = real_basis.volume_element(), scal = 1.0/real_basis.size()] GPU_LAMBDA (auto iz, auto iy, auto ix){
+							 auto g2 = point_op.g2(ix, iy, iz);
+							 auto short_range = M_PI/(alpha*alpha);
+							 if(g2 > 1e-12) short_range = 4.0*M_PI/g2*(1.0 - exp(-0.25*g2/(alpha*alpha)));
+							 ker[ix][iy][iz] = scal*(short_range + vol_element*real(lr[ix][iy][iz]));
 						 });
+
+		return kernel;
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////////////////
 
+	auto & martyna_tuckerman_kernel(basis::real_space const & real_basis, basis::fourier_space const & fourier_basis) const {
+		return cached_kernel(fourier_basis, {0.0, 0.0, 0.0}, 0.0, [&] { return calculate_martyna_tuckerman_kernel(real_basis, fourier_basis); });
+	}
+	
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+
 private:
 	
 	auto poisson_solve_3d(basis::field<basis::real_space, complex> const & density) const {
@@ -113,14 +266,14 @@ private:
 
 		CALI_CXX_MARK_FUNCTION;
 
-		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge({1, 1, 2}));
+		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge({1, 1, 2}), transfer_plans_);
 		auto potential_fs = operations::transform::to_fourier(potential2x);
 
 		const auto cutoff_radius = density.basis().rlength()[2];
 		poisson_apply_kernel(poisson_kernel_2d{cutoff_radius}, potential_fs);
 
 		potential2x = operations::transform::to_real(potential_fs,  /*normalize = */ false);
-		auto potential = operations::transfer::shrink(potential2x, density.basis());
+		auto potential = operations::transfer::shrink(potential2x, density.basis(), transfer_plans_);
 
 		return potential;
 	}
@@ -131,14 +284,14 @@ private:
 
 		CALI_CXX_MARK_FUNCTION;
 
-		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge({1, 1, 2}));
+		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge({1, 1, 2}), transfer_plans_);
 		auto potential_fs = operations::transform::to_fourier(std::move(potential2x));
 			
 		const auto cutoff_radius = density.basis().rlength()[2];
 		poisson_apply_kernel(poisson_kernel_2d{cutoff_radius}, potential_fs, gshift, zeroterm);
 		
 		potential2x = operations::transform::to_real(std::move(potential_fs),  /*normalize = */ false);
-		density = operations::transfer::shrink(potential2x, density.basis());
+		density = operations::transfer::shrink(potential2x, density.basis(), transfer_plans_);
 	}
 
 	///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -147,14 +300,14 @@ private:
 
 		CALI_CXX_MARK_FUNCTION;
 
-		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge(2));
+		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge(2), transfer_plans_);
 		auto potential_fs = operations::transform::to_fourier(potential2x);
 			
 		const auto cutoff_radius = potential2x.basis().min_rlength()/2.0;
 		poisson_apply_kernel(poisson_kernel_0d{cutoff_radius}, potential_fs);
 		
 		potential2x = operations::transform::to_real(potential_fs,  /*normalize = */ false);
-		auto potential = operations::transfer::shrink(potential2x, density.basis());
+		auto potential = operations::transfer::shrink(potential2x, density.basis(), transfer_plans_);
 
 		return potential;
 	}
@@ -165,16 +318,79 @@ private:
 
 		CALI_CXX_MARK_FUNCTION;
 
-		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge(2));
+		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge(2), transfer_plans_);
 		auto potential_fs = operations::transform::to_fourier(std::move(potential2x));
 			
 		const auto cutoff_radius = potential2x.basis().min_rlength()/2.0;
 		poisson_apply_kernel(poisson_kernel_0d{cutoff_radius}, potential_fs, gshift, zeroterm);
 
 		potential2x = operations::transform::to_real(std::move(potential_fs),  /*normalize = */ false);
-		density = operations::transfer::shrink(potential2x, density.basis());
+		density = operations::transfer::shrink(potential2x, density.basis(), transfer_plans_);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+
+	// For real densities we use real-to-complex transforms that only store half of the spectrum
+	
+	basis::field<basis::real_space, double> poisson_solve_3d(basis::field<basis::real_space, double> const & density) const {
+
+		CALI_CXX_MARK_FUNCTION;
+		
+		auto potential_fs = operations::transform::to_fourier_r2c(density);
+		poisson_apply_kernel(poisson_kernel_3d{}, potential_fs);
+		return operations::transform::to_real_c2r(potential_fs,  /*normalize = */ false);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	basis::field<basis::real_space, double> poisson_solve_2d(basis::field<basis::real_space, double> const & density) const {
+
+		CALI_CXX_MARK_FUNCTION;
+
+		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge({1, 1, 2}), transfer_plans_);
+		auto potential_fs = operations::transform::to_fourier_r2c(potential2x);
+
+		const auto cutoff_radius = density.basis().rlength()[2];
+		poisson_apply_kernel(poisson_kernel_2d{cutoff_radius}, potential_fs);
+
+		potential2x = operations::transform::to_real_c2r(potential_fs,  /*normalize = */ false);
+		return operations::transfer::shrink(potential2x, density.basis(), transfer_plans_);
+	}
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	basis::field<basis::real_space, double> poisson_solve_0d(basis::field<basis::real_space, double> const & density) const {
+
+		CALI_CXX_MARK_FUNCTION;
+
+		auto potential2x = operations::transfer::enlarge(density, density.basis().enlarge(2), transfer_plans_);
+		auto potential_fs = operations::transform::to_fourier_r2c(potential2x);
+			
+		const auto cutoff_radius = potential2x.basis().min_rlength()/2.0;
+		poisson_apply_kernel(poisson_kernel_0d{cutoff_radius}, potential_fs);
+		
+		potential2x = operations::transform::to_real_c2r(potential_fs,  /*normalize = */ false);
+		return operations::transfer::shrink(potential2x, density.basis(), transfer_plans_);
 	}
+	
+	///////////////////////////////////////////////////////////////////////////////////////////////////
+
+	template <typename FieldType>
+	auto poisson_solve_martyna_tuckerman(FieldType const & density) const {
 
+		CALI_CXX_MARK_FUNCTION;
+
+		if constexpr(std::is_same_v<typename FieldType::element_type, double>) {
+			auto potential_fs = operations::transform::to_fourier_r2c(density);
+			poisson_multiply_kernel(martyna_tuckerman_kernel(density.basis(), potential_fs.basis()), potential_fs);
+			return operations::transform::to_real_c2r(potential_fs,  /*normalize = */ false);
+		} else {
+			auto potential_fs = operations::transform::to_fourier(density);
+			poisson_multiply_kernel(martyna_tuckerman_kernel(density.basis(), potential_fs.basis()), potential_fs);
+			return operations::transform::to_real(potential_fs,  /*normalize = */ false);
+		}
+	}
+	
 	///////////////////////////////////////////////////////////////////////////////////////////////////
 	
 public:
@@ -187,6 +403,8 @@ public:
 			return poisson_solve_3d(density);
 		} else if(density.basis().cell().periodicity() == 2){
 			return poisson_solve_2d(density);
+		} else if(isolated_method_ == options::theory::poisson_solver::MARTYNA_TUCKERMAN) {
+			return poisson_solve_martyna_tuckerman(density);
 		} else {
 			return poisson_solve_0d(density);
 		}
@@ -205,6 +423,10 @@ public:
 			poisson_solve_in_place_3d(density, gshift_cart, zeroterm);
 		} else if(density.basis().cell().periodicity() == 2){
 			return poisson_solve_in_place_2d(density, gshift_cart, zeroterm);
+		} else if(isolated_method_ == options::theory::poisson_solver::MARTYNA_TUCKERMAN) {
+			// finite systems only have the gamma point, so there is no shift
+			assert(norm(gshift_cart) < 1e-12);
+			density = poisson_solve_martyna_tuckerman(density);
 		} else {
 			poisson_solve_in_place_0d(density, gshift_cart, zeroterm);
 		}
@@ -215,9 +437,16 @@ public:
 	basis::field<basis::real_space, double> operator()(const basis::field<basis::real_space, double> & density) const {
 
 		CALI_CXX_MARK_SCOPE("poisson(real)");
-		
-		auto complex_potential = operator()(complex_field(density));
-		return real_field(complex_potential);
+
+		if(density.basis().cell().periodicity() == 3){
+			return poisson_solve_3d(density);
+		} else if(density.basis().cell().periodicity() == 2){
+			return poisson_solve_2d(density);
+		} else if(isolated_method_ == options::theory::poisson_solver::MARTYNA_TUCKERMAN) {
+			return poisson_solve_martyna_tuckerman(density);
+		} else {
+			return poisson_solve_0d(density);
+		}
 	}
 		
 };    
@@ -470,6 +699,84 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 				if(part.contains(368648)) CHECK(real(density_set.matrix()[part.global_to_local(parallel::global_index(368648))][ist])/(1.0 + ist) ==  -0.1844298173_a);
 			}
 		}
+
+		SECTION("Point charge finite real"){
+
+			field<real_space, double> rdensity(rs);
+			
+			for(int ix = 0; ix < rs.local_sizes()[0]; ix++){
+				for(int iy = 0; iy < rs.local_sizes()[1]; iy++){
+					for(int iz = 0; iz < rs.local_sizes()[2]; iz++){
+						rdensity.cubic()[ix][iy][iz] = 0.0;
+						if(rs.point_op().r2(ix, iy, iz) < 1e-10) rdensity.cubic()[ix][iy][iz] = -1.0/rs.volume_element();
+					}
+				}
+			}
+
+			auto rpotential = psolver(rdensity);
+			auto cpotential = psolver(complex_field(rdensity));
+
+			double diff = 0.0;
+			for(long ip = 0; ip < rs.local_size(); ip++) diff += fabs(rpotential.linear()[ip] - real(cpotential.linear()[ip]));
+			comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+
+			CHECK(diff/rs.size() < 1e-12);
+			
+			auto & part = rpotential.basis().part();
+			if(part.contains(0))      CHECK(rpotential.linear()[part.global_to_local(parallel::global_index(0))]      == -27.175214167_a);
+			if(part.contains(368648)) CHECK(rpotential.linear()[part.global_to_local(parallel::global_index(368648))] ==  -0.1844298173_a);
+		}
+
+		SECTION("Point charge finite Martyna-Tuckerman"){
+
+			solvers::poisson mtsolver(options::theory::poisson_solver::MARTYNA_TUCKERMAN);
+
+			CHECK(mtsolver.isolated_method() == options::theory::poisson_solver::MARTYNA_TUCKERMAN);
+			
+			field<real_space, double> rdensity(rs);
+			
+			for(int ix = 0; ix < rs.local_sizes()[0]; ix++){
+				for(int iy = 0; iy < rs.local_sizes()[1]; iy++){
+					for(int iz = 0; iz < rs.local_sizes()[2]; iz++){
+						rdensity.cubic()[ix][iy][iz] = 0.0;
+						for(int ist = 0; ist < nst; ist++) density_set.hypercubic()[ix][iy][iz][ist] = 0.0;
+						if(rs.point_op().r2(ix, iy, iz) < 1e-10) {
+							rdensity.cubic()[ix][iy][iz] = -1.0/rs.volume_element();
+							for(int ist = 0; ist < nst; ist++) density_set.hypercubic()[ix][iy][iz][ist] = -(1.0 + ist)/rs.volume_element();
+						}
+					}
+				}
+			}
+
+			auto rpotential = mtsolver(rdensity);
+			auto cpotential = mtsolver(complex_field(rdensity));
+			mtsolver.in_place(density_set);
+
+			double diff = 0.0;
+			for(long ip = 0; ip < rs.local_size(); ip++) {
+				diff += fabs(rpotential.linear()[ip] - real(cpotential.linear()[ip]));
+				for(int ist = 0; ist < nst; ist++) diff += fabs(real(density_set.matrix()[ip][ist])/(1.0 + ist) - real(cpotential.linear()[ip]));
+			}
+			comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+
+			CHECK(diff/rs.size() < 1e-12);
+			
+			for(int ix = 0; ix < rs.local_sizes()[0]; ix++){
+				for(int iy = 0; iy < rs.local_sizes()[1]; iy++){
+					for(int iz = 0; iz < rs.local_sizes()[2]; iz++){
+						
+						auto ixg = rs.cubic_part(0).local_to_global(ix);
+						auto iyg = rs.cubic_part(1).local_to_global(iy);
+						auto izg = rs.cubic_part(2).local_to_global(iz);
+
+						auto rr = rs.point_op().rlength(ixg, iyg, izg);
+
+						// the minimum image of -1/r, without the need of a larger box
+						if(rr > 1) CHECK(fabs(rpotential.cubic()[ix][iy][iz]*rr + 1.0) < 0.025);
+					}
+				}
+			}
+		}
 	}
 
 	SECTION("Point charge 2d periodic"){
@@ -522,5 +829,57 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		}
 		
 	}
+
+	SECTION("Kernel cache"){
+		
+		basis::real_space rs(systems::cell::cubic(5.0_b), /*spacing =*/ 0.2, comm);
+
+		int const nst = 2;
+		
+		field_set<real_space, complex> density_set(rs, nst);
+
+		for(int ix = 0; ix < rs.local_sizes()[0]; ix++){
+			for(int iy = 0; iy < rs.local_sizes()[1]; iy++){
+				for(int iz = 0; iz < rs.local_sizes()[2]; iz++){
+					auto rr = rs.point_op().rvector_cartesian(ix, iy, iz);
+					for(int ist = 0; ist < nst; ist++) density_set.hypercubic()[ix][iy][iz][ist] = complex(cos(rr[0] + ist), sin(rr[1]));
+				}
+			}
+		}
+
+		auto shifts = std::vector<vector3<double, covariant>>{{0.0, 0.0, 0.0}, {0.0, 0.0, 0.5}, {0.25, 0.0, 0.5}};
+		
+		solvers::poisson psolver(options::theory::poisson_solver::CUTOFF, /* kernel_cache_capacity = */ 2);
+
+		CHECK(psolver.kernel_cache_size() == 0);
+		
+		for(int iter = 0; iter < 2; iter++){
+			for(unsigned ishift = 0; ishift < shifts.size(); ishift++){
+				
+				auto cached = density_set;
+				psolver.in_place(cached, shifts[ishift], 0.3);
+
+				CHECK(psolver.kernel_cache_size() == std::min(2l, long(ishift + 1 + 3*iter)));
+
+				// the same result as a solver that has to compute the kernel
+				auto reference = density_set;
+				solvers::poisson{}.in_place(reference, shifts[ishift], 0.3);
+
+				double diff = 0.0;
+				for(long ip = 0; ip < rs.local_size(); ip++){
+					for(int ist = 0; ist < nst; ist++) diff += fabs(cached.matrix()[ip][ist] - reference.matrix()[ip][ist]);
+				}
+				comm.all_reduce_in_place_n(&diff, 1, std::plus<>{});
+				CHECK(diff < 1e-14);
+
+				// a repeated call reuses the kernel
+				psolver.in_place(cached, shifts[ishift], 0.3);
+				CHECK(psolver.kernel_cache_size() == std::min(2l, long(ishift + 1 + 3*iter)));
+			}
+		}
+
+		psolver.clear_kernel_cache();
+		CHECK(psolver.kernel_cache_size() == 0);
+	}
 }
 #endif
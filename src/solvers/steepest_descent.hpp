@@ -29,7 +29,6 @@ double steepest_descent(const operator_type & ham, const preconditioner_type & p
 
 	const int num_steps = 5;
 
-	auto mm = gpu::array<typename field_set_type::element_type, 2>({3, phi.local_set_size()});
 	auto lambda = gpu::array<typename field_set_type::element_type, 1>(phi.local_set_size());
 	auto normres = gpu::array<double, 1>(phi.local_set_size());
 
@@ -44,9 +43,7 @@ double steepest_descent(const operator_type & ham, const preconditioner_type & p
 		prec(sd);
 		auto hsd = ham(sd);
       
-		mm[0] = operations::overlap_diagonal(hsd, hsd);
-		mm[1] = operations::overlap_diagonal(residual, hsd);
-		mm[2] = operations::overlap_diagonal(residual, residual);
+		auto mm = operations::overlap_diagonal_multi(operations::overlap_pair(hsd, hsd), operations::overlap_pair(residual, hsd), operations::overlap_pair(residual, residual));
 
 		/*
 		//Debugging output
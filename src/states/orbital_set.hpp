@@ -10,7 +10,10 @@
 // file, You can obtain one at https://mozilla.org/MPL/2.0/.
 
 #include <basis/field_set.hpp>
+#include <gpu/reduce.hpp>
+#include <gpu/run.hpp>
 #include <states/index.hpp>
+#include <utils/raw_pointer_cast.hpp>
 
 namespace inq {
 namespace states {
@@ -92,6 +95,13 @@ public:
 			assert(spin_index_ >= 0 and spin_index_ < 2);
 			return spin_index_;
 	}
+
+	// only the labels change, this is used to reuse the memory of a set for another kpoint or spin
+	void relabel(kpoint_type const & kpoint, int const spin_index) {
+		assert(spin_index >= 0 and spin_index < 2);
+		kpoint_ = kpoint;
+		spin_index_ = spin_index;
+	}
 	
 	auto & set_part() const {
 		return fields_.set_part();
@@ -175,6 +185,76 @@ public:
 	}
 };
 
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Conversion between element types, for example between the real
+// orbitals of the Gamma-point real mode and the complex orbitals of
+// the electrons, or between precisions.
+
+template <class Basis, class Type, class NewType>
+void change_precision(orbital_set<Basis, Type> const & phi, orbital_set<Basis, NewType> & newphi) {
+
+	CALI_CXX_MARK_FUNCTION;
+
+	assert(phi.basis().local_size() == newphi.basis().local_size());
+	assert(phi.local_set_size() == newphi.local_set_size());
+	
+	gpu::run(phi.local_set_size(), phi.basis().local_size(),
+					 [ph = begin(phi.matrix()), nph = begin(newphi.matrix())] GPU_LAMBDA (auto ist, auto ip){
+						 nph[ip][ist] = NewType(ph[ip][ist]);
+					 });
+}
+
+template <class NewType, class Basis, class Type>
+orbital_set<Basis, NewType> change_precision(orbital_set<Basis, Type> const & phi) {
+	orbital_set<Basis, NewType> newphi(phi.skeleton());
+	change_precision(phi, newphi);
+	return newphi;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// Conversion between real and complex orbitals, real orbitals can
+// only be used at the Gamma point.
+
+template <class MatrixType>
+struct square_sum_mult {
+	MatrixType mat;
+	
+	GPU_FUNCTION auto operator()(long ist, long ip) const {
+		return mat[ip][ist]*mat[ip][ist];
+	}
+};
+
+// Each orbital is multiplied by the phase that makes the sum of its
+// squares real and positive before taking the real part. An orbital
+// that is real up to a phase is recovered exactly, for the others
+// this keeps as much of the norm as possible. The result is not
+// orthonormal in general, it has to be orthonormalized.
+template <class Basis>
+orbital_set<Basis, double> real_field(orbital_set<Basis, complex> const & phi) {
+
+	CALI_CXX_MARK_FUNCTION;
+	
+	auto sum2 = gpu::run(phi.local_set_size(), gpu::reduce(phi.basis().local_size()), square_sum_mult<decltype(begin(phi.matrix()))>{begin(phi.matrix())});
+	if(phi.basis().comm().size() > 1) phi.basis().comm().all_reduce_in_place_n(raw_pointer_cast(sum2.data_elements()), sum2.size(), std::plus<>{});
+	
+	orbital_set<Basis, double> rphi(phi.skeleton());
+
+	gpu::run(phi.local_set_size(), phi.basis().local_size(),
+					 [ph = begin(phi.matrix()), rph = begin(rphi.matrix()), s2 = begin(sum2)] GPU_LAMBDA (auto ist, auto ip){
+						 auto phase = (norm(s2[ist]) > 0.0) ? polar(1.0, -0.5*arg(s2[ist])) : complex(1.0, 0.0);
+						 rph[ip][ist] = real(phase*ph[ip][ist]);
+					 });
+
+	return rphi;
+}
+
+template <class Basis>
+orbital_set<Basis, complex> complex_field(orbital_set<Basis, double> const & rphi) {
+	orbital_set<Basis, complex> phi(rphi.skeleton());
+	change_precision(rphi, phi);
+	return phi;
+}
+
 }
 }
 #endif
@@ -296,6 +376,59 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG){
 
 	}
 	
+	SECTION("Change precision"){
+		
+		states::orbital_set<basis::real_space, complex> zorb(rs, 12, 1, {0.4, 0.22, -0.57}, 1, cart_comm);
+
+		for(int ip = 0; ip < zorb.basis().local_size(); ip++){
+			for(int ist = 0; ist < zorb.local_set_size(); ist++) zorb.matrix()[ip][ist] = complex(1.0/(ip + 3.0), ist + 0.1);
+		}
+
+		auto forb = states::change_precision<complex_float>(zorb);
+		static_assert(std::is_same_v<decltype(forb), states::orbital_set<basis::real_space, complex_float>>);
+
+		CHECK(forb.kpoint() == zorb.kpoint());
+		CHECK(forb.spin_index() == 1);
+		CHECK(forb.local_set_size() == zorb.local_set_size());
+
+		states::orbital_set<basis::real_space, complex> zorb2(zorb.skeleton());
+		states::change_precision(forb, zorb2);
+
+		for(int ip = 0; ip < zorb.basis().local_size(); ip++){
+			for(int ist = 0; ist < zorb.local_set_size(); ist++) {
+				CHECK(forb.matrix()[ip][ist].real() == Catch::Approx(1.0/(ip + 3.0)));
+				CHECK(fabs(zorb2.matrix()[ip][ist] - zorb.matrix()[ip][ist]) < 1e-6*fabs(zorb.matrix()[ip][ist]));
+			}
+		}
+	}
+
+	SECTION("Real and complex"){
+		states::orbital_set<basis::real_space, complex> zorb(rs, 7, 1, vector3<double, covariant>{0.0, 0.0, 0.0}, 0, cart_comm);
+
+		// real functions multiplied by a different phase for each orbital
+		for(int ip = 0; ip < zorb.basis().local_size(); ip++){
+			for(int ist = 0; ist < zorb.local_set_size(); ist++) {
+				auto istg = zorb.set_part().local_to_global(ist).value();
+				zorb.matrix()[ip][ist] = polar(1.0, 0.3 + 0.7*istg)*(ip + 0.5*istg - 3.0);
+			}
+		}
+
+		auto rorb = states::real_field(zorb);
+		static_assert(std::is_same_v<decltype(rorb), states::orbital_set<basis::real_space, double>>);
+		CHECK(rorb.local_set_size() == zorb.local_set_size());
+
+		auto zorb2 = states::complex_field(rorb);
+		static_assert(std::is_same_v<decltype(zorb2), states::orbital_set<basis::real_space, complex>>);
+
+		// the phase is removed, up to a sign
+		for(int ip = 0; ip < zorb.basis().local_size(); ip++){
+			for(int ist = 0; ist < zorb.local_set_size(); ist++) {
+				CHECK(fabs(rorb.matrix()[ip][ist]) == Catch::Approx(fabs(zorb.matrix()[ip][ist])).margin(1e-12));
+				CHECK(zorb2.matrix()[ip][ist] == complex(rorb.matrix()[ip][ist], 0.0));
+			}
+		}
+	}
+	
 	states::orbital_set<basis::real_space, double> rr(rs, 12, 1, {0.4, 0.22, -0.57}, 0, cart_comm);
 	rr.fill(1.0/set_comm.size());
 	rr.all_reduce(set_comm);
@@ -136,16 +136,16 @@ public:
 	electrons(input::parallelization const & dist, const inq::systems::ions & ions, const options::electrons & conf = {}, KptsType const & kpts = input::kpoints::gamma()):
 		brillouin_zone_(ions, kpts),
 		atomic_pot_(ions.species_list(), basis::real_space::gcutoff(ions.cell(), conf.spacing_value()), conf),
-		states_(conf.spin_val(), atomic_pot_.num_electrons(ions.symbols()) + conf.extra_electrons_val(), conf.extra_states_val(), conf.temperature_val(), kpts.size()),
+		states_(conf.spin_val(), atomic_pot_.num_electrons(ions.symbols()) + conf.extra_electrons_val(), conf.extra_states_val(), conf.temperature_val(), brillouin_zone_.size()),
 		full_comm_(dist.cart_comm(conf.num_spin_components_val(), brillouin_zone_.size(), states_.num_states())),
 		kpin_comm_(kpin_subcomm(full_comm_)),
 		kpin_states_comm_(kpin_states_subcomm(full_comm_)),
 		states_comm_(states_subcomm(full_comm_)),
 		states_basis_comm_(states_basis_subcomm(full_comm_)),
-		states_basis_(ions.cell(), conf.spacing_value(), basis_subcomm(full_comm_)),
+		states_basis_(ions.cell(), conf.spacing_value(), basis_subcomm(full_comm_), dist.pencil_nproc()),
 		density_basis_(states_basis_), /* disable the fine density mesh for now density_basis_(states_basis_.refine(conf.density_factor(), basis_comm_)), */
 		spin_density_(density_basis_, states_.num_density_components()),
-		kpin_part_(kpts.size()*states_.num_spin_indices(), kpin_comm_)
+		kpin_part_(brillouin_zone_.size()*states_.num_spin_indices(), kpin_comm_)
 	{
 		CALI_CXX_MARK_FUNCTION;
 
@@ -158,7 +158,7 @@ public:
 		parallel::cartesian_communicator<2> spin_kpoints_comm(kpin_comm_, {nproc_spin, boost::mpi3::fill});
 
 		parallel::partition spin_part(states_.num_spin_indices(), spin_kpoints_comm.axis(0));
-		parallel::partition kpts_part(kpts.size(), spin_kpoints_comm.axis(1));
+		parallel::partition kpts_part(brillouin_zone_.size(), spin_kpoints_comm.axis(1));
 
 		assert(kpin_part_.local_size() == kpts_part.local_size()*spin_part.local_size()); //this is always true because the spin size is either 1 or 2
 		
@@ -186,6 +186,15 @@ public:
 		eigenvalues_.reextent({static_cast<boost::multi::size_t>(kpin_.size()), max_local_spinor_set_size_});
 		occupations_.reextent({static_cast<boost::multi::size_t>(kpin_.size()), max_local_spinor_set_size_});
 
+		if(brillouin_zone_.symmetries().size() > 1 and states_.spinor_dim() == 2) {
+			throw std::runtime_error("inq error: the symmetries of the Brillouin zone cannot be used with spinors");
+		}
+
+		// the symmetries are found from the positions only, a magnetization can have a lower symmetry
+		if(brillouin_zone_.symmetries().size() > 1 and states_.num_spin_indices() == 2) {
+			throw std::runtime_error("inq error: the symmetries of the Brillouin zone cannot be used with spin polarization");
+		}
+		
 		if(states_.num_electrons() == 0.0) throw std::runtime_error("inq error: the system does not have any electrons");
 		if(states_.num_electrons() <  0.0) throw std::runtime_error("inq error: the system has a negative number of electrons");
 		
@@ -294,17 +303,26 @@ public:
 			logger()->info("  {} states divided among {} partitions", kpin()[0].set_part().size(), kpin()[0].set_part().comm_size());
 			logger()->info("  partition 0 has {} states and the last partition has {} states\n", kpin()[0].set_part().local_size(0), kpin()[0].set_part().local_size(kpin()[0].set_part().comm_size() - 1));
 
-			logger()->info("real-space parallelization:");
-			logger()->info("  {} slices ({} points) divided among {} partitions", states_basis_.cubic_part(0).size(), states_basis_.part().size(), states_basis_.cubic_part(0).comm_size());
-			logger()->info("  partition 0 has {} slices and the last partition has {} slices ({} and {} points)",
-										 states_basis_.cubic_part(0).local_size(0), states_basis_.cubic_part(0).local_size(states_basis_.part().comm_size() - 1),
-										 states_basis_.part().local_size(0), states_basis_.part().local_size(states_basis_.part().comm_size() - 1));
-
-			logger()->info("fourier-space parallelization:");
-			logger()->info("  {} slices ({} points) divided among {} partitions", fourier_basis.cubic_part(2).size(), fourier_basis.part().size(), fourier_basis.cubic_part(2).comm_size());
-			logger()->info("  partition 0 has {} slices and the last partition has {} slices ({} and {} points)\n",
-										 fourier_basis.cubic_part(2).local_size(0), fourier_basis.cubic_part(2).local_size(fourier_basis.part().comm_size() - 1),
-										 fourier_basis.part().local_size(0), fourier_basis.part().local_size(fourier_basis.part().comm_size() - 1));
+			if(states_basis_.pencil()) {
+				logger()->info("real-space parallelization (pencil):");
+				logger()->info("  {} x {} columns ({} points) divided among {} x {} partitions\n", states_basis_.cubic_part(0).size(), states_basis_.cubic_part(1).size(),
+											 states_basis_.size(), states_basis_.cubic_part(0).comm_size(), states_basis_.cubic_part(1).comm_size());
+				logger()->info("fourier-space parallelization (pencil):");
+				logger()->info("  {} x {} columns ({} points) divided among {} x {} partitions\n", fourier_basis.cubic_part(1).size(), fourier_basis.cubic_part(2).size(),
+											 fourier_basis.part().size(), fourier_basis.cubic_part(1).comm_size(), fourier_basis.cubic_part(2).comm_size());
+			} else {
+				logger()->info("real-space parallelization:");
+				logger()->info("  {} slices ({} points) divided among {} partitions", states_basis_.cubic_part(0).size(), states_basis_.part().size(), states_basis_.cubic_part(0).comm_size());
+				logger()->info("  partition 0 has {} slices and the last partition has {} slices ({} and {} points)",
+											 states_basis_.cubic_part(0).local_size(0), states_basis_.cubic_part(0).local_size(states_basis_.part().comm_size() - 1),
+											 states_basis_.part().local_size(0), states_basis_.part().local_size(states_basis_.part().comm_size() - 1));
+
+				logger()->info("fourier-space parallelization:");
+				logger()->info("  {} slices ({} points) divided among {} partitions", fourier_basis.cubic_part(2).size(), fourier_basis.part().size(), fourier_basis.cubic_part(2).comm_size());
+				logger()->info("  partition 0 has {} slices and the last partition has {} slices ({} and {} points)\n",
+											 fourier_basis.cubic_part(2).local_size(0), fourier_basis.cubic_part(2).local_size(fourier_basis.part().comm_size() - 1),
+											 fourier_basis.part().local_size(0), fourier_basis.part().local_size(fourier_basis.part().comm_size() - 1));
+			}
 				
 		}
 	}
@@ -615,6 +633,11 @@ TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
 		}
 		
 	}
+
+	SECTION("Symmetric grid with spin"){
+		CHECK_THROWS(systems::electrons(par, ions, input::kpoints::grid({2, 2, 2}, false, true), options::electrons{}.cutoff(15.0_Ha).spin_polarized()));
+		CHECK_THROWS(systems::electrons(par, ions, input::kpoints::grid({2, 2, 2}, false, true), options::electrons{}.cutoff(15.0_Ha).spin_non_collinear()));
+	}
 }
 #endif
 
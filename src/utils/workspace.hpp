@@ -0,0 +1,226 @@
+/* -*- indent-tabs-mode: t -*- */
+
+#ifndef INQ__UTILS__WORKSPACE
+#define INQ__UTILS__WORKSPACE
+
+// Copyright (C) 2019-2023 Lawrence Livermore National Security, LLC., Xavier Andrade, Alfredo A. Correa
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include <any>
+#include <list>
+#include <string>
+
+#include <utils/profiling.hpp>
+
+namespace inq {
+namespace utils {
+
+// A set of named scratch buffers. The routines that need temporaries
+// borrow them from a workspace owned by the caller (the calculator or
+// the propagator), so after the first iteration the buffers are reused
+// and no large allocations are done.
+//
+// A buffer stays valid until the workspace is cleared or destroyed.
+// Routines must use different names for buffers that are alive at
+// the same time.
+
+class workspace {
+
+	struct entry {
+		std::string name;
+		std::any value;
+	};
+
+	std::list<entry> entries_;
+	long num_allocations_ = 0;
+
+	// the model can be in the reciprocal space of the set, so we only compare quantities that do not depend on the space;
+	// the kpoint and the spin index are only labels, so one buffer is shared by all the sets with the same shape
+	template <typename SetType, typename ModelType>
+	static bool same_layout(SetType const & set, ModelType const & model) {
+		return set.basis().sizes() == model.basis().sizes()
+			and set.basis().comm().size() == model.basis().comm().size()
+			and set.basis().cell() == model.basis().cell()
+			and set.spinor_set_size() == model.spinor_set_size()
+			and set.local_set_size() == model.local_set_size()
+			and set.set_part().start() == model.set_part().start()
+			and set.spinor_dim() == model.spinor_dim();
+	}
+
+public:
+
+	workspace() = default;
+	workspace(workspace const &) = delete;
+	workspace(workspace &&) = default;
+	workspace & operator=(workspace const &) = delete;
+	workspace & operator=(workspace &&) = default;
+
+	// returns the buffer with this name and type for which 'match' is true, if there is none a new one is created with 'create'
+	template <typename Type, typename MatchType, typename CreateType>
+	Type & get(std::string const & name, MatchType && match, CreateType && create) {
+
+		for(auto & ent : entries_){
+			if(ent.name != name) continue;
+			auto ptr = std::any_cast<Type>(&ent.value);
+			if(ptr != nullptr and match(*ptr)) return *ptr;
+		}
+
+		CALI_CXX_MARK_SCOPE("workspace::allocate");
+
+		num_allocations_++;
+		entries_.push_back(entry{name, std::any(create())});
+		return *std::any_cast<Type>(&entries_.back().value);
+	}
+
+	// an array with the given extensions, there is only one array per name so it is reallocated if the size changes
+	template <typename ArrayType>
+	ArrayType & array(std::string const & name, typename ArrayType::extensions_type const & extensions) {
+
+		for(auto & ent : entries_){
+			if(ent.name != name) continue;
+			auto ptr = std::any_cast<ArrayType>(&ent.value);
+			if(ptr == nullptr) continue;
+			if(ptr->extensions() != extensions) {
+				num_allocations_++;
+				*ptr = ArrayType(extensions);
+			}
+			return *ptr;
+		}
+
+		num_allocations_++;
+		entries_.push_back(entry{name, std::any(ArrayType(extensions))});
+		return *std::any_cast<ArrayType>(&entries_.back().value);
+	}
+
+	// an orbital set with the same layout as 'model', it gets the kpoint and spin index of 'model'
+	template <typename SetType>
+	SetType & orbitals(std::string const & name, SetType const & model) {
+		auto & set = get<SetType>(name,
+															[&model](auto const & set){ return same_layout(set, model); },
+															[&model](){ return SetType(model.skeleton()); });
+		set.relabel(model.kpoint(), model.spin_index());
+		return set;
+	}
+
+	// like orbitals, but the set lives in the reciprocal space of 'model'
+	template <typename SetType>
+	auto & reciprocal_orbitals(std::string const & name, SetType const & model) {
+		using reciprocal_type = decltype(SetType::reciprocal(model.skeleton()));
+		auto & set = get<reciprocal_type>(name,
+																			[&model](auto const & set){ return same_layout(set, model); },
+																			[&model](){ return SetType::reciprocal(model.skeleton()); });
+		set.relabel(model.kpoint(), model.spin_index());
+		return set;
+	}
+
+	auto size() const {
+		return long(entries_.size());
+	}
+
+	auto & num_allocations() const {
+		return num_allocations_;
+	}
+
+	void clear() {
+		entries_.clear();
+	}
+
+};
+
+}
+}
+#endif
+
+#ifdef INQ_UTILS_WORKSPACE_UNIT_TEST
+#undef INQ_UTILS_WORKSPACE_UNIT_TEST
+
+#include <basis/real_space.hpp>
+#include <states/orbital_set.hpp>
+
+#include <catch2/catch_all.hpp>
+
+TEST_CASE(INQ_TEST_FILE, INQ_TEST_TAG) {
+	using namespace inq;
+	using namespace inq::magnitude;
+	using namespace Catch::literals;
+	using Catch::Approx;
+
+	SECTION("Arrays"){
+		utils::workspace ws;
+
+		auto & arr1 = ws.array<gpu::array<double, 2>>("arr", {10, 3});
+		arr1[9][2] = 7.0;
+		CHECK(ws.num_allocations() == 1);
+
+		auto & arr2 = ws.array<gpu::array<double, 2>>("arr", {10, 3});
+		CHECK(&arr1 == &arr2);
+		CHECK(arr2[9][2] == 7.0);
+		CHECK(ws.num_allocations() == 1);
+
+		auto & arr3 = ws.array<gpu::array<complex, 1>>("arr", {20});
+		CHECK(ws.num_allocations() == 2);
+		CHECK(arr3.size() == 20);
+
+		auto & arr4 = ws.array<gpu::array<double, 2>>("arr", {5, 3});
+		CHECK(&arr4 == &arr1);
+		CHECK(arr4.size() == 5);
+		CHECK(ws.num_allocations() == 3);
+		CHECK(ws.size() == 2);
+
+		ws.clear();
+		CHECK(ws.size() == 0);
+	}
+
+	SECTION("Orbitals"){
+		parallel::communicator comm{boost::mpi3::environment::get_world_instance()};
+		parallel::cartesian_communicator<2> cart_comm(comm, {});
+
+		basis::real_space rs(systems::cell::orthorhombic(10.0_b, 4.0_b, 7.0_b), /*spacing =*/ 0.35124074, basis::basis_subcomm(cart_comm));
+
+		states::orbital_set<basis::real_space, complex> phi1(rs, 6, 1, vector3<double, covariant>{0.0, 0.0, 0.0}, 0, cart_comm);
+		states::orbital_set<basis::real_space, complex> phi2(rs, 6, 1, vector3<double, covariant>{0.1, 0.0, 0.0}, 1, cart_comm);
+		states::orbital_set<basis::real_space, complex> phi3(rs, 4, 1, vector3<double, covariant>{0.0, 0.0, 0.0}, 0, cart_comm);
+
+		utils::workspace ws;
+
+		auto & tmp1 = ws.orbitals("tmp", phi1);
+		CHECK(tmp1.local_set_size() == phi1.local_set_size());
+		CHECK(tmp1.kpoint() == phi1.kpoint());
+		CHECK(tmp1.spin_index() == 0);
+		CHECK(ws.num_allocations() == 1);
+
+		// a different kpoint and spin reuse the buffer
+		auto & tmp2 = ws.orbitals("tmp", phi2);
+		CHECK(&tmp1 == &tmp2);
+		CHECK(tmp2.kpoint() == phi2.kpoint());
+		CHECK(tmp2.spin_index() == 1);
+		CHECK(ws.num_allocations() == 1);
+
+		// a different shape does not
+		auto & tmp3 = ws.orbitals("tmp", phi3);
+		CHECK(&tmp1 != &tmp3);
+		CHECK(tmp3.spinor_set_size() == 4);
+		CHECK(ws.num_allocations() == 2);
+
+		for(int iter = 0; iter < 3; iter++){
+			CHECK(&ws.orbitals("tmp", phi1) == &tmp1);
+			CHECK(tmp1.kpoint() == phi1.kpoint());
+			CHECK(&ws.orbitals("tmp", phi2) == &tmp1);
+			CHECK(tmp1.kpoint() == phi2.kpoint());
+			CHECK(&ws.orbitals("tmp", phi3) == &tmp3);
+		}
+		CHECK(ws.num_allocations() == 2);
+
+		auto & ftmp = ws.reciprocal_orbitals("tmp", phi1);
+		CHECK(ftmp.basis().sizes() == phi1.basis().sizes());
+		CHECK(ws.num_allocations() == 3);
+		CHECK(&ws.reciprocal_orbitals("tmp", phi2) == &ftmp);
+		CHECK(ftmp.kpoint() == phi2.kpoint());
+		CHECK(ws.num_allocations() == 3);
+	}
+
+}
+#endif
@@ -48,3 +48,29 @@ for x in range(5):
 
 assert abs(atoms.get_potential_energy() - -35.793472912716645) < 3.0e-5
   
+
+#A view of the density blocks the calculations until it is deleted
+view = atoms.calc.get_density(copy = False)
+
+assert not view.flags.writeable
+assert abs(view.sum() - density.sum()) < 1.0e-10
+
+blocked = False
+try:
+  atoms.calc.scf_step(atoms, array)
+except RuntimeError:
+  blocked = True
+
+assert blocked
+
+del view
+atoms.calc.scf_step(atoms, array)
+
+#A potential with the wrong shape is rejected
+rejected = False
+try:
+  atoms.calc.scf_step(atoms, array[:-1])
+except RuntimeError:
+  rejected = True
+
+assert rejected